@@ -0,0 +1,110 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "circle_index.h"
+#include "projection.h"
+#include <cmath>
+#include <algorithm>
+
+#define PDLN_CIRCLE_CHORD_MARGIN (1e-9)
+
+
+/* chord length between the center of a circle and the points of its boundary */
+static inline double circle_chord(const double circle_xyz[4])
+{
+    return sqrt(std::max(0.0, 2 - 2 * circle_xyz[3])) + PDLN_CIRCLE_CHORD_MARGIN;
+}
+
+
+Circle_index::Circle_index(const double *circles, int num_circles)
+    : circles_xyz(circles)
+    , resolution(1)
+    , cell_offsets(NULL)
+    , cell_circles(NULL)
+{
+    /* cells about as wide as the average circle */
+    double total_chord = 0;
+    for (int j = 0; j < num_circles; j++)
+        total_chord += circle_chord(&circles[j*4]);
+    if (num_circles > 0)
+        resolution = (int)std::min((double)PDLN_CIRCLE_INDEX_MAX_RESOLUTION, std::max(1.0, num_circles / total_chord));
+
+    int num_cells = resolution * resolution * resolution;
+    cell_offsets = new int[num_cells+1]();
+
+    /* the cap lies within the box of half width chord around the center */
+    std::vector<int> ranges(num_circles*6);
+    for (int j = 0; j < num_circles; j++) {
+        double chord = circle_chord(&circles[j*4]);
+        int    cells = 1;
+        for (int d = 0; d < 3; d++) {
+            ranges[j*6+d*2]   = get_cell(circles[j*4+d] - chord);
+            ranges[j*6+d*2+1] = get_cell(circles[j*4+d] + chord);
+            cells *= ranges[j*6+d*2+1] - ranges[j*6+d*2] + 1;
+        }
+        if (cells > num_cells / 8 && cells > 1) {
+            large_circles.push_back(j);
+            ranges[j*6+1] = -1;
+        }
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int j = 0; j < num_circles; j++)
+            for (int x = ranges[j*6]; x <= ranges[j*6+1]; x++)
+                for (int y = ranges[j*6+2]; y <= ranges[j*6+3]; y++)
+                    for (int z = ranges[j*6+4]; z <= ranges[j*6+5]; z++) {
+                        int cell = (x * resolution + y) * resolution + z;
+                        if (pass == 0)
+                            cell_offsets[cell+1]++;
+                        else
+                            cell_circles[cell_offsets[cell]++] = j;
+                    }
+
+        if (pass == 0) {
+            for (int i = 0; i < num_cells; i++)
+                cell_offsets[i+1] += cell_offsets[i];
+            cell_circles = new int[cell_offsets[num_cells]];
+        } else {
+            /* filling advanced each offset to the start of the next cell */
+            for (int i = num_cells; i > 0; i--)
+                cell_offsets[i] = cell_offsets[i-1];
+            cell_offsets[0] = 0;
+        }
+    }
+}
+
+
+Circle_index::~Circle_index()
+{
+    delete[] cell_offsets;
+    delete[] cell_circles;
+}
+
+
+int Circle_index::get_cell(double value) const
+{
+    int cell = (int)floor((value + 1) * 0.5 * resolution);
+    return std::max(0, std::min(resolution - 1, cell));
+}
+
+
+/* whether the unit vector (x, y, z) lies in any of the circles */
+bool Circle_index::covers(double x, double y, double z) const
+{
+    int cell = (get_cell(x) * resolution + get_cell(y)) * resolution + get_cell(z);
+    for (int i = cell_offsets[cell]; i < cell_offsets[cell+1]; i++)
+        if (point_in_circle_xyz(x, y, z, &circles_xyz[cell_circles[i]*4]))
+            return true;
+
+    for (unsigned i = 0; i < large_circles.size(); i++)
+        if (point_in_circle_xyz(x, y, z, &circles_xyz[large_circles[i]*4]))
+            return true;
+
+    return false;
+}
@@ -0,0 +1,41 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#ifndef PDLN_CIRCLE_INDEX_H
+#define PDLN_CIRCLE_INDEX_H
+
+#include <vector>
+
+#define PDLN_CIRCLE_INDEX_MAX_RESOLUTION (128)
+
+
+/*
+ * Uniform grid over the cube [-1, 1]^3 holding circles on the unit sphere,
+ * given as calculate_circle_xyz does. A circle is kept in every cell its
+ * cap may reach, so a point is only tested against the circles of its cell.
+ * Read-only after construction, queries may run concurrently.
+ */
+class Circle_index {
+    public:
+        Circle_index(const double*, int);
+        ~Circle_index();
+
+        bool covers(double, double, double) const;
+
+    private:
+        int get_cell(double) const;
+
+        const double*    circles_xyz;
+        int              resolution;
+        int*             cell_offsets;
+        int*             cell_circles;
+        std::vector<int> large_circles;     /* reaching too many cells, tested for every point */
+};
+
+#endif
@@ -0,0 +1,341 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "cubed_sphere.h"
+#include "common_utils.h"
+#include "projection.h"
+#include "timer.h"
+#include <cmath>
+#include <algorithm>
+#include <sys/time.h>
+#include <omp.h>
+
+
+Cubed_sphere_decomposition::Cubed_sphere_decomposition(Grid_info grid_info, Processing_resource *proc_info,
+                                                       int min_points_per_chunk, int over_decomposition_factor)
+    : grid_info(grid_info)
+    , processing_info(proc_info)
+    , min_points_per_chunk(min_points_per_chunk)
+    , over_decomposition_factor(over_decomposition_factor)
+{
+    PDASSERT(processing_info != NULL);
+    PDASSERT(grid_info.chart_face < 0);
+
+    int num_points = grid_info.num_total_points;
+    double **xyz = grid_info.xyz_values;
+
+    point_face = new int[num_points];
+    #pragma omp parallel for
+    for (int i = 0; i < num_points; i++)
+        point_face[i] = get_cube_face_of_xyz(xyz[0][i], xyz[1][i], xyz[2][i]);
+
+    /* mean spacing of points on a face, whose edges are 2 * PDLN_CUBE_CHART_SCALE long */
+    double spacing = 2 * PDLN_CUBE_CHART_SCALE / std::sqrt(std::max(1.0, (double)num_points / PDLN_NUM_CUBE_FACES));
+    initial_apron_width = std::min(PDLN_CUBE_APRON_LAYERS * spacing, (double)PDLN_CUBE_MAX_APRON_WIDTH);
+}
+
+
+Cubed_sphere_decomposition::~Cubed_sphere_decomposition()
+{
+    delete[] point_face;
+    delete[] grid_info.global_index;
+    delete[] grid_info.coord_values[0];
+    delete[] grid_info.coord_values[1];
+    delete[] grid_info.xyz_values[0];
+    delete[] grid_info.xyz_values[1];
+    delete[] grid_info.xyz_values[2];
+}
+
+
+/*
+ * Chart the points of a face and its apron, i.e. all points within
+ * apron_width beyond the face edges, into a sub-grid.
+ * return the number of points owned by the face.
+ */
+int Cubed_sphere_decomposition::generate_face_sub_grid(int face, double apron_width, Grid_info *sub_grid)
+{
+    int      num_points = grid_info.num_total_points;
+    double** xyz        = grid_info.xyz_values;
+    double   limit      = PDLN_CUBE_CHART_SCALE + apron_width;
+    double   frame[3][3];
+
+    get_cube_face_frame(face, frame);
+
+    int*    global_index = grid_info.global_index;
+    double* chart[2];
+    bool*   in_chart = new bool[num_points];
+    chart[0] = new double[num_points];
+    chart[1] = new double[num_points];
+
+    /* points are visited in the order of the grid, which may differ from their global indexes */
+    #pragma omp parallel for
+    for (int i = 0; i < num_points; i++) {
+        int id = global_index ? global_index[i] : i;
+        in_chart[i] = xyz_to_cube_chart(frame, xyz[0][id], xyz[1][id], xyz[2][id], &chart[0][i], &chart[1][i]) &&
+                      std::fabs(chart[0][i]) <= limit && std::fabs(chart[1][i]) <= limit;
+    }
+
+    int num_sub_points = 0;
+    int num_owned_points = 0;
+    for (int i = 0; i < num_points; i++) {
+        num_sub_points += in_chart[i];
+        num_owned_points += point_face[i] == face;
+    }
+
+    sub_grid->coord_values[PDLN_LON] = new double[num_sub_points];
+    sub_grid->coord_values[PDLN_LAT] = new double[num_sub_points];
+    sub_grid->global_index = new int[num_sub_points];
+    sub_grid->mask = grid_info.mask ? new bool[num_sub_points] : NULL;
+
+    for (int i = 0, j = 0; i < num_points; i++)
+        if (in_chart[i]) {
+            int id = global_index ? global_index[i] : i;
+            PDASSERT(point_face[id] != face || (std::fabs(chart[0][i]) <= PDLN_CUBE_CHART_SCALE + PDLN_ABS_TOLERANCE &&
+                                              std::fabs(chart[1][i]) <= PDLN_CUBE_CHART_SCALE + PDLN_ABS_TOLERANCE));
+            sub_grid->coord_values[PDLN_LON][j] = chart[0][i];
+            sub_grid->coord_values[PDLN_LAT][j] = chart[1][i];
+            sub_grid->global_index[j] = id;
+            if (grid_info.mask)
+                sub_grid->mask[j] = grid_info.mask[i];
+            j++;
+        }
+
+    /* sub-grids borrow the unit vectors of the whole grid, which are indexed by global indexes */
+    sub_grid->xyz_values[0]    = xyz[0];
+    sub_grid->xyz_values[1]    = xyz[1];
+    sub_grid->xyz_values[2]    = xyz[2];
+    sub_grid->num_total_points = num_sub_points;
+    sub_grid->num_vitual_poles = 0;
+    sub_grid->num_fence_points = 0;
+    sub_grid->boundary         = Boundry(-limit, limit, -limit, limit);
+    sub_grid->is_cyclic        = false;
+    sub_grid->chart_face       = face;
+    sub_grid->fingerprint      = grid_info.fingerprint;
+
+    delete[] in_chart;
+    delete[] chart[0];
+    delete[] chart[1];
+    return num_owned_points;
+}
+
+
+/* whether no enabled point, except the vertexes ids, lies strictly within the cap of axis c and cosine cos_r */
+bool Cubed_sphere_decomposition::is_cap_empty(const double c[3], double cos_r, const int ids[3])
+{
+    double** xyz = grid_info.xyz_values;
+    int*     global_index = grid_info.global_index;
+
+    for (int i = 0; i < grid_info.num_total_points; i++) {
+        int id = global_index ? global_index[i] : i;
+        if ((grid_info.mask && !grid_info.mask[i]) || id == ids[0] || id == ids[1] || id == ids[2])
+            continue;
+        if (c[0]*xyz[0][id] + c[1]*xyz[1][id] + c[2]*xyz[2][id] > cos_r + PDLN_CUBE_CAP_TOLERANCE)
+            return false;
+    }
+    return true;
+}
+
+
+/*
+ * Keep the triangles of a face sub-grid whose vertex of the lowest global index
+ * belongs to the face. A triangle touching the face is only trusted when its
+ * circumcircle lies within the sub-grid, otherwise points out of the sub-grid
+ * could have broken it. With check_caps, such triangles are still trusted when
+ * no point of the whole grid lies in their circumcircles, which is only worth
+ * it for the few triangles left once the apron can not be widened further.
+ * return the number of triangles that can not be trusted.
+ */
+int Cubed_sphere_decomposition::collect_face_triangles(int face, double apron_width, Delaunay_grid_decomposition *sub_decomp,
+                                                       bool check_caps)
+{
+    double** xyz   = grid_info.xyz_values;
+    double   ratio = (PDLN_CUBE_CHART_SCALE + apron_width) / PDLN_CUBE_CHART_SCALE;
+    double   frame[3][3];
+    double   planes[4][3];
+
+    /* outward normals of the great circles bounding the sub-grid */
+    get_cube_face_frame(face, frame);
+    for (int i = 0; i < 3; i++) {
+        planes[0][i] =  frame[1][i] - ratio * frame[0][i];
+        planes[1][i] = -frame[1][i] - ratio * frame[0][i];
+        planes[2][i] =  frame[2][i] - ratio * frame[0][i];
+        planes[3][i] = -frame[2][i] - ratio * frame[0][i];
+    }
+    for (int k = 0; k < 4; k++) {
+        double len = std::sqrt(planes[k][0]*planes[k][0] + planes[k][1]*planes[k][1] + planes[k][2]*planes[k][2]);
+        for (int i = 0; i < 3; i++)
+            planes[k][i] /= len;
+    }
+
+    Triangle_inline* triangles;
+    int num_triangles = sub_decomp->get_local_triangles(&triangles);
+    int num_untrusted = 0;
+
+    for (int t = 0; t < num_triangles; t++) {
+        int ids[3] = {triangles[t].v[0].id, triangles[t].v[1].id, triangles[t].v[2].id};
+
+        if (point_face[ids[0]] != face && point_face[ids[1]] != face && point_face[ids[2]] != face)
+            continue;
+
+        double p[3][3];
+        for (int j = 0; j < 3; j++)
+            for (int i = 0; i < 3; i++)
+                p[j][i] = xyz[i][ids[j]];
+
+        double e1[3] = {p[1][0]-p[0][0], p[1][1]-p[0][1], p[1][2]-p[0][2]};
+        double e2[3] = {p[2][0]-p[0][0], p[2][1]-p[0][1], p[2][2]-p[0][2]};
+        double c[3]  = {e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0]};
+        double len   = std::sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2]);
+        double cos_r = (c[0]*p[0][0] + c[1]*p[0][1] + c[2]*p[0][2]) / len;
+        if (cos_r < 0) {
+            cos_r = -cos_r;
+            len   = -len;
+        }
+
+        bool trusted = len != 0 && cos_r > 0;
+        double sin_r = std::sqrt(std::max(0.0, 1 - cos_r * cos_r));
+        for (int k = 0; k < 4 && trusted; k++)
+            trusted = (planes[k][0]*c[0] + planes[k][1]*c[1] + planes[k][2]*c[2]) / len <= -sin_r;
+
+        if (!trusted && check_caps && len != 0) {
+            double axis[3] = {c[0] / len, c[1] / len, c[2] / len};
+            trusted = is_cap_empty(axis, cos_r, ids);
+        }
+
+        if (!trusted) {
+            num_untrusted++;
+            continue;
+        }
+
+        int lowest = std::min(ids[0], std::min(ids[1], ids[2]));
+        if (point_face[lowest] == face)
+            owned_triangles.push_back(triangles[t]);
+    }
+
+    delete[] triangles;
+    return num_untrusted;
+}
+
+
+/*
+ * Triangulate a face on the processes of group_info, widening its apron
+ * until all triangles near the face can be trusted.
+ */
+int Cubed_sphere_decomposition::triangulate_face(int face, Processing_resource *group_info)
+{
+    timeval start, end;
+    MPI_Comm comm = group_info->get_mpi_comm();
+    unsigned num_kept = owned_triangles.size();
+
+    for (double apron_width = initial_apron_width; ; apron_width = std::min(apron_width * 2, (double)PDLN_CUBE_MAX_APRON_WIDTH)) {
+        Grid_info sub_grid;
+        if (generate_face_sub_grid(face, apron_width, &sub_grid) == 0) {
+            delete[] sub_grid.coord_values[PDLN_LON];
+            delete[] sub_grid.coord_values[PDLN_LAT];
+            delete[] sub_grid.global_index;
+            delete[] sub_grid.mask;
+            return 0;
+        }
+
+        log(LOG_INFO, "triangulating cubed-sphere face %d with %d points, apron width %lf\n", face, sub_grid.num_total_points, apron_width);
+        Delaunay_grid_decomposition *sub_decomp = new Delaunay_grid_decomposition(sub_grid, group_info, min_points_per_chunk,
+                                                                                  over_decomposition_factor);
+
+        MPI_Barrier(comm);
+        gettimeofday(&start, NULL);
+        int ret = sub_decomp->generate_grid_decomposition();
+        gettimeofday(&end, NULL);
+        time_decomose += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+        int all_ret = 0;
+        MPI_Allreduce(&ret, &all_ret, 1, MPI_UNSIGNED, MPI_LOR, comm);
+        if (all_ret) {
+            log(LOG_ERROR, "Failed in decomposing cubed-sphere face %d\n", face);
+            delete sub_decomp;
+            delete[] sub_grid.mask;
+            return -1;
+        }
+
+        ret = sub_decomp->generate_trianglulation_for_local_decomp();
+        MPI_Allreduce(&ret, &all_ret, 1, MPI_UNSIGNED, MPI_LOR, comm);
+        if (all_ret) {
+            log(LOG_ERROR, "Failed in triangulating cubed-sphere face %d\n", face);
+            delete sub_decomp;
+            delete[] sub_grid.mask;
+            return -1;
+        }
+
+        int num_untrusted = collect_face_triangles(face, apron_width, sub_decomp, apron_width >= PDLN_CUBE_MAX_APRON_WIDTH);
+        delete sub_decomp;
+        delete[] sub_grid.mask;
+
+        int all_untrusted = 0;
+        MPI_Allreduce(&num_untrusted, &all_untrusted, 1, MPI_INT, MPI_SUM, comm);
+        if (all_untrusted == 0)
+            return 0;
+
+        if (apron_width >= PDLN_CUBE_MAX_APRON_WIDTH) {
+            log(LOG_ERROR, "%d triangles of cubed-sphere face %d are broken by points out of its widest apron\n", all_untrusted, face);
+            return -1;
+        }
+
+        log(LOG_INFO, "%d triangles of cubed-sphere face %d reach out of its apron, widening it\n", all_untrusted, face);
+        owned_triangles.resize(num_kept);
+    }
+}
+
+
+/*
+ * Faces are handed out to groups of processes round-robin, so that up to six
+ * faces are triangulated at the same time on disjoint processes.
+ */
+int Cubed_sphere_decomposition::generate_trianglulation()
+{
+    MPI_Comm comm       = processing_info->get_mpi_comm();
+    int      rank       = processing_info->get_local_process_id();
+    int      num_procs  = processing_info->get_num_total_processes();
+    int      num_groups = std::min(num_procs, PDLN_NUM_CUBE_FACES);
+    int      group      = (int)((long long)rank * num_groups / num_procs);
+
+    MPI_Comm group_comm = MPI_COMM_NULL;
+    Processing_resource *group_info = processing_info;
+    if (num_groups > 1) {
+        MPI_Comm_split(comm, group, rank, &group_comm);
+        group_info = new Processing_resource(group_comm);
+    }
+
+    int ret = 0;
+    for (int face = group; face < PDLN_NUM_CUBE_FACES && ret == 0; face += num_groups)
+        ret = triangulate_face(face, group_info);
+
+    if (num_groups > 1) {
+        delete group_info;
+        MPI_Comm_free(&group_comm);
+    }
+
+    int all_ret = 0;
+    MPI_Allreduce(&ret, &all_ret, 1, MPI_INT, MPI_LOR, comm);
+    return all_ret ? -1 : 0;
+}
+
+
+void Cubed_sphere_decomposition::merge_all_triangles(bool sort)
+{
+    Delaunay_grid_decomposition::merge_triangles_into_file(processing_info, grid_info.fingerprint, grid_info.xyz_values,
+                                                           grid_info.num_total_points,
+                                                           owned_triangles.empty() ? NULL : &owned_triangles[0],
+                                                           owned_triangles.size(), sort);
+}
+
+
+void Cubed_sphere_decomposition::get_local_mesh(int num_ghost_layers, Local_mesh *mesh)
+{
+    Delaunay_grid_decomposition::make_local_mesh(processing_info, owned_triangles.empty() ? NULL : &owned_triangles[0],
+                                                 owned_triangles.size(), num_ghost_layers, mesh);
+}
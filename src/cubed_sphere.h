@@ -0,0 +1,50 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#ifndef PDLN_CUBED_SPHERE_H
+#define PDLN_CUBED_SPHERE_H
+
+#include "grid_decomposition.h"
+
+/*
+ * Decomposition of global grids by the faces of a cubed sphere.
+ * Points are first assigned to the six faces. Each face is then decomposed and
+ * triangulated in its gnomonic chart as a sub-grid, which also carries the points
+ * of neighboring faces within an apron of PDLN_CUBE_APRON_LAYERS point spacings,
+ * so that halos cross face edges. The apron of a face is widened until no triangle
+ * of the face reaches out of it. Processes are split into up to six groups, which
+ * triangulate their faces at the same time.
+ * There are no polar caps and no cyclic boundaries: the poles are face centers.
+ * A triangle is kept by the face owning its vertex of the lowest global index.
+ */
+class Cubed_sphere_decomposition {
+public:
+    Cubed_sphere_decomposition(Grid_info, Processing_resource*, int, int =1);
+    ~Cubed_sphere_decomposition();
+
+    int  generate_trianglulation();
+    void merge_all_triangles(bool);
+    void get_local_mesh(int, Local_mesh*);
+
+private:
+    int  triangulate_face(int, Processing_resource*);
+    int  generate_face_sub_grid(int, double, Grid_info*);
+    int  collect_face_triangles(int, double, Delaunay_grid_decomposition*, bool);
+    bool is_cap_empty(const double*, double, const int*);
+
+    Grid_info                grid_info;
+    Processing_resource*     processing_info;
+    int                      min_points_per_chunk;
+    int                      over_decomposition_factor;
+    int*                     point_face;
+    double                   initial_apron_width;
+    vector<Triangle_inline>  owned_triangles;
+};
+
+#endif
@@ -10,12 +10,16 @@
 #include "grid_decomposition.h"
 #include "common_utils.h"
 #include "projection.h"
+#include "mesh_file.h"
+#include "mesh_adjacency.h"
 #include "netcdf_utils.h"
 #include "opencv_utils.h"
 #include "timer.h"
+#include "point_kernels.h"
 #include <cstdio>
 #include <cstddef>
 #include <cstring>
+#include <climits>
 #include <algorithm>
 #include <cmath>
 #include <vector>
@@ -38,9 +42,41 @@
 
 #define PDLN_TOLERABLE_ERROR (0.0001)
 
+/* order output triangles along the Hilbert curve of their centroids */
+#ifndef PDLN_HILBERT_ORDER
+#define PDLN_HILBERT_ORDER (false)
+#endif
+
+/* also save the Hilbert order of the grid points */
+#ifndef PDLN_VERTEX_PERMUTATION
+#define PDLN_VERTEX_PERMUTATION (false)
+#endif
+
+/* filter halo candidates by 32-bit fixed-point copies of the leaf coordinates */
+#ifndef PDLN_QUANTIZED_HALO_SEARCH
+#define PDLN_QUANTIZED_HALO_SEARCH (false)
+#endif
+
+/*
+ * Quantized coordinates span at most PDLN_QUANTIZED_CELLS cells per node, and a
+ * cell is never narrower than 1/PDLN_MAX_QUANTIZED_SCALE degree, so rounding
+ * errors of coordinates up to a few thousand degrees stay far below a cell.
+ */
+#define PDLN_QUANTIZED_CELLS        (4294967040.0)
+#define PDLN_MAX_QUANTIZED_SCALE    (1e11)
+
+/* points classified at a time by the kernels of point_kernels.h */
+#define PDLN_POINT_BLOCK_SIZE       (256)
+
+/* processes reading the grid file, 0 for one per node */
+#ifndef PDLN_NUM_GRID_READERS
+#define PDLN_NUM_GRID_READERS (0)
+#endif
+
 #define PDLN_DECOMPOSE_COMMON_MODE (0)
 #define PDLN_DECOMPOSE_SPOLAR_MODE (1)
 #define PDLN_DECOMPOSE_NPOLAR_MODE (2)
+#define PDLN_DECOMPOSE_SECTOR_MODE (3)
 
 #define PDLN_NODE_TYPE_COMMON PDLN_DECOMPOSE_COMMON_MODE
 #define PDLN_NODE_TYPE_SPOLAR PDLN_DECOMPOSE_SPOLAR_MODE
@@ -50,6 +86,12 @@
 
 #define PDLN_MAX_NUM_PROCESSING_UNITS 512
 
+/* region ids are packed into 12 bits of checksum tags, 0 and the last one are preserved */
+#define PDLN_MAX_NUM_REGIONS (0xFFF-1)
+
+/* polar caps can be decomposed again into at most this many angular sectors */
+#define PDLN_MAX_NUM_POLAR_SECTORS (64)
+
 #define PDLN_POLAR_WORKLOAD_RATE (0.09)
 
 /* expanding */
@@ -137,6 +179,7 @@ Search_tree_node::Search_tree_node(Search_tree_node *p, double *coord_value[2],
     , region_id(-1)
     , is_leaf(false)
     , fast_triangulate(false)
+    , polar_sector(false)
     , kernel_boundry(NULL)
     , expand_boundry(NULL)
     , project_boundry(NULL)
@@ -148,8 +191,6 @@ Search_tree_node::Search_tree_node(Search_tree_node *p, double *coord_value[2],
     , midline(Midline{-1, -361.0})
     , group_intervals(NULL)
     , triangulation(NULL)
-    , bind_with(0) /* no one can bind with 0 */
-    , is_bind(false)
     , polars_local_index(NULL)
     , shifted_polar_lat(0)
     , virtual_point_local_index(-1)
@@ -176,6 +217,9 @@ Search_tree_node::Search_tree_node(Search_tree_node *p, double *coord_value[2],
     expand_index    = NULL;
     expand_mask     = NULL;
 
+    quantized_coord[0] = NULL;
+    quantized_coord[1] = NULL;
+
     if(type == PDLN_NODE_TYPE_COMMON) {
         center[PDLN_LON] = (boundry.min_lon + boundry.max_lon) * 0.5;
         center[PDLN_LAT] = (boundry.min_lat + boundry.max_lat) * 0.5;
@@ -219,6 +263,8 @@ Search_tree_node::~Search_tree_node()
 
     delete[] projected_coord[0];
     delete[] projected_coord[1];
+    delete[] quantized_coord[0];
+    delete[] quantized_coord[1];
 
     delete polars_local_index;
 }
@@ -325,7 +371,9 @@ extern double global_p_lon[4];
 extern double global_p_lat[4];
 #define PDLN_INSERT_VIRTUAL_POINT (true)
 #define PDLN_REMOVE_UNNECESSARY_TRIANGLES (true)
-void Search_tree_node::generate_local_triangulation(bool is_cyclic, int vpoint_begin, int vpoint_num, bool is_fine_grid)
+/* on_cube_face: the node belongs to a cubed-sphere face, whose sub-grid is triangulated
+ *               separately, so ties are broken by global indexes shared by all faces */
+void Search_tree_node::generate_local_triangulation(bool is_cyclic, int vpoint_begin, int vpoint_num, bool is_fine_grid, bool on_cube_face)
 {
     log(LOG_DEBUG, "%d region - %d kernel points, %d expanded points\n", region_id, num_kernel_points, num_expand_points);
     timeval start, end;
@@ -375,11 +423,15 @@ void Search_tree_node::generate_local_triangulation(bool is_cyclic, int vpoint_b
         //triangulation->set_virtual_polar_index(virtual_point_local_index);
         if (node_type == PDLN_NODE_TYPE_COMMON)
             triangulation->set_original_center_lon(center[PDLN_LON]);
+        else if (polar_sector)
+            triangulation->set_original_center_lon((kernel_boundry->min_lon + kernel_boundry->max_lon) * 0.5);
         else
             triangulation->set_original_center_lon(180.);
 
         if (project_boundry == NULL && !is_cyclic)
             triangulation->set_regional(true);
+        if (on_cube_face)
+            triangulation->set_tie_break_by_index(true);
         //if (is_fine_grid)
         //    triangulation->set_tolerance(1e-8);
 
@@ -440,7 +492,7 @@ void Search_tree_node::generate_local_triangulation(bool is_cyclic, int vpoint_b
     //    if(PDLN_INSERT_VIRTUAL_POINT && polars_local_index->size() > 1)
     //        reset_polars(ori_lat);
 
-    if (project_boundry && node_type == PDLN_NODE_TYPE_COMMON) {
+    if (project_boundry && node_type == PDLN_NODE_TYPE_COMMON && !on_cube_face) {
         if (expand_boundry->max_lon - expand_boundry->min_lon > 90) {
             double radius;
             Point  circle_center;
@@ -597,8 +649,9 @@ void Search_tree_node::decompose_by_processing_units_number(double *workloads, d
     /* Decompose computing units' group
      * PDLN_DECOMPOSE_COMMON_MODE: 0   1   2   3 | 4   5   6   7
      * PDLN_DECOMPOSE_SPOLAR_MODE: 0 | 1   2   3   4   5   6   7
-     * PDLN_DECOMPOSE_NPOLAR_MODE: 0   1   2   3   4   5   6 | 7 */
-    if(mode == PDLN_DECOMPOSE_COMMON_MODE) {
+     * PDLN_DECOMPOSE_NPOLAR_MODE: 0   1   2   3   4   5   6 | 7
+     * PDLN_DECOMPOSE_SECTOR_MODE: same as common mode, but always divided by longitude */
+    if(mode == PDLN_DECOMPOSE_COMMON_MODE || mode == PDLN_DECOMPOSE_SECTOR_MODE) {
         PDASSERT(c_intervals);
         PDASSERT(c_num_intervals);
         int mid_off = 0; 
@@ -660,6 +713,8 @@ void Search_tree_node::decompose_by_processing_units_number(double *workloads, d
     
     if(mode == PDLN_DECOMPOSE_SPOLAR_MODE || mode == PDLN_DECOMPOSE_NPOLAR_MODE)
         midline.type = PDLN_LAT;
+    else if(mode == PDLN_DECOMPOSE_SECTOR_MODE)
+        midline.type = PDLN_LON;
     else if(length[1] > length[0])
         midline.type = PDLN_LAT;
     else
@@ -970,104 +1025,43 @@ void Search_tree_node::add_neighbors(vector<Search_tree_node*> ns)
 }
 
 
-static inline void lonlat2xyz(double lon, double lat, PAT_REAL *x, PAT_REAL *y, PAT_REAL *z)
-{
-    *x = cosl(DEGREE_TO_RADIAN(lat)) * sinl(DEGREE_TO_RADIAN(lon));
-    *y = sinl(DEGREE_TO_RADIAN(lat));
-    *z = cosl(DEGREE_TO_RADIAN(lat)) * cosl(DEGREE_TO_RADIAN(lon));
-}
-
-
-static inline void normalize_vector(PAT_REAL *x, PAT_REAL *y, PAT_REAL *z)
-{
-    PAT_REAL length = std::sqrt(*x * *x + *y * *y + *z * *z);
-    *x /= length;
-    *y /= length;
-    *z /= length;
-}
-
-
-using std::fabs;
-using std::min;
-static inline void calculate_unit_vectors(double lon_tan, double lat_tan,
-                                          PAT_REAL *v1_x, PAT_REAL *v1_y, PAT_REAL *v1_z,
-                                          PAT_REAL *v2_x, PAT_REAL *v2_y, PAT_REAL *v2_z)
-{
-    PAT_REAL t_x, t_y, t_z;
-
-    lonlat2xyz(lon_tan, lat_tan, &t_x, &t_y, &t_z);
-
-    PAT_REAL min_dir = min(fabs(t_x),min(fabs(t_y),fabs(t_z)));
-    PAT_REAL axis_x, axis_y, axis_z;
-
-    if (min_dir == fabs(t_x)) {
-        axis_x = 1.0;
-        axis_y = 0.0;
-        axis_z = 0.0;
-    } else if (min_dir == fabs(t_y)) {
-        axis_x = 0.0;
-        axis_y = 1.0;
-        axis_z = 0.0;
-    } else if (min_dir == fabs(t_z)) {
-        axis_x = 0.0;
-        axis_y = 0.0;
-        axis_z = 1.0;
-    } else {
-        assert(false);
-    }
-
-    *v1_x = t_y * axis_z - t_z * axis_y;
-    *v1_y = t_z * axis_x - t_x * axis_z;
-    *v1_z = t_x * axis_y - t_y * axis_x;
-
-    normalize_vector(v1_x, v1_y, v1_z);
-
-    *v2_x = t_y * *v1_z - t_z * *v1_y;
-    *v2_y = t_z * *v1_x - t_x * *v1_z;
-    *v2_z = t_x * *v1_y - t_y * *v1_x;
-
-    normalize_vector(v2_x, v2_y, v2_z);
-}
-
-
-void Search_tree_node::project_grid()
+/* xyz_values: unit vectors of all points of the grid, indexed by global index */
+/* chart_frame: frame of the cubed-sphere face the node is charted on, NULL for lon/lat nodes */
+void Search_tree_node::project_grid(double **xyz_values, const double chart_frame[3][3])
 {
     //timeval start, end;
     //gettimeofday(&start, NULL);
 
-    /* (x, y, z) of Unit Vector on projecting surface */
-    PAT_REAL uv1_x, uv1_y, uv1_z;
-    PAT_REAL uv2_x, uv2_y, uv2_z;
-    PAT_REAL center_x, center_y, center_z;
-    lonlat2xyz(center[PDLN_LON], center[PDLN_LAT], &center_x, &center_y, &center_z);
-    calculate_unit_vectors(center[PDLN_LON], center[PDLN_LAT], &uv1_x, &uv1_y, &uv1_z, &uv2_x, &uv2_y, &uv2_z);
+    /* (x, y, z) of tangent point and Unit Vectors on projecting surface */
+    double center_xyz[3], uv1[3], uv2[3];
+    if (chart_frame) {
+        cube_chart_to_xyz(chart_frame, center[PDLN_LON], center[PDLN_LAT], center_xyz);
+        calculate_plane_unit_vectors(center_xyz, uv1, uv2);
+    } else
+        calculate_unit_vectors(center[PDLN_LON], center[PDLN_LAT], center_xyz, uv1, uv2);
 
+    int num_failed = 0;
     if(projected_coord[0] == NULL) {
         projected_coord[0] = new double[num_kernel_points + len_expand_coord_buf];
         projected_coord[1] = new double[num_kernel_points + len_expand_coord_buf];
 
-        for(int i = 0; i < num_kernel_points; i++) {
-            fast_stereographic_projection(kernel_coord[PDLN_LON][i], kernel_coord[PDLN_LAT][i],
-                                          center_x, center_y, center_z, uv1_x, uv1_y, uv1_z, uv2_x, uv2_y, uv2_z,
-                                          projected_coord[PDLN_LON][i], projected_coord[PDLN_LAT][i]);
-        }
-
-        for(int i = 0; i < num_expand_points; i++) {
-            fast_stereographic_projection(expand_coord[PDLN_LON][i], expand_coord[PDLN_LAT][i],
-                                          center_x, center_y, center_z, uv1_x, uv1_y, uv1_z, uv2_x, uv2_y, uv2_z,
-                                          projected_coord[PDLN_LON][i+num_kernel_points], projected_coord[PDLN_LAT][i+num_kernel_points]);
-        }
-
-        num_projected_points = num_kernel_points + num_expand_points;
+        num_failed += stereographic_projection_batch(xyz_values, kernel_index, num_kernel_points,
+                                                     center_xyz, uv1, uv2, projected_coord[PDLN_LON], projected_coord[PDLN_LAT]);
+        num_failed += stereographic_projection_batch(xyz_values, expand_index, num_expand_points,
+                                                     center_xyz, uv1, uv2, projected_coord[PDLN_LON]+num_kernel_points,
+                                                     projected_coord[PDLN_LAT]+num_kernel_points);
     } else {
-        for(int i = num_projected_points - num_kernel_points; i < num_expand_points; i++) {
-            fast_stereographic_projection(expand_coord[PDLN_LON][i], expand_coord[PDLN_LAT][i],
-                                          center_x, center_y, center_z, uv1_x, uv1_y, uv1_z, uv2_x, uv2_y, uv2_z,
-                                          projected_coord[PDLN_LON][i+num_kernel_points], projected_coord[PDLN_LAT][i+num_kernel_points]);
-        }
-
-        num_projected_points = num_kernel_points + num_expand_points;
+        int num_projected_expand = num_projected_points - num_kernel_points;
+        num_failed += stereographic_projection_batch(xyz_values, expand_index+num_projected_expand,
+                                                     num_expand_points-num_projected_expand, center_xyz, uv1, uv2,
+                                                     projected_coord[PDLN_LON]+num_projected_points,
+                                                     projected_coord[PDLN_LAT]+num_projected_points);
     }
+    num_projected_points = num_kernel_points + num_expand_points;
+
+    if (num_failed > 0)
+        log(LOG_ERROR, "[%d] %d points can not be projected around (%lf, %lf)\n", region_id, num_failed, center[PDLN_LON], center[PDLN_LAT]);
+    PDASSERT(num_failed == 0);
 
     /* recalculate rotated expanded boundary */
     double top = -1e20, bot = 1e20, left = 1e20, right = -1e20;
@@ -1087,9 +1081,12 @@ void Search_tree_node::project_grid()
 }
 
 
-Delaunay_grid_decomposition::Delaunay_grid_decomposition(Grid_info grid_info, Processing_resource *proc_info, int min_points_per_chunk)
+Delaunay_grid_decomposition::Delaunay_grid_decomposition(Grid_info grid_info, Processing_resource *proc_info, int min_points_per_chunk,
+                                                         int over_decomposition_factor, int num_polar_sectors)
     : search_tree_root(NULL)
     , min_points_per_chunk(min_points_per_chunk)
+    , over_decomposition_factor(over_decomposition_factor)
+    , num_polar_sectors(num_polar_sectors)
     , original_grid(0)
     , mask(NULL)
     , global_index(NULL)
@@ -1100,6 +1097,9 @@ Delaunay_grid_decomposition::Delaunay_grid_decomposition(Grid_info grid_info, Pr
     , average_workload(0)
     , regionID_to_unitID(NULL)
     , all_group_intervals(NULL)
+    , stream_triangles(false)
+    , is_leaf_streamed(NULL)
+    , num_streamed_received(0)
     , buf_int(NULL)
     , buf_bool(NULL)
 {
@@ -1121,6 +1121,14 @@ Delaunay_grid_decomposition::Delaunay_grid_decomposition(Grid_info grid_info, Pr
     boundary_from_user = grid_info.boundary;
     coord_values[0] = coords[0];
     coord_values[1] = coords[1];
+    xyz_values[0] = grid_info.xyz_values[0];
+    xyz_values[1] = grid_info.xyz_values[1];
+    xyz_values[2] = grid_info.xyz_values[2];
+    global_index = grid_info.global_index;
+    chart_face = grid_info.chart_face;
+    grid_fingerprint = grid_info.fingerprint;
+    if (chart_face >= 0)
+        get_cube_face_frame(chart_face, chart_frame);
 
     bool south_pole = float_eq(boundary_from_user.min_lat, -90.0);
     bool north_pole = float_eq(boundary_from_user.max_lat,  90.0);
@@ -1129,9 +1137,11 @@ Delaunay_grid_decomposition::Delaunay_grid_decomposition(Grid_info grid_info, Pr
     if (!is_local_proc_active)
         return;
 
-    global_index = new int[num_points];
-    for(int i = 0; i < num_points; i++)
-        global_index[i] = i;
+    if (global_index == NULL) {
+        global_index = new int[num_points];
+        for(int i = 0; i < num_points; i++)
+            global_index[i] = i;
+    }
 
     Boundry boundary = boundary_from_user;
     if(boundary.max_lon - boundary.min_lon < 360.0)
@@ -1172,11 +1182,18 @@ Delaunay_grid_decomposition::~Delaunay_grid_decomposition()
     delete[] global_index;
     delete[] coord_values[0];
     delete[] coord_values[1];
+    /* sub-grids share the unit vectors of the whole grid */
+    if (chart_face < 0) {
+        delete[] xyz_values[0];
+        delete[] xyz_values[1];
+        delete[] xyz_values[2];
+    }
     delete search_tree_root;
     delete[] regionID_to_unitID;
     delete[] workloads; 
     delete[] active_processing_units_flag;
     delete[] all_group_intervals;
+    delete[] is_leaf_streamed;
 
     int num_local_threads = processing_info->get_num_local_threads();
     if (buf_int)
@@ -1198,10 +1215,22 @@ int Delaunay_grid_decomposition::initialze_workloads(bool south_pole, bool north
 {
     int max_punits   = (num_points + min_points_per_chunk - 1) / min_points_per_chunk;
     int total_punits = processing_info->get_num_total_processing_units();
-    num_regions      = std::max(std::min(total_punits, max_punits), 4);
+    int active_punits = std::min(total_punits, std::max(max_punits, 4));
+
+    /* over-decomposition: each active unit gets up to over_decomposition_factor leaves */
+    num_regions      = std::max(std::min(active_punits * over_decomposition_factor, max_punits), 4);
+
+    /* a single sector is the cap itself */
+    if (num_polar_sectors < 2 || (!south_pole && !north_pole))
+        num_polar_sectors = 0;
+    num_polar_sectors = std::min(num_polar_sectors, PDLN_MAX_NUM_POLAR_SECTORS);
+
+    /* sectors' ids follow the regular ones, all of them must fit in checksum tags */
+    num_regions      = std::min(num_regions, PDLN_MAX_NUM_REGIONS - 2 * (num_polar_sectors + 1));
     average_workload = (double)num_points / num_regions;
 
     PDASSERT(min_points_per_chunk > 0);
+    PDASSERT(over_decomposition_factor > 0);
 
     double polar_workload = average_workload * (1 - PDLN_POLAR_WORKLOAD_RATE);
 
@@ -1212,9 +1241,10 @@ int Delaunay_grid_decomposition::initialze_workloads(bool south_pole, bool north
     else if (north_pole)
         average_workload += average_workload * PDLN_POLAR_WORKLOAD_RATE / (num_regions - 1);
 
-    /* +2: space for extra regions of polars' processes */
-    regionID_to_unitID = new int[num_regions+2];
-    workloads          = new double[num_regions+2];
+    /* +2: space for extra regions of polars' processes,
+     * followed by ids of the sectors of both polar caps */
+    regionID_to_unitID = new int[num_regions+2+2*(num_polar_sectors+1)];
+    workloads          = new double[num_regions+2+2*(num_polar_sectors+1)];
 
     /* the first and the last ID(0 and num_regions+1) are preserved, for the same purpose */
     int regions_id_end = num_regions+1;
@@ -1227,7 +1257,7 @@ int Delaunay_grid_decomposition::initialze_workloads(bool south_pole, bool north
         workloads[1] = polar_workload;
 
     active_processing_units_flag = new bool[processing_info->get_num_total_processing_units()];
-    processing_info->pick_out_active_processing_units(num_regions, active_processing_units_flag);
+    processing_info->pick_out_active_processing_units(active_punits, active_processing_units_flag);
 
     int  num_local_punits = processing_info->get_num_local_threads();
     int* local_punits_id = processing_info->get_local_proc_common_id();
@@ -1237,25 +1267,25 @@ int Delaunay_grid_decomposition::initialze_workloads(bool south_pole, bool north
             break;
         }
 
+    /* Regions are handed out to active units in contiguous blocks, so that
+     * leaves of the same unit stay spatially close and the mapping stays
+     * monotonic (which have_local_region_ids relies on). Leaves of the same
+     * process are scheduled dynamically among its threads later on. */
+    int* active_units_id = new int[total_punits];
+    int  num_active_units = 0;
+    for(int i = 0; i < total_punits; i++)
+        if(active_processing_units_flag[i])
+            active_units_id[num_active_units++] = i;
+    PDASSERT(num_active_units > 0);
+
     /* offset for the same purpose above */
     const int offset = 1;
-    if(total_punits > 3) {
-        for(int i = 0, regionID = 1; i < total_punits; i++)
-            if(active_processing_units_flag[i])
-                regionID_to_unitID[regionID++] = i;
-    }
-    else if(total_punits == 1)
-        regionID_to_unitID[0+offset] = regionID_to_unitID[1+offset] = regionID_to_unitID[2+offset] = regionID_to_unitID[3+offset] = 0;
-    else if(total_punits == 2) {
-        regionID_to_unitID[0+offset] = regionID_to_unitID[1+offset] = 0;
-        regionID_to_unitID[2+offset] = regionID_to_unitID[3+offset] = 1;
-    }
-    else if(total_punits == 3) {
-        regionID_to_unitID[0+offset] = 0;
-        regionID_to_unitID[1+offset] = regionID_to_unitID[2+offset] = 1;
-        regionID_to_unitID[3+offset] = 2;
-    }
+    for(int i = 0; i < num_regions; i++)
+        regionID_to_unitID[i+offset] = active_units_id[(long)i * num_active_units / num_regions];
+    regionID_to_unitID[0] = regionID_to_unitID[offset];
+    regionID_to_unitID[num_regions+1] = regionID_to_unitID[num_regions];
 
+    delete[] active_units_id;
     return regions_id_end;
 }
 
@@ -1292,7 +1322,6 @@ void Delaunay_grid_decomposition::update_workloads(int total_workload, int start
             break;
 
         if (workloads[i] > 0 && workloads[i] < min_points_per_chunk) {
-            active_processing_units_flag[i] = false;
             non_zero_regions--;
             double average_workload = workloads[i] / non_zero_regions;
             workloads[i] = 0;
@@ -1518,38 +1547,59 @@ unsigned Delaunay_grid_decomposition::compute_common_boundry(Search_tree_node *t
 }
 
 
-/* non-block */
-void Delaunay_grid_decomposition::send_checksum_to_remote(int src_common_id, int dst_common_id, unsigned long* checksum, int tag, MPI_Request** req)
+/* restrict an axis-aligned common boundary to region, invalidating it if nothing is left */
+static void clip_common_boundry(Point *head, Point *tail, const Boundry *region)
 {
-    if(processing_info->get_local_process_id() == processing_info->get_processing_unit(dst_common_id)->process_id) {
+    if (head->x == PDLN_DOUBLE_INVALID_VALUE)
+        return;
+
+    if (head->y == tail->y) {
+        head->x = std::max(head->x, region->min_lon);
+        tail->x = std::min(tail->x, region->max_lon);
+        if (head->y < region->min_lat || head->y > region->max_lat || head->x >= tail->x)
+            head->x = PDLN_DOUBLE_INVALID_VALUE;
+    } else {
+        head->y = std::max(head->y, region->min_lat);
+        tail->y = std::min(tail->y, region->max_lat);
+        if (head->x < region->min_lon || head->x > region->max_lon || head->y >= tail->y)
+            head->x = PDLN_DOUBLE_INVALID_VALUE;
+    }
+}
+
+
+/* non-block
+ * Checksums are routed by region ID rather than by thread: leaves of one
+ * process may be triangulated by any of its threads, so local packets are
+ * matched with region IDs and only remote ones go through the owner unit. */
+void Delaunay_grid_decomposition::send_checksum_to_remote(int src_region_id, int dst_region_id, unsigned long* checksum, int tag, MPI_Request** req)
+{
+    int dst_process_id = processing_info->get_processing_unit(regionID_to_unitID[dst_region_id])->process_id;
+
+    if(processing_info->get_local_process_id() == dst_process_id) {
         *req = NULL;
-        processing_info->send_to_local_thread(checksum, 1, sizeof(unsigned long),
-                                              processing_info->get_processing_unit(src_common_id)->thread_id,
-                                              processing_info->get_processing_unit(dst_common_id)->thread_id, tag);
+        processing_info->send_to_local_thread(checksum, 1, sizeof(unsigned long), src_region_id, dst_region_id, tag);
     } else {
         *req = new MPI_Request;
         #pragma omp critical
         {
-            MPI_Isend(checksum, 1, MPI_UNSIGNED_LONG, processing_info->get_processing_unit(dst_common_id)->process_id, 
-                      tag, processing_info->get_mpi_comm(), *req);
+            MPI_Isend(checksum, 1, MPI_UNSIGNED_LONG, dst_process_id, tag, processing_info->get_mpi_comm(), *req);
         }
     }
 }
 
 
-void Delaunay_grid_decomposition::recv_checksum_from_remote(int src_common_id, int dst_common_id, unsigned long* checksum, int tag, MPI_Request** req)
+void Delaunay_grid_decomposition::recv_checksum_from_remote(int src_region_id, int dst_region_id, unsigned long* checksum, int tag, MPI_Request** req)
 {
-    if(processing_info->get_local_process_id() == processing_info->get_processing_unit(src_common_id)->process_id) {
+    int src_process_id = processing_info->get_processing_unit(regionID_to_unitID[src_region_id])->process_id;
+
+    if(processing_info->get_local_process_id() == src_process_id) {
         *req = NULL;
-        processing_info->recv_from_local_thread(checksum, 1, sizeof(unsigned long),
-                                                processing_info->get_processing_unit(src_common_id)->thread_id,
-                                                processing_info->get_processing_unit(dst_common_id)->thread_id, tag);
+        processing_info->recv_from_local_thread(checksum, 1, sizeof(unsigned long), src_region_id, dst_region_id, tag);
     } else {
         *req = new MPI_Request;
         #pragma omp critical
         {
-            MPI_Irecv(checksum, 1, MPI_UNSIGNED_LONG, processing_info->get_processing_unit(src_common_id)->process_id, 
-                     tag, processing_info->get_mpi_comm(), *req);
+            MPI_Irecv(checksum, 1, MPI_UNSIGNED_LONG, src_process_id, tag, processing_info->get_mpi_comm(), *req);
         }
     }
 }
@@ -1607,7 +1657,12 @@ void Delaunay_grid_decomposition::send_recv_checksums_with_neighbors(Search_tree
 
     double threshold = std::min(search_tree_root->kernel_boundry->max_lon - search_tree_root->kernel_boundry->min_lon,
                                 search_tree_root->kernel_boundry->max_lat - search_tree_root->kernel_boundry->min_lat) /
-                       sqrt(processing_info->get_num_total_processing_units()) / 2.0;
+                       sqrt(num_regions) / 2.0;
+
+    /* Only triangles near the face are kept from a cubed-sphere sub-grid. The
+     * outermost ones, in the outer half of the apron, depend on where each leaf is projected, so they are not compared. */
+    double checked_width = (PDLN_CUBE_CHART_SCALE + boundary_from_user.max_lon) * 0.5;
+    Boundry checked_region(-checked_width, checked_width, -checked_width, checked_width);
 
     leaf_node->init_num_neighbors_on_boundry(0);
     for(unsigned i = 0; i < leaf_node->neighbors.size(); i++) {
@@ -1620,6 +1675,8 @@ void Delaunay_grid_decomposition::send_recv_checksums_with_neighbors(Search_tree
         /* compute shared boundry of leaf_node and its neighbor */
         unsigned boundry_type = compute_common_boundry(leaf_node, leaf_node->neighbors[i].first, &common_boundary_head, &common_boundary_tail,
                                               &cyclic_common_boundary_head, &cyclic_common_boundary_tail);
+        if (chart_face >= 0)
+            clip_common_boundry(&common_boundary_head, &common_boundary_tail, &checked_region);
 
         //printf("boundary: %d -> %d, (%lf, %lf)-(%lf, %lf)\n", leaf_node->region_id, leaf_node->neighbors[i].first->region_id, common_boundary_head.x, common_boundary_head.y, common_boundary_tail.x, common_boundary_tail.y);
         /* calculate checksum */
@@ -1636,7 +1693,7 @@ void Delaunay_grid_decomposition::send_recv_checksums_with_neighbors(Search_tree
         /* send and recv */
         if(common_boundary_head.x != PDLN_DOUBLE_INVALID_VALUE || cyclic_common_boundary_head.x != PDLN_DOUBLE_INVALID_VALUE) {
             MPI_Request *req;
-            send_checksum_to_remote(regionID_to_unitID[leaf_node->region_id], regionID_to_unitID[leaf_node->neighbors[i].first->region_id],
+            send_checksum_to_remote(leaf_node->region_id, leaf_node->neighbors[i].first->region_id,
                                     &local_checksums[i], PDLN_SET_TAG(leaf_node->region_id, leaf_node->neighbors[i].first->region_id, iter),
                                     &req);
 #ifdef DEBUG
@@ -1644,7 +1701,7 @@ void Delaunay_grid_decomposition::send_recv_checksums_with_neighbors(Search_tree
                 waiting_list->push_back(req);
 #endif
 
-            recv_checksum_from_remote(regionID_to_unitID[leaf_node->neighbors[i].first->region_id], regionID_to_unitID[leaf_node->region_id],
+            recv_checksum_from_remote(leaf_node->neighbors[i].first->region_id, leaf_node->region_id,
                                       &remote_checksums[i], PDLN_SET_TAG(leaf_node->neighbors[i].first->region_id, leaf_node->region_id, iter),
                                       &req);
             if (req)
@@ -1768,13 +1825,7 @@ int Delaunay_grid_decomposition::assign_polars(bool assign_south_polar, bool ass
 
         current_tree_node = search_tree_root->children[1];
         
-        if(have_local_region_ids(search_tree_root->children[0]->ids_start, search_tree_root->children[0]->ids_end))
-            local_leaf_nodes.push_back(search_tree_root->children[0]);
-        all_leaf_nodes.push_back(search_tree_root->children[0]);
-
-        if (search_tree_root->children[0]->num_kernel_points > average_workload * 4)
-            search_tree_root->children[0]->fast_triangulate = true;
-
+        assign_polar_sectors(search_tree_root->children[0], num_regions+2);
     }
     
     if(assign_north_polar) {
@@ -1837,13 +1888,7 @@ int Delaunay_grid_decomposition::assign_polars(bool assign_south_polar, bool ass
 
         current_tree_node = search_tree_root->children[1];
 
-        if(have_local_region_ids(search_tree_root->children[2]->ids_start, search_tree_root->children[2]->ids_end))
-            local_leaf_nodes.push_back(search_tree_root->children[2]);
-        all_leaf_nodes.push_back(search_tree_root->children[2]);
-
-        if (search_tree_root->children[2]->num_kernel_points > average_workload * 4)
-            search_tree_root->children[2]->fast_triangulate = true;
-
+        assign_polar_sectors(search_tree_root->children[2], num_regions+2+num_polar_sectors+1);
     }
 
     return 0;
@@ -1854,6 +1899,117 @@ fail:
 }
 
 
+void Delaunay_grid_decomposition::add_polar_leaf_node(Search_tree_node *leaf)
+{
+    if(have_local_region_ids(leaf->ids_start, leaf->ids_end))
+        local_leaf_nodes.push_back(leaf);
+    all_leaf_nodes.push_back(leaf);
+
+    if (!leaf->polar_sector && leaf->num_kernel_points > average_workload * 4)
+        leaf->fast_triangulate = true;
+}
+
+
+/* Polar cap is decomposed again into an inner cap around the pole and
+ * several angular sectors of the ring around it. As polar nodes are projected
+ * with the pole as the tangent point, longitude ranges of the ring are angular
+ * sectors on the projection plane. The inner cap keeps the apex of sectors out
+ * of their kernels, and stays on the unit of the original cap, while sectors
+ * are spread over the other units. Sectors use region ids after the regular
+ * ones, so that they are verified by the same checksum protocol. */
+void Delaunay_grid_decomposition::assign_polar_sectors(Search_tree_node *cap, int ids_start)
+{
+    double* c_points_coord[4];
+    int*    c_points_index[2] = {NULL, NULL};
+    bool*   c_points_mask[2]  = {NULL, NULL};
+    Boundry c_boundry[2];
+    int     c_num_points[2];
+    int     c_ids_start[2];
+    int     c_ids_end[2];
+
+    int num_sectors = std::min(num_polar_sectors, cap->num_kernel_points / min_points_per_chunk - 1);
+    if (num_sectors < 2) {
+        add_polar_leaf_node(cap);
+        return;
+    }
+
+    int  cap_region_id = cap->region_id;
+    bool south = cap->node_type == PDLN_NODE_TYPE_SPOLAR;
+    int  ids_end = ids_start + num_sectors + 1;
+
+    /* keep ids' units monotonic, which have_local_region_ids relies on */
+    if (south) {
+        regionID_to_unitID[ids_start] = regionID_to_unitID[cap_region_id];
+        for (int i = 1; i <= num_sectors; i++)
+            regionID_to_unitID[ids_start+i] = regionID_to_unitID[1 + (long)i * num_regions / (num_sectors+1)];
+    } else {
+        for (int i = 0; i < num_sectors; i++)
+            regionID_to_unitID[ids_start+i] = regionID_to_unitID[num_regions - (long)(num_sectors-i) * num_regions / (num_sectors+1)];
+        regionID_to_unitID[ids_end-1] = regionID_to_unitID[cap_region_id];
+    }
+
+    cap->is_leaf   = false;
+    cap->region_id = -1;
+    cap->update_region_ids(ids_start, ids_end);
+    update_workloads(cap->num_kernel_points, ids_start, ids_end, false);
+
+    cap->decompose_by_processing_units_number(workloads, c_points_coord, c_points_index, c_points_mask,
+                                              c_num_points, c_boundry, c_ids_start, c_ids_end,
+                                              south ? PDLN_DECOMPOSE_SPOLAR_MODE : PDLN_DECOMPOSE_NPOLAR_MODE,
+                                              NULL, NULL, min_points_per_chunk);
+
+    cap->children[0] = alloc_search_tree_node(cap, c_points_coord,   c_points_index[0], c_points_mask[0], c_num_points[0],
+                                              c_boundry[0], c_ids_start[0], c_ids_end[0], cap->node_type);
+    cap->children[2] = alloc_search_tree_node(cap, c_points_coord+2, c_points_index[1], c_points_mask[1], c_num_points[1],
+                                              c_boundry[1], c_ids_start[1], c_ids_end[1], cap->node_type);
+
+    Search_tree_node *inner = south ? cap->children[0] : cap->children[2];
+    Search_tree_node *ring  = south ? cap->children[2] : cap->children[0];
+
+    log(LOG_DEBUG, "polar cap of %d points divided into %d sectors\n", cap->num_kernel_points, num_sectors);
+
+    add_polar_leaf_node(inner);
+    ring->set_groups(NULL, 1);
+    decompose_polar_ring_recursively(ring);
+}
+
+
+void Delaunay_grid_decomposition::decompose_polar_ring_recursively(Search_tree_node *node)
+{
+    double* c_points_coord[4];
+    int*    c_points_index[2] = {NULL, NULL};
+    bool*   c_points_mask[2]  = {NULL, NULL};
+    Boundry c_boundry[2];
+    int     c_num_points[2];
+    int     c_ids_start[2];
+    int     c_ids_end[2];
+    int*    c_intervals[2];
+    int     c_num_intervals[2];
+
+    PDASSERT(node->ids_size() > 0);
+    if(node->ids_size() == 1) {
+        node->polar_sector = true;
+        add_polar_leaf_node(node);
+        return;
+    }
+
+    node->decompose_by_processing_units_number(workloads, c_points_coord, c_points_index, c_points_mask,
+                                               c_num_points, c_boundry, c_ids_start, c_ids_end,
+                                               PDLN_DECOMPOSE_SECTOR_MODE, c_intervals, c_num_intervals,
+                                               min_points_per_chunk);
+
+    node->children[0] = alloc_search_tree_node(node, c_points_coord,   c_points_index[0], c_points_mask[0], c_num_points[0],
+                                               c_boundry[0], c_ids_start[0], c_ids_end[0], node->node_type);
+    node->children[2] = alloc_search_tree_node(node, c_points_coord+2, c_points_index[1], c_points_mask[1], c_num_points[1],
+                                               c_boundry[1], c_ids_start[1], c_ids_end[1], node->node_type);
+    node->children[0]->set_groups(c_intervals[0], c_num_intervals[0]);
+    node->children[2]->set_groups(c_intervals[1], c_num_intervals[1]);
+
+    decompose_polar_ring_recursively(node->children[0]);
+    decompose_polar_ring_recursively(node->children[2]);
+}
+
+
 double Delaunay_grid_decomposition::is_polar_region_valid(int num_points, Boundry* boundary)
 {
     ///* 
@@ -2014,15 +2170,16 @@ Boundry Search_tree_node::expand()
 {
     Boundry expanded = *expand_boundry;
 
-    if(node_type == PDLN_NODE_TYPE_SPOLAR) {
+    if(node_type == PDLN_NODE_TYPE_SPOLAR && !polar_sector) {
         if(num_neighbors_on_boundry[PDLN_UP] > 0) expanded.max_lat += (expanded.max_lat - expanded.min_lat) * expanding_scale[PDLN_UP] / 10.;
         return expanded;
     }
-    if(node_type == PDLN_NODE_TYPE_NPOLAR) {
+    if(node_type == PDLN_NODE_TYPE_NPOLAR && !polar_sector) {
         if(num_neighbors_on_boundry[PDLN_DOWN] > 0) expanded.min_lat -= (expanded.max_lat - expanded.min_lat) * expanding_scale[PDLN_DOWN] / 10.;
         return expanded;
     }
-    if(node_type == PDLN_NODE_TYPE_COMMON) {
+    /* polar sectors are expanded on all edges, like common nodes */
+    if(node_type == PDLN_NODE_TYPE_COMMON || polar_sector) {
         if(num_neighbors_on_boundry[PDLN_UP] > 0) {
             expanded.max_lat += (expanded.max_lat - expanded.min_lat) * expanding_scale[PDLN_UP] / 10.;
             edge_expanding_count[PDLN_UP]++;
@@ -2067,7 +2224,7 @@ int Delaunay_grid_decomposition::expand_tree_node_boundry(Search_tree_node* tree
     Boundry* bound = tree_node->kernel_boundry;
     double height_length_ratio = (bound->max_lat - bound->min_lat) / (bound->max_lon - bound->min_lon);
     double quota[4];
-    if (is_polar_node(tree_node)) {
+    if (is_polar_node(tree_node) && !tree_node->polar_sector) {
         quota[PDLN_LEFT] = quota[PDLN_RIGHT] = sqrt(tree_node->num_kernel_points * height_length_ratio) * 2;
         quota[PDLN_UP] = quota[PDLN_DOWN] = sqrt(tree_node->num_kernel_points / height_length_ratio) * 2;
     } else {
@@ -2136,13 +2293,18 @@ int Delaunay_grid_decomposition::expand_tree_node_boundry(Search_tree_node* tree
         tree_node->add_expand_points(tmp_coord, tmp_index, tmp_mask, num_found);
 
 
-        if(new_boundry.max_lon - new_boundry.min_lon > (search_tree_root->kernel_boundry->max_lon - search_tree_root->kernel_boundry->min_lon) * 0.75 &&
+        /* A face sub-grid is bounded by its apron, whose width is checked when its triangles are collected */
+        if(chart_face >= 0 && new_boundry == *search_tree_root->kernel_boundry)
+            break;
+
+        if(chart_face < 0 &&
+           new_boundry.max_lon - new_boundry.min_lon > (search_tree_root->kernel_boundry->max_lon - search_tree_root->kernel_boundry->min_lon) * 0.75 &&
            new_boundry.max_lat - new_boundry.min_lat > (search_tree_root->kernel_boundry->max_lat - search_tree_root->kernel_boundry->min_lat) * 0.75) {
             log(LOG_ERROR, "region %d too large\n", tree_node->region_id);
             return 1;
         }
 
-        if(new_boundry == *search_tree_root->kernel_boundry || new_boundry.max_lon - new_boundry.min_lon > 360.0) {
+        if(new_boundry == *search_tree_root->kernel_boundry || (chart_face < 0 && new_boundry.max_lon - new_boundry.min_lon > 360.0)) {
             log(LOG_ERROR, "region %d expanded to the max\n", tree_node->region_id);
             return 1;
         }
@@ -2192,18 +2354,41 @@ static inline bool is_in_region(double x, double y, Boundry region)
 }
 
 
+/* swap values[i] and values[j] if cond, by selects instead of a branch */
+template<typename T>
+static inline void swap_if(T *values, int i, int j, bool cond)
+{
+    T value_i = values[i];
+    T value_j = values[j];
+    values[i] = cond ? value_j : value_i;
+    values[j] = cond ? value_i : value_j;
+}
+
+
+/*
+ * Move the points of [start, num) in region to the front, keeping their order.
+ * Points are classified by blocks with classify_region_points, and swapped
+ * just as a branching loop would, so the outputs do not depend on the ISA.
+ */
 int Delaunay_grid_decomposition::classify_points(double *coord[2], int *index, bool *mask, int num, Boundry region, int start)
 {
+    double bounds[4] = {region.min_lon, region.max_lon, region.min_lat, region.max_lat};
+    unsigned char flags[PDLN_POINT_BLOCK_SIZE];
+
     int j = start;
-    for (int i = start; i < num; i++)
-        if (is_in_region(coord[PDLN_LON][i], coord[PDLN_LAT][i], region)) {
-            std::swap(coord[PDLN_LON][i], coord[PDLN_LON][j]);
-            std::swap(coord[PDLN_LAT][i], coord[PDLN_LAT][j]);
-            std::swap(index[i], index[j]);
+    for (int block = start; block < num; block += PDLN_POINT_BLOCK_SIZE) {
+        int block_size = std::min(PDLN_POINT_BLOCK_SIZE, num - block);
+        classify_region_points(coord[PDLN_LON] + block, coord[PDLN_LAT] + block, block_size, bounds, flags);
+        for (int i = block; i < block + block_size; i++) {
+            bool in_region = flags[i-block];
+            swap_if(coord[PDLN_LON], i, j, in_region);
+            swap_if(coord[PDLN_LAT], i, j, in_region);
+            swap_if(index, i, j, in_region);
             if (mask)
-                std::swap(mask[i], mask[j]);
-            j++;
+                swap_if(mask, i, j, in_region);
+            j += in_region;
         }
+    }
     return j - start;
 }
 
@@ -2331,20 +2516,30 @@ vector<Search_tree_node*> Delaunay_grid_decomposition::adjust_expanding_boundry(
 }
 
 
+/*
+ * Compact the points of the four ranges that are in bound to the front. Every
+ * point is stored and the output position only advances for points in bound;
+ * it never passes the point being read, so this works in place.
+ */
 int Delaunay_grid_decomposition::move_together(double *coord[2], int *index, bool *mask, int offset[4], int num[4], Boundry bound) 
 {
+    double bounds[4] = {bound.min_lon, bound.max_lon, bound.min_lat, bound.max_lat};
+    unsigned char flags[PDLN_POINT_BLOCK_SIZE];
     int total_num = 0;
 
     for (int i = 0; i < 4; i++)
-        for (int j = offset[i]; j < offset[i]+num[i]; j++)
-            if (is_in_region(coord[PDLN_LON][j], coord[PDLN_LAT][j], bound)) {
+        for (int block = offset[i]; block < offset[i]+num[i]; block += PDLN_POINT_BLOCK_SIZE) {
+            int block_size = std::min(PDLN_POINT_BLOCK_SIZE, offset[i] + num[i] - block);
+            classify_region_points(coord[PDLN_LON] + block, coord[PDLN_LAT] + block, block_size, bounds, flags);
+            for (int j = block; j < block + block_size; j++) {
                 coord[0][total_num] = coord[0][j];
                 coord[1][total_num] = coord[1][j];
                 index[total_num] = index[j];
                 if (mask)
                     mask[total_num] = mask[j];
-                total_num++;
+                total_num += flags[j-block];
             }
+        }
     PDASSERT(total_num <= num[0] + num[1] + num[2] + num[3]);
 
     return total_num;
@@ -2457,53 +2652,159 @@ bool Delaunay_grid_decomposition::search_down_for_points_in_halo(Search_tree_nod
 }
 
 
+/* shifts of the halos checked for each point: the halo itself, and the halo moved west and east by a cycle */
+static const double halo_lon_shifts[PDLN_NO_HALO+1] = {0.0, -360.0, 360.0, 0.0};
+
+
+static void set_halo_bounds(const Boundry *inner, const Boundry *outer, Halo_bounds *bounds)
+{
+    for (int k = 0; k < 3; k++) {
+        bounds->inner[k][0] = inner->min_lon + halo_lon_shifts[k];
+        bounds->inner[k][1] = inner->max_lon + halo_lon_shifts[k];
+        bounds->inner[k][2] = inner->min_lat;
+        bounds->inner[k][3] = inner->max_lat;
+        bounds->outer[k][0] = outer->min_lon + halo_lon_shifts[k];
+        bounds->outer[k][1] = outer->max_lon + halo_lon_shifts[k];
+        bounds->outer[k][2] = outer->min_lat;
+        bounds->outer[k][3] = outer->max_lat;
+    }
+}
+
+
+/*
+ * Append the points of a block classified by classify_halo_points to the
+ * outputs, moved from the shifted halo they are in into the unshifted one.
+ * Every point is stored into a staging block and only the position advances
+ * by the code, so there is no branch per point.
+ * return the number of points appended.
+ */
+static int append_points_in_halo(double *const coord[2], const int *idx, const bool *mask, int num, const unsigned char *codes,
+                                 double *output_coord[2], int *output_index, bool *output_mask, int count)
+{
+    double lon[PDLN_POINT_BLOCK_SIZE];
+    double lat[PDLN_POINT_BLOCK_SIZE];
+    int    index[PDLN_POINT_BLOCK_SIZE];
+    bool   block_mask[PDLN_POINT_BLOCK_SIZE];
+
+    int n = 0;
+    for (int i = 0; i < num; i++) {
+        lon[n]   = coord[PDLN_LON][i] - halo_lon_shifts[codes[i]];
+        lat[n]   = coord[PDLN_LAT][i];
+        index[n] = idx[i];
+        n += codes[i] != PDLN_NO_HALO;
+    }
+    memcpy(output_coord[PDLN_LON] + count, lon, sizeof(double) * n);
+    memcpy(output_coord[PDLN_LAT] + count, lat, sizeof(double) * n);
+    memcpy(output_index + count, index, sizeof(int) * n);
+
+    if (mask) {
+        n = 0;
+        for (int i = 0; i < num; i++) {
+            block_mask[n] = mask[i];
+            n += codes[i] != PDLN_NO_HALO;
+        }
+        memcpy(output_mask + count, block_mask, sizeof(bool) * n);
+    }
+    return n;
+}
+
+
 void Search_tree_node::search_points_in_halo_internal(const Boundry *inner_boundary, const Boundry *outer_boundary,
                                              double *const coord[2], const int *idx, const bool *mask, int num_points,
                                              double *output_coord[2], int *output_index, bool *output_mask, int *num_found)
 {
-    Boundry l_inner = *inner_boundary;
-    Boundry l_outer = *outer_boundary;
-    Boundry r_inner = *inner_boundary;
-    Boundry r_outer = *outer_boundary;
-    l_inner.min_lon -= 360.0;
-    l_inner.max_lon -= 360.0;
-    l_outer.min_lon -= 360.0;
-    l_outer.max_lon -= 360.0;
-    r_inner.min_lon += 360.0;
-    r_inner.max_lon += 360.0;
-    r_outer.min_lon += 360.0;
-    r_outer.max_lon += 360.0;
+    Halo_bounds bounds;
+    set_halo_bounds(inner_boundary, outer_boundary, &bounds);
 
+    unsigned char codes[PDLN_POINT_BLOCK_SIZE];
     int count = *num_found;
+    for (int block = 0; block < num_points; block += PDLN_POINT_BLOCK_SIZE) {
+        int block_size = std::min(PDLN_POINT_BLOCK_SIZE, num_points - block);
+        double *block_coord[2] = {coord[PDLN_LON] + block, coord[PDLN_LAT] + block};
+        classify_halo_points(block_coord[PDLN_LON], block_coord[PDLN_LAT], block_size, &bounds, codes);
+        count += append_points_in_halo(block_coord, idx + block, mask ? mask + block : NULL, block_size, codes,
+                                       output_coord, output_index, output_mask, count);
+    }
 
-    for(int j = 0; j < num_points; j++) {
-        if (is_coordinate_in_halo(coord[PDLN_LON][j], coord[PDLN_LAT][j], inner_boundary, outer_boundary)) {
-            output_coord[PDLN_LON][count] = coord[PDLN_LON][j];
-            output_coord[PDLN_LAT][count] = coord[PDLN_LAT][j];
-            output_index[count] = idx[j];
-            if (mask)
-                output_mask[count] = mask[j];
-            count++;
-            continue;
+    *num_found = count;
+}
+
+
+/*
+ * Fill quantized_coord with floor((coord - base) * scale), base being the
+ * minimum of the kernel points, so that a point of cell q lies in [q, q+1)
+ * up to rounding errors far below a cell.
+ */
+void Search_tree_node::quantize_kernel_coord()
+{
+    for (int k = 0; k < 2; k++) {
+        const double *coord = kernel_coord[k];
+        double min_value = coord[0], max_value = coord[0];
+        for (int i = 1; i < num_kernel_points; i++) {
+            min_value = std::min(min_value, coord[i]);
+            max_value = std::max(max_value, coord[i]);
         }
-        if (is_coordinate_in_halo(coord[PDLN_LON][j], coord[PDLN_LAT][j], &l_inner, &l_outer)) {
-            output_coord[PDLN_LON][count] = coord[PDLN_LON][j] + 360.0;
-            output_coord[PDLN_LAT][count] = coord[PDLN_LAT][j];
-            output_index[count] = idx[j];
-            if (mask)
-                output_mask[count] = mask[j];
-            count++;
-            continue;
+
+        quantized_base[k]  = min_value;
+        quantized_scale[k] = max_value > min_value ? std::min(PDLN_QUANTIZED_CELLS / (max_value - min_value), PDLN_MAX_QUANTIZED_SCALE) : 0;
+
+        unsigned *quantized = new unsigned[num_kernel_points];
+        for (int i = 0; i < num_kernel_points; i++)
+            quantized[i] = (unsigned)((coord[i] - quantized_base[k]) * quantized_scale[k]);
+        quantized_coord[k] = quantized;
+    }
+}
+
+
+/*
+ * Halo search reading the quantized coordinates of the kernel points first: a
+ * point is skipped if, with a margin of one cell, it is out of the outer
+ * boundary or within the inner one of all shifted halos. Only the remaining
+ * points, mostly those near the boundaries, are checked by their doubles, so
+ * the result is that of search_points_in_halo_internal.
+ */
+void Search_tree_node::search_points_in_quantized_halo(const Boundry *inner_boundary, const Boundry *outer_boundary,
+                                                       double *output_coord[2], int *output_index, bool *output_mask, int *num_found)
+{
+    Halo_bounds bounds, cell_bounds;
+    set_halo_bounds(inner_boundary, outer_boundary, &bounds);
+    for (int k = 0; k < 3; k++)
+        for (int i = 0; i < 4; i++) {
+            int type = i < 2 ? PDLN_LON : PDLN_LAT;
+            cell_bounds.inner[k][i] = (bounds.inner[k][i] - quantized_base[type]) * quantized_scale[type];
+            cell_bounds.outer[k][i] = (bounds.outer[k][i] - quantized_base[type]) * quantized_scale[type];
         }
-        if (is_coordinate_in_halo(coord[PDLN_LON][j], coord[PDLN_LAT][j], &r_inner, &r_outer)) {
-            output_coord[PDLN_LON][count] = coord[PDLN_LON][j] - 360.0;
-            output_coord[PDLN_LAT][count] = coord[PDLN_LAT][j];
-            output_index[count] = idx[j];
-            if (mask)
-                output_mask[count] = mask[j];
-            count++;
-            continue;
+
+    unsigned char flags[PDLN_POINT_BLOCK_SIZE];
+    int           candidates[PDLN_POINT_BLOCK_SIZE];
+    double        lon[PDLN_POINT_BLOCK_SIZE];
+    double        lat[PDLN_POINT_BLOCK_SIZE];
+    int           index[PDLN_POINT_BLOCK_SIZE];
+    bool          mask[PDLN_POINT_BLOCK_SIZE];
+    double*       candidate_coord[2] = {lon, lat};
+
+    int count = *num_found;
+    for (int block = 0; block < num_kernel_points; block += PDLN_POINT_BLOCK_SIZE) {
+        int block_size = std::min(PDLN_POINT_BLOCK_SIZE, num_kernel_points - block);
+        classify_quantized_halo_points(quantized_coord[PDLN_LON] + block, quantized_coord[PDLN_LAT] + block, block_size,
+                                       &cell_bounds, flags);
+
+        int num_candidates = 0;
+        for (int i = 0; i < block_size; i++) {
+            candidates[num_candidates] = block + i;
+            num_candidates += flags[i];
         }
+
+        for (int i = 0; i < num_candidates; i++) {
+            lon[i]   = kernel_coord[PDLN_LON][candidates[i]];
+            lat[i]   = kernel_coord[PDLN_LAT][candidates[i]];
+            index[i] = kernel_index[candidates[i]];
+            if (kernel_mask)
+                mask[i] = kernel_mask[candidates[i]];
+        }
+        classify_halo_points(lon, lat, num_candidates, &bounds, flags);
+        count += append_points_in_halo(candidate_coord, index, kernel_mask ? mask : NULL, num_candidates, flags,
+                                       output_coord, output_index, output_mask, count);
     }
 
     *num_found = count;
@@ -2515,14 +2816,15 @@ void Search_tree_node::search_points_in_halo(const Boundry *inner_boundary, cons
 {
     if(*kernel_boundry <= *inner_boundary)
         return;
-    search_points_in_halo_internal(inner_boundary, outer_boundary, kernel_coord, kernel_index, kernel_mask, num_kernel_points, output_coord, output_index, output_mask, num_found);
-}
 
-
-inline bool Search_tree_node::is_coordinate_in_halo(double x, double y, const Boundry *inner, const Boundry *outer)
-{
-    return !(x < inner->max_lon && x >= inner->min_lon && y < inner->max_lat && y >= inner->min_lat) &&
-           (x < outer->max_lon && x >= outer->min_lon && y < outer->max_lat && y >= outer->min_lat);
+    if (PDLN_QUANTIZED_HALO_SEARCH && num_kernel_points > 0) {
+        /* leaves are searched by several threads expanding their neighbors */
+        #pragma omp critical(pdln_quantize_kernel_coord)
+        if (quantized_coord[0] == NULL)
+            quantize_kernel_coord();
+        search_points_in_quantized_halo(inner_boundary, outer_boundary, output_coord, output_index, output_mask, num_found);
+    } else
+        search_points_in_halo_internal(inner_boundary, outer_boundary, kernel_coord, kernel_index, kernel_mask, num_kernel_points, output_coord, output_index, output_mask, num_found);
 }
 
 
@@ -2578,21 +2880,18 @@ bool node_ptr_comp(Search_tree_node* a, Search_tree_node* b)
 }
 
 
-void Delaunay_grid_decomposition::set_binding_relationship()
+/* heavier leaves first, so that dynamic scheduling balances the tail */
+bool node_workload_comp(Search_tree_node* a, Search_tree_node* b)
 {
-    if (local_leaf_nodes.size() == 0)
-        return;
+    if (a->num_kernel_points != b->num_kernel_points)
+        return a->num_kernel_points > b->num_kernel_points;
+    return a->region_id < b->region_id;
+}
 
-    std::sort(local_leaf_nodes.begin(), local_leaf_nodes.end(), node_ptr_comp);
 
-    int old_unit_id = regionID_to_unitID[local_leaf_nodes[0]->region_id];
-    for (unsigned i = 1; i < local_leaf_nodes.size(); i++) {
-        if (local_leaf_nodes[i]->region_id == old_unit_id) {
-            local_leaf_nodes[i-1]->bind_with = i;
-            local_leaf_nodes[i]->is_bind = true;
-        } else
-            old_unit_id = local_leaf_nodes[i]->region_id;
-    }
+void Delaunay_grid_decomposition::schedule_local_leaf_nodes()
+{
+    std::sort(local_leaf_nodes.begin(), local_leaf_nodes.end(), node_workload_comp);
 }
 
 
@@ -2610,10 +2909,10 @@ int Delaunay_grid_decomposition::generate_trianglulation_for_local_decomp()
     }
 #endif
 
-    /* Bind nodes if needed */
-    set_binding_relationship();
+    /* Local leaves are handed out to threads dynamically */
+    schedule_local_leaf_nodes();
 
-    int max_neighbors = std::max(processing_info->get_num_total_processing_units(), 4); //TODO: stop using so large upper bound
+    int max_neighbors = num_regions + 2 + 2 * (num_polar_sectors + 1); //TODO: stop using so large upper bound
     for(unsigned i = 0; i < local_leaf_nodes.size(); i++) {
         local_leaf_checksums[i] = new unsigned long[max_neighbors];
         remote_leaf_checksums[i] = new unsigned long[max_neighbors];
@@ -2663,7 +2962,7 @@ int Delaunay_grid_decomposition::generate_trianglulation_for_local_decomp()
 
             /* search points in boundarys */
             goon = 0;
-            #pragma omp parallel for
+            #pragma omp parallel for schedule(dynamic)
             for(unsigned i = 0; i < local_leaf_nodes.size(); i++)
                 if(!is_local_leaf_node_finished[i]) {
                     int local_ret = expand_tree_node_boundry(local_leaf_nodes[i], expanding_ratio);
@@ -2696,18 +2995,11 @@ int Delaunay_grid_decomposition::generate_trianglulation_for_local_decomp()
         gettimeofday(&start, NULL);
 
         if (local_leaf_nodes.size() > 0)
-            if (is_polar_node(search_tree_root->children[0]) || is_polar_node(search_tree_root->children[2])) {
-                #pragma omp parallel for
-                for(unsigned i = 0; i < local_leaf_nodes.size(); i++) {
-                    if (local_leaf_nodes[i]->is_bind)
-                        continue;
-                    for(unsigned cur = i;;) {
-                        if (!is_local_leaf_node_finished[cur])
-                            local_leaf_nodes[cur]->project_grid();
-                        cur = local_leaf_nodes[cur]->bind_with;
-                        if (cur == 0) break;
-                    }
-                }
+            if (chart_face >= 0 || is_polar_node(search_tree_root->children[0]) || is_polar_node(search_tree_root->children[2])) {
+                #pragma omp parallel for schedule(dynamic)
+                for(unsigned i = 0; i < local_leaf_nodes.size(); i++)
+                    if (!is_local_leaf_node_finished[i])
+                        local_leaf_nodes[i]->project_grid(xyz_values, chart_face >= 0 ? chart_frame : NULL);
             }
 
         gettimeofday(&end, NULL);
@@ -2718,17 +3010,11 @@ int Delaunay_grid_decomposition::generate_trianglulation_for_local_decomp()
         log(LOG_DEBUG, "updating triangulation\n");
         MPI_Barrier(processing_info->get_mpi_comm());
         gettimeofday(&start, NULL);
-        #pragma omp parallel for
-        for(unsigned i = 0; i < local_leaf_nodes.size(); i++) {
-            if (local_leaf_nodes[i]->is_bind)
-                continue;
-            for(unsigned cur = i;;) {
-                if (!is_local_leaf_node_finished[cur])
-                    local_leaf_nodes[cur]->generate_local_triangulation(is_cyclic, num_points - num_fence_points, num_fence_points, num_points > 1e6);
-                cur = local_leaf_nodes[cur]->bind_with;
-                if (cur == 0) break;
-            }
-        }
+        #pragma omp parallel for schedule(dynamic)
+        for(unsigned i = 0; i < local_leaf_nodes.size(); i++)
+            if (!is_local_leaf_node_finished[i])
+                local_leaf_nodes[i]->generate_local_triangulation(is_cyclic, num_points - num_fence_points, num_fence_points, num_points > 1e6,
+                                                                  chart_face >= 0);
 
         gettimeofday(&end, NULL);
 
@@ -2760,6 +3046,10 @@ int Delaunay_grid_decomposition::generate_trianglulation_for_local_decomp()
         #pragma omp parallel for
         for(unsigned i = 0; i < local_leaf_nodes.size(); i++) {
             is_local_leaf_node_finished[i] = are_checksums_identical(local_leaf_nodes[i], local_leaf_checksums[i], remote_leaf_checksums[i]);
+            /* A leaf holding a whole face sub-grid can not expand further. Its triangles with
+             * circumcircles inside the sub-grid, the only ones the face keeps, are final. */
+            if (chart_face >= 0 && *local_leaf_nodes[i]->expand_boundry == *search_tree_root->kernel_boundry)
+                is_local_leaf_node_finished[i] = true;
             //if(iter>=1)
             //    is_local_leaf_node_finished[i] = true;
         }
@@ -2768,6 +3058,12 @@ int Delaunay_grid_decomposition::generate_trianglulation_for_local_decomp()
             time_consisty_check += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
         }
 
+        if (stream_triangles) {
+            stream_finished_leaves(is_local_leaf_node_finished, iter);
+            if (processing_info->get_local_process_id() == 0)
+                recv_streamed_triangles(-1);
+        }
+
         unsigned local_finish = 1;
         for(unsigned i = 0; i < local_leaf_nodes.size(); i++)
             if(!is_local_leaf_node_finished[i])
@@ -2785,6 +3081,9 @@ int Delaunay_grid_decomposition::generate_trianglulation_for_local_decomp()
 
     delete[] is_local_leaf_node_finished;
 
+    if (stream_triangles)
+        finish_triangle_streaming();
+
     for(unsigned i = 0; i < local_leaf_nodes.size(); i++) {
         delete[] local_leaf_checksums[i];
         delete[] remote_leaf_checksums[i];
@@ -2863,171 +3162,561 @@ static inline bool on_a_line(Triangle_inline* t)
 }
 
 
-void delete_redundent_triangles(Triangle_inline *&all_triangles, int &num)
+/* ids: vertex-id triplets of all triangles; xyz: unit vectors of the grid, indexed by id */
+void Delaunay_grid_decomposition::save_triangles_into_file(Processing_resource *processing_info, double **xyz, int num_points,
+                                                           int *ids, int num_triangles, bool sort)
 {
-    std::tr1::unordered_map<Triangle_inline, std::list<int> > hash_table;
-    std::tr1::unordered_map<Triangle_inline, std::list<int> >::iterator it_hash;
-
-    if(num == 0)
-        return;
-
-    Triangle_inline *tmp_triangles = new Triangle_inline[num];
+    if (sort || PDLN_HILBERT_ORDER) {
+        int num_unique = sort_triangle_ids(ids, num_triangles);
+        PDASSERT(num_unique == num_triangles);
+        num_triangles = num_unique;
+    }
+    if (PDLN_HILBERT_ORDER)
+        order_triangle_ids_by_hilbert_curve(ids, num_triangles, xyz);
+    if (PDLN_VERTEX_PERMUTATION)
+        save_vertex_permutation(processing_info, xyz, num_points);
 
-    int count = 0;
-    for(int i = 0; i < num; i++) {
-        if (on_a_line(&all_triangles[i]))
-            continue;
+#ifndef TIME_PERF 
+    char file_fmt[] = "log/global_triangles_%d";
+    char filename[64];
+    snprintf(filename, 64, file_fmt, processing_info->get_num_total_processing_units());
+    FILE *fp = fopen(filename, "w");
+    for(int i = 0; i < num_triangles; i++)
+        fprintf(fp, "%d, %d, %d\n", ids[i*3], ids[i*3+1], ids[i*3+2]);
+    fclose(fp);
+#endif
 
-        it_hash = hash_table.find(all_triangles[i]);
-        if(it_hash != hash_table.end()) {
-            bool same = false;
-            for(std::list<int>::iterator it_list = it_hash->second.begin(); it_list != it_hash->second.end(); it_list ++)
-                if(all_triangles[*it_list] == all_triangles[i]) {
-                    same = true;
-                    break;
-                }
-            if(same)
-                continue;
-            else {
-                it_hash->second.push_back(i);
-                tmp_triangles[count++] = all_triangles[i];
-            }
-        }
-        else {
-            hash_table[all_triangles[i]].push_back(i);
-            tmp_triangles[count++] = all_triangles[i];
+#ifdef OPENCV
+    /* coordinates are not sent along with triangles, recover them from unit vectors */
+    Triangle_inline *triangles = new Triangle_inline[num_triangles];
+    for(int i = 0; i < num_triangles; i++) {
+        Point p[3];
+        for(int k = 0; k < 3; k++) {
+            int id = ids[i*3+k];
+            double lon = RADIAN_TO_DEGREE(atan2(xyz[0][id], xyz[2][id]));
+            double lat = RADIAN_TO_DEGREE(asin(xyz[1][id]));
+            p[k] = Point(lon < 0 ? lon + 360 : lon, lat, id);
         }
+        triangles[i] = Triangle_inline(p[0], p[1], p[2]);
+        triangles[i].check_cyclic();
     }
 
-    delete[] all_triangles;
-    all_triangles = tmp_triangles;
-    num = count;
-
-    return;
+    char file_fmt3[] = "log/image_global_triangles_%d";
+    char filename3[64];
+    snprintf(filename3, 64, file_fmt3, processing_info->get_num_total_processing_units());
+    plot_triangles_into_file(filename3, triangles, num_triangles, true);
+    delete[] triangles;
+#endif
 }
 
 
-void Delaunay_grid_decomposition::save_unique_triangles_into_file(Triangle_inline *&triangles, int num_triangles, bool sort)
+/*
+ * Save the grid points in the order of the Hilbert curve as log/vertex_permutation_<n>,
+ * the i-th entry being the global index of the i-th point, so that consumers can renumber
+ * vertices to match the order of triangles. Binary outputs save it as native ints.
+ */
+void Delaunay_grid_decomposition::save_vertex_permutation(Processing_resource *processing_info, double **xyz, int num_points)
 {
-    int num_different_triangles;
-    if (sort) {
-        sort_points_in_triangle(triangles, num_triangles);
-        sort_triangles(triangles, num_triangles);
-        int i, j;
-        for(i = 0, j = 1; j < num_triangles; j++) {
-            if((triangles[i].v[0].id == triangles[j].v[0].id &&
-                triangles[i].v[1].id == triangles[j].v[1].id &&
-                triangles[i].v[2].id == triangles[j].v[2].id) ||
-               on_a_line(&triangles[j])) {
-                continue;
-            }
-            else
-                triangles[++i] = triangles[j];
-        }
-        num_different_triangles = i + 1;
-    } else {
-        delete_redundent_triangles(triangles, num_triangles);
-        num_different_triangles = num_triangles;
-    }
+    int *order = new int[num_points];
+    order_points_by_hilbert_curve(xyz, num_points, order);
 
-#ifndef TIME_PERF 
-    char file_fmt[] = "log/global_triangles_%d";
+#ifndef TIME_PERF
     char filename[64];
-    snprintf(filename, 64, file_fmt, processing_info->get_num_total_processing_units());
+#ifdef PDLN_BINARY_OUTPUT
+    snprintf(filename, 64, "log/vertex_permutation_%d.bin", processing_info->get_num_total_processing_units());
+    FILE *fp = fopen(filename, "wb");
+    fwrite(order, sizeof(int), num_points, fp);
+#else
+    snprintf(filename, 64, "log/vertex_permutation_%d", processing_info->get_num_total_processing_units());
     FILE *fp = fopen(filename, "w");
-    for(int i = 0; i < num_different_triangles; i++)
-        fprintf(fp, "%d, %d, %d\n", triangles[i].v[0].id, triangles[i].v[1].id, triangles[i].v[2].id);
+    for(int i = 0; i < num_points; i++)
+        fprintf(fp, "%d\n", order[i]);
+#endif
     fclose(fp);
 #endif
 
-    /*
-    char filename2[64];
-    FILE *fp2;
-    char file_fmt1[] = "log/global_triangles_coord_%d";
-    snprintf(filename2, 64, file_fmt1, processing_info->get_num_total_processing_units());
-    fp2 = fopen(filename2, "w");
-    for(int i = 0; i < num_different_triangles; i++)
-        fprintf(fp2, "%d, %d, %d, %lf, %lf, %lf, %lf, %lf, %lf\n", triangles[i].v[0].id, triangles[i].v[1].id, triangles[i].v[2].id, triangles[i].v[0].x, triangles[i].v[0].y, triangles[i].v[1].x, triangles[i].v[1].y, triangles[i].v[2].x, triangles[i].v[2].y);
-    fclose(fp2);
-    */
+    delete[] order;
+}
 
-#ifdef OPENCV
-    char file_fmt3[] = "log/image_global_triangles_%d";
-    char filename3[64];
-    snprintf(filename3, 64, file_fmt3, processing_info->get_num_total_processing_units());
-    plot_triangles_into_file(filename3, triangles, num_different_triangles, true);
-#endif
+
+/* Let n be the number of points, if there are b vertices on the convex hull,
+ * then any triangulation of the points has at most 2n − 2 − b triangles,
+ * plus one exterior face */
+int Delaunay_grid_decomposition::max_num_leaf_triangles(Search_tree_node *leaf)
+{
+    return (leaf->num_kernel_points + leaf->num_expand_points) * 3 * 2;
 }
 
 
-#define PDLN_MERGE_TAG_MASK 0x0200
-void Delaunay_grid_decomposition::merge_all_triangles(bool sort)
+/* triangles owned by the leaf, except degenerated ones on a line of constant reference coordinate */
+int Delaunay_grid_decomposition::get_leaf_owned_triangles(Search_tree_node *leaf, Triangle_inline *triangles, int buf_len)
 {
-    /* Let n be the number of points, if there are b vertices on the convex hull,
-     * then any triangulation of the points has at most 2n − 2 − b triangles,
-     * plus one exterior face */
+    int num_triangles = 0;
+    leaf->triangulation->get_owned_triangles(leaf->num_kernel_points, triangles, &num_triangles, buf_len);
+
+    int num_valid_triangles = 0;
+    for(int i = 0; i < num_triangles; i++)
+        if (!on_a_line(&triangles[i]))
+            triangles[num_valid_triangles++] = triangles[i];
+    return num_valid_triangles;
+}
+
 
+/* triangles owned by local leaves, each triangle of the grid is owned by exactly one leaf;
+ * the caller frees the buffer */
+int Delaunay_grid_decomposition::get_local_triangles(Triangle_inline **triangles)
+{
     int local_buf_len = 0;
     for(unsigned i = 0; i < local_leaf_nodes.size(); i++)
-        local_buf_len += (local_leaf_nodes[i]->num_kernel_points + local_leaf_nodes[i]->num_expand_points) * 3 * 2;
+        local_buf_len += max_num_leaf_triangles(local_leaf_nodes[i]);
 
     Triangle_inline* local_triangles = new Triangle_inline[local_buf_len];
     int num_local_triangles = 0;
-    int num_triangles = 0;
-    for(unsigned int i = 0; i < local_leaf_nodes.size(); i++) {
-        local_leaf_nodes[i]->triangulation->get_triangles_in_region(local_leaf_nodes[i]->kernel_boundry->min_lon, local_leaf_nodes[i]->kernel_boundry->max_lon,
-                                                                    local_leaf_nodes[i]->kernel_boundry->min_lat, local_leaf_nodes[i]->kernel_boundry->max_lat,
-                                                                    local_triangles + num_local_triangles, &num_triangles, local_buf_len - num_local_triangles); // This function call is un-class-elegant
-        num_local_triangles += num_triangles;
+    for(unsigned int i = 0; i < local_leaf_nodes.size(); i++)
+        num_local_triangles += get_leaf_owned_triangles(local_leaf_nodes[i], local_triangles + num_local_triangles,
+                                                        local_buf_len - num_local_triangles);
+
+    *triangles = local_triangles;
+    return num_local_triangles;
+}
+
+
+/*
+ * With streaming, each leaf sends its owned triangles to process 0 as soon as
+ * its checksums agree with its neighbors', so the gathering overlaps the
+ * remaining iterations. A leaf may disagree again later, when a neighbor
+ * changes; it is then re-triangulated and sent again, and the newer message
+ * replaces the older one on process 0. Process 0 only buffers the leaves and
+ * writes them all once the iterations end.
+ * Every leaf is a point-to-point message to process 0, unlike the hierarchical
+ * gather of gather_triangle_ids, so streaming only pays off with few processes
+ * and iterations whose tails are long. It is off by default, and does not apply
+ * to binary outputs, which are written in place by each process.
+ */
+void Delaunay_grid_decomposition::set_triangle_streaming(bool on)
+{
+#ifdef PDLN_BINARY_OUTPUT
+    stream_triangles = false;
+#else
+    stream_triangles = on;
+#endif
+}
+
+
+#define PDLN_STREAM_TAG (0x10000000)
+/* message: region id, iteration, then id triplets */
+void Delaunay_grid_decomposition::stream_finished_leaves(const bool *is_leaf_finished, int iter)
+{
+    int num_leaves = local_leaf_nodes.size();
+
+    if (is_leaf_streamed == NULL)
+        is_leaf_streamed = new bool[num_leaves]();
+
+    vector<int> leaves_to_send;
+    for(int i = 0; i < num_leaves; i++) {
+        if (!is_leaf_finished[i])
+            is_leaf_streamed[i] = false;
+        else if (!is_leaf_streamed[i]) {
+            leaves_to_send.push_back(i);
+            is_leaf_streamed[i] = true;
+        }
+    }
+
+    int num_sending = leaves_to_send.size();
+    vector<int*> buffers(num_sending);
+    vector<int>  lengths(num_sending);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int j = 0; j < num_sending; j++) {
+        Search_tree_node *leaf = local_leaf_nodes[leaves_to_send[j]];
+        int buf_len = max_num_leaf_triangles(leaf);
+        Triangle_inline *triangles = new Triangle_inline[buf_len];
+        int num_triangles = get_leaf_owned_triangles(leaf, triangles, buf_len);
+
+        buffers[j] = new int[2 + num_triangles * 3];
+        buffers[j][0] = leaf->region_id;
+        buffers[j][1] = iter;
+        for(int i = 0; i < num_triangles; i++)
+            for(int k = 0; k < 3; k++)
+                buffers[j][2+i*3+k] = triangles[i].v[k].id;
+        lengths[j] = 2 + num_triangles * 3;
+        delete[] triangles;
+    }
+
+    for(int j = 0; j < num_sending; j++) {
+        MPI_Request request;
+        MPI_Isend(buffers[j], lengths[j], MPI_INT, 0, PDLN_STREAM_TAG, processing_info->get_mpi_comm(), &request);
+        stream_requests.push_back(request);
+        stream_buffers.push_back(buffers[j]);
+    }
+}
+
+
+/* on process 0, receive streamed leaves, either those already arrived (num_expected < 0)
+ * or until num_expected messages have been received in total */
+void Delaunay_grid_decomposition::recv_streamed_triangles(int num_expected)
+{
+    MPI_Comm comm = processing_info->get_mpi_comm();
+
+    while (true) {
+        MPI_Status status;
+        if (num_expected < 0) {
+            int flag;
+            MPI_Iprobe(MPI_ANY_SOURCE, PDLN_STREAM_TAG, comm, &flag, &status);
+            if (!flag)
+                break;
+        } else {
+            if (num_streamed_received >= num_expected)
+                break;
+            MPI_Probe(MPI_ANY_SOURCE, PDLN_STREAM_TAG, comm, &status);
+        }
+
+        int count;
+        MPI_Get_count(&status, MPI_INT, &count);
+        vector<int> message(count);
+        MPI_Recv(&message[0], count, MPI_INT, status.MPI_SOURCE, PDLN_STREAM_TAG, comm, MPI_STATUS_IGNORE);
+        num_streamed_received++;
+
+        pair<int, vector<int> >& leaf = streamed_triangles[message[0]];
+        if (message[1] >= leaf.first) {
+            if (!leaf.second.empty())
+                log(LOG_DEBUG, "leaf %d is streamed again at iteration %d\n", message[0], message[1]);
+            leaf.first = message[1];
+            leaf.second.assign(message.begin() + 2, message.end());
+        }
     }
+}
+
+
+/* receive the rest of streamed leaves on process 0 and complete all sends */
+void Delaunay_grid_decomposition::finish_triangle_streaming()
+{
+    int num_sent = stream_requests.size();
+    int num_all_sent = 0;
+    MPI_Reduce(&num_sent, &num_all_sent, 1, MPI_INT, MPI_SUM, 0, processing_info->get_mpi_comm());
+
+    if (processing_info->get_local_process_id() == 0)
+        recv_streamed_triangles(num_all_sent);
+
+    if (num_sent > 0)
+        MPI_Waitall(num_sent, &stream_requests[0], MPI_STATUSES_IGNORE);
+    for(unsigned i = 0; i < stream_buffers.size(); i++)
+        delete[] stream_buffers[i];
+    stream_requests.clear();
+    stream_buffers.clear();
+}
+
+
+void Delaunay_grid_decomposition::merge_all_triangles(bool sort)
+{
+    /* finish_triangle_streaming has received all leaves on process 0 */
+    if (stream_triangles) {
+        if (processing_info->get_local_process_id() == 0) {
+            typedef std::map<int, pair<int, vector<int> > >::iterator Leaf_iter;
+            int num_all_triangles = 0;
+            for (Leaf_iter it = streamed_triangles.begin(); it != streamed_triangles.end(); ++it)
+                num_all_triangles += it->second.second.size() / 3;
+
+            int *all_ids = new int[num_all_triangles * 3];
+            int *ids = all_ids;
+            for (Leaf_iter it = streamed_triangles.begin(); it != streamed_triangles.end(); ++it) {
+                std::copy(it->second.second.begin(), it->second.second.end(), ids);
+                ids += it->second.second.size();
+            }
+            streamed_triangles.clear();
+
+            save_triangles_into_file(processing_info, xyz_values, num_points, all_ids, num_all_triangles, sort);
+            delete[] all_ids;
+        }
+        return;
+    }
+
+    Triangle_inline* local_triangles;
+    int num_local_triangles = get_local_triangles(&local_triangles);
+
+    merge_triangles_into_file(processing_info, grid_fingerprint, xyz_values, num_points, local_triangles, num_local_triangles, sort);
+    delete[] local_triangles;
+}
+
+
+/*
+ * Triangles owned by the local leaves with num_ghost_layers layers of ghost
+ * triangles, on each process, without any global file. Collective.
+ */
+void Delaunay_grid_decomposition::get_local_mesh(int num_ghost_layers, Local_mesh *mesh)
+{
+    Triangle_inline* local_triangles;
+    int num_local_triangles = get_local_triangles(&local_triangles);
+
+    make_local_mesh(processing_info, local_triangles, num_local_triangles, num_ghost_layers, mesh);
+    delete[] local_triangles;
+}
+
+
+void Delaunay_grid_decomposition::make_local_mesh(Processing_resource *processing_info, Triangle_inline *local_triangles,
+                                                  int num_local_triangles, int num_ghost_layers, Local_mesh *mesh)
+{
+    int *ids = new int[num_local_triangles * 3];
+    for(int i = 0; i < num_local_triangles; i++)
+        for(int k = 0; k < 3; k++)
+            ids[i*3+k] = local_triangles[i].v[k].id;
+
+    build_local_mesh(processing_info->get_mpi_comm(), ids, num_local_triangles, num_ghost_layers, mesh);
+    delete[] ids;
+}
+
+
+/*
+ * Gather vertex-id triplets to process 0 in two levels: processes of a node
+ * write theirs into a buffer shared with the node leader, which is process 0
+ * of the node, then node leaders send their buffers with one MPI_Gatherv.
+ * return the triplets of all processes on process 0, NULL elsewhere.
+ */
+static int *gather_triangle_ids(MPI_Comm comm, int *ids, int num_triangles, int *num_all_triangles)
+{
+    int rank, node_rank;
+    MPI_Comm node_comm, leader_comm;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+
+    int node_offset = 0;
+    int num_node_triangles = 0;
+    MPI_Exscan(&num_triangles, &node_offset, 1, MPI_INT, MPI_SUM, node_comm);
+    MPI_Allreduce(&num_triangles, &num_node_triangles, 1, MPI_INT, MPI_SUM, node_comm);
+    if (node_rank == 0)
+        node_offset = 0;
+
+    int *node_ids;
+    MPI_Win win;
+    MPI_Win_allocate_shared(node_rank == 0 ? (MPI_Aint)num_node_triangles * 3 * sizeof(int) : 0, sizeof(int),
+                            MPI_INFO_NULL, node_comm, &node_ids, &win);
+    if (node_rank != 0) {
+        MPI_Aint size;
+        int disp_unit;
+        MPI_Win_shared_query(win, 0, &size, &disp_unit, &node_ids);
+    }
+
+    MPI_Win_fence(0, win);
+    memcpy(node_ids + node_offset * 3, ids, num_triangles * 3 * sizeof(int));
+    MPI_Win_fence(0, win);
+
+    int *all_ids = NULL;
+    *num_all_triangles = 0;
+
+    /* process 0 is the leader of its node and the first leader */
+    MPI_Comm_split(comm, node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &leader_comm);
+    if (leader_comm != MPI_COMM_NULL) {
+        int leader_rank, num_leaders;
+        MPI_Comm_rank(leader_comm, &leader_rank);
+        MPI_Comm_size(leader_comm, &num_leaders);
+
+        int num_node_ids = num_node_triangles * 3;
+        int *counts = NULL;
+        int *displs = NULL;
+        if (leader_rank == 0) {
+            counts = new int[num_leaders];
+            displs = new int[num_leaders];
+        }
+        MPI_Gather(&num_node_ids, 1, MPI_INT, counts, 1, MPI_INT, 0, leader_comm);
+
+        if (leader_rank == 0) {
+            for (int i = 0; i < num_leaders; i++) {
+                displs[i] = *num_all_triangles * 3;
+                *num_all_triangles += counts[i] / 3;
+            }
+            all_ids = new int[*num_all_triangles * 3];
+        }
+        MPI_Gatherv(node_ids, num_node_ids, MPI_INT, all_ids, counts, displs, MPI_INT, 0, leader_comm);
+
+        delete[] counts;
+        delete[] displs;
+        MPI_Comm_free(&leader_comm);
+    }
+
+    MPI_Win_free(&win);
+    MPI_Comm_free(&node_comm);
+    return all_ids;
+}
+
+
+/* xyz: unit vectors of the grid, used for the Hilbert order and for plotting */
+void Delaunay_grid_decomposition::merge_triangles_into_file(Processing_resource *processing_info, unsigned long long grid_fingerprint,
+                                                            double **xyz, int num_points, Triangle_inline *local_triangles,
+                                                            int num_local_triangles, bool sort)
+{
+#ifdef PDLN_BINARY_OUTPUT
+    write_triangles_into_binary_file(processing_info, grid_fingerprint, xyz, num_points, local_triangles, num_local_triangles, sort);
+    return;
+#endif
 
     MPI_Barrier(processing_info->get_mpi_comm());
 
+    int *ids = new int[num_local_triangles * 3];
+    for(int i = 0; i < num_local_triangles; i++)
+        for(int k = 0; k < 3; k++)
+            ids[i*3+k] = local_triangles[i].v[k].id;
+
+    int num_all_triangles;
+    int *all_ids = gather_triangle_ids(processing_info->get_mpi_comm(), ids, num_local_triangles, &num_all_triangles);
+    delete[] ids;
+
     if(processing_info->get_local_process_id() == 0) {
-        int *num_remote_triangles = new int[processing_info->get_num_total_processes()];
-        int remote_buf_len = 0;
-        MPI_Status status;
+        save_triangles_into_file(processing_info, xyz, num_points, all_ids, num_all_triangles, sort);
+        delete[] all_ids;
+    }
+}
 
-        for(int i = 1; i < processing_info->get_num_total_processes(); i++)
-            MPI_Recv(&num_remote_triangles[i], 1, MPI_INT, i, PDLN_MERGE_TAG_MASK, processing_info->get_mpi_comm(), &status);
-        for(int i = 1; i < processing_info->get_num_total_processes(); i++) {
-            //PDASSERT(num_remote_triangles[i] > min_points_per_chunk/2);
-            remote_buf_len += num_remote_triangles[i];
-        }
-        Triangle_inline *remote_triangles = new Triangle_inline[remote_buf_len + num_local_triangles];
-
-        int count = 0;
-        for(int i = 1; i < processing_info->get_num_total_processes(); i++) {
-            MPI_Recv(remote_triangles + count, num_remote_triangles[i] * sizeof(Triangle_inline), MPI_CHAR, i, PDLN_MERGE_TAG_MASK, processing_info->get_mpi_comm(), &status);
-            int tmp_count;
-            MPI_Get_count(&status, MPI_CHAR, &tmp_count);
-            
-            /*
-            char filename[64];
-            snprintf(filename, 64, "log/process_local_triangles%d", i);
-            plot_triangles_into_file(filename, remote_triangles+count, tmp_count/sizeof(Triangle_inline));
-
-            for(int j = 0; j < tmp_count/sizeof(Triangle_inline); j++)
-                printf("%d, %d, %d\n", (remote_triangles + count)[j].v[0].id, (remote_triangles + count)[j].v[1].id, (remote_triangles + count)[j].v[2].id);
-            printf("==============\n");
-            */
-#ifdef DEBUG
-            PDASSERT(tmp_count % sizeof(Triangle_inline) == 0);
+
+/* copy num values into a new buffer of index_width-byte integers */
+template <typename T>
+static void* convert_to_index_width(const T *values, int num, unsigned index_width)
+{
+    if (index_width == sizeof(int)) {
+        int *buf = new int[num];
+        for (int i = 0; i < num; i++)
+            buf[i] = values[i];
+        return buf;
+    } else {
+        long long *buf = new long long[num];
+        for (int i = 0; i < num; i++)
+            buf[i] = values[i];
+        return buf;
+    }
+}
+
+
+static void delete_index_buffer(void *buf, unsigned index_width)
+{
+    if (index_width == sizeof(int))
+        delete[] (int*)buf;
+    else
+        delete[] (long long*)buf;
+}
+
+
+/*
+ * Each process writes its own triangles at its offset in log/global_triangles_<n>.bin, a mesh
+ * file as described in mesh_file.h, with collective calls, no triangle passes through process 0.
+ * Triangles are only sorted, or ordered along the Hilbert curve, within each process,
+ * so within each block of the file.
+ * With PDLN_ADJACENCY_OUTPUT, the triangle neighbors and the vertex graph are built
+ * across the processes and written the same way.
+ */
+void Delaunay_grid_decomposition::write_triangles_into_binary_file(Processing_resource *processing_info, unsigned long long grid_fingerprint,
+                                                                   double **xyz, int num_points, Triangle_inline *local_triangles,
+                                                                   int num_local_triangles, bool sort)
+{
+    MPI_Comm comm = processing_info->get_mpi_comm();
+
+    int *local_ids = new int[num_local_triangles * 3];
+    for (int i = 0; i < num_local_triangles; i++)
+        for (int k = 0; k < 3; k++)
+            local_ids[i*3+k] = local_triangles[i].v[k].id;
+
+    if (sort || PDLN_HILBERT_ORDER)
+        num_local_triangles = sort_triangle_ids(local_ids, num_local_triangles);
+    if (PDLN_HILBERT_ORDER)
+        order_triangle_ids_by_hilbert_curve(local_ids, num_local_triangles, xyz);
+
+    /* [0]: triangles, [1]: blocks */
+    long long local_counts[2] = {num_local_triangles, (num_local_triangles + PDLN_MESH_BLOCK_SIZE - 1) / PDLN_MESH_BLOCK_SIZE};
+    long long prev_counts[2] = {0, 0};
+    long long all_counts[2];
+    MPI_Exscan(local_counts, prev_counts, 2, MPI_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(local_counts, all_counts, 2, MPI_LONG_LONG, MPI_SUM, comm);
+    if (processing_info->get_local_process_id() == 0)
+        prev_counts[0] = prev_counts[1] = 0;
+
+    bool single_process = processing_info->get_num_total_processes() == 1;
+    unsigned ordering = PDLN_MESH_ORDER_NONE;
+    if (PDLN_HILBERT_ORDER)
+        ordering = single_process ? PDLN_MESH_ORDER_HILBERT : PDLN_MESH_ORDER_HILBERT_IN_BLOCK;
+    else if (sort)
+        ordering = single_process ? PDLN_MESH_ORDER_IDS : PDLN_MESH_ORDER_IDS_IN_BLOCK;
+
+    bool has_adjacency = false;
+    Mesh_adjacency adjacency;
+#ifdef PDLN_ADJACENCY_OUTPUT
+    if (build_mesh_adjacency(comm, local_ids, num_local_triangles, prev_counts[0], num_points, &adjacency) != 0)
+        log(LOG_WARNING, "the triangulation is not a manifold, its adjacency may be incomplete\n");
+    has_adjacency = true;
 #endif
-            count += tmp_count / sizeof(Triangle_inline);
+
+    Mesh_file_header header;
+    init_mesh_file_header(&header, grid_fingerprint, num_points, all_counts[0], all_counts[1], ordering, has_adjacency,
+                          has_adjacency, has_adjacency ? adjacency.num_all_vertex_neighbors : 0);
+
+    int num_blocks = local_counts[1];
+    Mesh_block_entry *blocks = new Mesh_block_entry[num_blocks];
+    for (int i = 0; i < num_blocks; i++) {
+        int start = i * PDLN_MESH_BLOCK_SIZE;
+        int end   = std::min(start + PDLN_MESH_BLOCK_SIZE, num_local_triangles);
+        int min_id = local_ids[start*3];
+        int max_id = min_id;
+        for (int j = start*3; j < end*3; j++) {
+            min_id = std::min(min_id, local_ids[j]);
+            max_id = std::max(max_id, local_ids[j]);
         }
-        PDASSERT(count == remote_buf_len);
-        memcpy(remote_triangles + remote_buf_len, local_triangles, num_local_triangles * sizeof(Triangle_inline));
-        save_unique_triangles_into_file(remote_triangles, remote_buf_len + num_local_triangles, sort);
-        delete[] remote_triangles;
-        delete[] num_remote_triangles;
+        blocks[i].first_triangle = prev_counts[0] + start;
+        blocks[i].num_triangles  = end - start;
+        blocks[i].min_vertex     = min_id;
+        blocks[i].max_vertex     = max_id;
     }
+
+    MPI_Datatype id_type = header.index_width == sizeof(int) ? MPI_INT : MPI_LONG_LONG;
+    void *ids = convert_to_index_width(local_ids, num_local_triangles * 3, header.index_width);
+    void *neighbors = NULL, *vertex_neighbors = NULL;
+    if (has_adjacency) {
+        neighbors = convert_to_index_width(adjacency.triangle_neighbors.empty() ? NULL : &adjacency.triangle_neighbors[0],
+                                           adjacency.triangle_neighbors.size(), header.index_width);
+        vertex_neighbors = convert_to_index_width(adjacency.vertex_neighbors.empty() ? NULL : &adjacency.vertex_neighbors[0],
+                                                  adjacency.vertex_neighbors.size(), header.index_width);
+    }
+    delete[] local_ids;
+
+#ifndef TIME_PERF
+    char filename[64];
+    snprintf(filename, 64, "log/global_triangles_%d.bin", processing_info->get_num_total_processing_units());
+
+    MPI_File fh;
+    if (MPI_File_open(comm, filename, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+        log(LOG_ERROR, "failed to open %s\n", filename);
     else {
-        MPI_Send(&num_local_triangles, 1, MPI_INT, 0, PDLN_MERGE_TAG_MASK, processing_info->get_mpi_comm());
-        MPI_Send(local_triangles, num_local_triangles * sizeof(Triangle_inline), MPI_CHAR, 0, PDLN_MERGE_TAG_MASK, processing_info->get_mpi_comm());
+        char header_buf[PDLN_MESH_HEADER_SIZE];
+        memset(header_buf, 0, sizeof(header_buf));
+        memcpy(header_buf, &header, sizeof(header));
+
+        MPI_Status status;
+        MPI_File_set_size(fh, header.block_index_offset + header.num_blocks * sizeof(Mesh_block_entry));
+        MPI_File_write_at_all(fh, 0, header_buf, processing_info->get_local_process_id() == 0 ? PDLN_MESH_HEADER_SIZE : 0,
+                              MPI_CHAR, &status);
+        MPI_File_write_at_all(fh, header.triangles_offset + prev_counts[0] * 3 * header.index_width, ids,
+                              num_local_triangles * 3, id_type, &status);
+        MPI_File_write_at_all(fh, header.block_index_offset + prev_counts[1] * sizeof(Mesh_block_entry), blocks,
+                              num_blocks * sizeof(Mesh_block_entry), MPI_CHAR, &status);
+        if (has_adjacency) {
+            /* the last process also writes the end of the last row */
+            bool is_last = processing_info->get_local_process_id() == processing_info->get_num_total_processes() - 1;
+            MPI_File_write_at_all(fh, header.adjacency_offset + prev_counts[0] * 3 * header.index_width, neighbors,
+                                  num_local_triangles * 3, id_type, &status);
+            MPI_File_write_at_all(fh, header.vertex_offsets_offset + adjacency.first_vertex * sizeof(unsigned long long),
+                                  &adjacency.vertex_offsets[0], adjacency.num_vertices + (is_last ? 1 : 0), MPI_LONG_LONG, &status);
+            MPI_File_write_at_all(fh, header.vertex_neighbors_offset + adjacency.vertex_offsets[0] * header.index_width,
+                                  vertex_neighbors, adjacency.vertex_neighbors.size(), id_type, &status);
+        }
+        MPI_File_close(&fh);
     }
+#endif
 
-    delete[] local_triangles;
+    if (PDLN_VERTEX_PERMUTATION && processing_info->get_local_process_id() == 0)
+        save_vertex_permutation(processing_info, xyz, num_points);
+
+    delete_index_buffer(ids, header.index_width);
+    delete_index_buffer(neighbors, header.index_width);
+    delete_index_buffer(vertex_neighbors, header.index_width);
+    delete[] blocks;
 }
 
 
@@ -3182,6 +3871,7 @@ void Grid_info_manager::gen_latlon_90_grid()
 
 Grid_info_manager::Grid_info_manager()
     : num_points(0)
+    , mask(NULL)
     , min_lon(0.)
     , max_lon(0.)
     , min_lat(0.)
@@ -3192,116 +3882,423 @@ Grid_info_manager::Grid_info_manager()
     , disabling_data(NULL)
 {
     coord_values[0] = coord_values[1] = NULL;
+    xyz_values[0] = xyz_values[1] = xyz_values[2] = NULL;
 }
 
 
 Grid_info_manager::~Grid_info_manager()
 {
-    delete coord_values[0];
-    delete coord_values[1];
+    delete[] coord_values[0];
+    delete[] coord_values[1];
+    for (int k = 0; k < 3; k++)
+        delete[] xyz_values[k];
+    delete[] mask;
+    if (disabling_method == DISABLE_POINTS_BY_INDEX)
+        delete[] (int*)disabling_data;
+    else
+        delete[] (double*)disabling_data;
 }
 
 
-bool Grid_info_manager::read_grid_from_text(const char filename[])
+/* return false if a grid read from a file is invalid */
+bool Grid_info_manager::check_grid_input(const Grid_input *grid)
 {
-    FILE* fp = fopen(filename, "r");
+    if (grid->num_points < 1) {
+        fprintf(stderr, "Invalid points number\n");
+        return false;
+    }
 
-    if (!fp)
+    double mi_lon = grid->boundary[0], ma_lon = grid->boundary[1], mi_lat = grid->boundary[2], ma_lat = grid->boundary[3];
+    if (ma_lat < -90 || ma_lat > 90 || mi_lat < -90 || mi_lat > 90 ||
+       (mi_lat >= ma_lat || mi_lon >= ma_lon || ma_lon - mi_lon > 360)) {
+        fprintf(stderr, "Invalid boundary value\n");
         return false;
+    }
 
-    fscanf(fp, "%d", &num_points);
+    if (have_redundent_points(grid->lon, grid->lat, grid->num_points)) {
+        fprintf(stderr, "Redundent points found\n");
+        return false;
+    }
 
-    if (num_points < 1) {
-        fprintf(stderr, "Invalid points number\n");
-        goto fail;
+    return true;
+}
+
+
+/* take over the arrays of a checked grid */
+void Grid_info_manager::set_grid_input(Grid_input *grid)
+{
+    num_points             = grid->num_points;
+    coord_values[PDLN_LON] = grid->lon;
+    coord_values[PDLN_LAT] = grid->lat;
+    /* the file keeps z to the north pole, PatCC keeps y */
+    xyz_values[0]          = grid->xyz[1];
+    xyz_values[1]          = grid->xyz[2];
+    xyz_values[2]          = grid->xyz[0];
+    mask                   = grid->mask;
+    set_grid_boundry(0, grid->boundary[0], grid->boundary[1], grid->boundary[2], grid->boundary[3]);
+    is_cyclic              = float_eq(max_lon - min_lon, 360);
+    disabling_method       = (DISABLING_POINTS_METHOD)grid->disabling_method;
+    disabling_num          = grid->disabling_num;
+    disabling_data         = grid->disabling_data;
+}
+
+
+bool Grid_info_manager::read_grid_from_text(const char filename[])
+{
+    Grid_input grid;
+    if (read_grid_text(filename, &grid) != 0)
+        return false;
+
+    if (!check_grid_input(&grid)) {
+        free_grid_input(&grid);
+        return false;
     }
+    set_grid_input(&grid);
+    return true;
+}
 
-    fscanf(fp, "%lf %lf %lf %lf", &min_lon, &max_lon, &min_lat, &max_lat);
 
-    if (max_lat < -90 || max_lat > 90 || min_lat < -90 || min_lat > 90 ||
-       (min_lat >= max_lat || min_lon >= max_lon || max_lon - min_lon > 360)) {
-        fprintf(stderr, "Invalid boundary value\n");
-        goto fail;
+bool Grid_info_manager::read_grid_from_binary(const char filename[])
+{
+    Grid_input grid;
+    if (read_grid_binary(filename, &grid) != 0)
+        return false;
+
+    if (!check_grid_input(&grid)) {
+        free_grid_input(&grid);
+        return false;
     }
+    set_grid_input(&grid);
+    return true;
+}
 
-    coord_values[PDLN_LON] = new double [num_points];
-    coord_values[PDLN_LAT] = new double [num_points];
 
-    for(int i = 0; i < num_points; i ++)
-        fscanf(fp, "%lf %lf\n", &coord_values[PDLN_LON][i], &coord_values[PDLN_LAT][i]);
+/* read a grid file in the text format or the binary one of grid_file.h */
+bool Grid_info_manager::read_grid_from_file(const char filename[])
+{
+    if (is_binary_grid_file(filename))
+        return read_grid_from_binary(filename);
+    return read_grid_from_text(filename);
+}
 
-    if (have_redundent_points(coord_values[PDLN_LON], coord_values[PDLN_LAT], num_points)) {
-        fprintf(stderr, "Redundent points found\n");
-        goto fail;
+
+/* what is broadcast ahead of the arrays of a grid */
+struct Grid_input_info {
+    int    valid;
+    int    num_points;
+    double boundary[4];
+    int    has_mask;
+    int    has_xyz;
+    int    disabling_method;
+    int    disabling_num;
+};
+
+
+/*
+ * Read a grid file by a few processes of comm, which broadcast it to the
+ * others, so that the file system sees a few readers instead of all the
+ * processes. Processes are grouped by node, or into PDLN_NUM_GRID_READERS
+ * groups of consecutive ranks if it is positive; the first process of each
+ * group reads and checks the grid. Collective over comm.
+ */
+bool Grid_info_manager::read_grid_collectively(const char filename[], MPI_Comm comm)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    MPI_Comm group_comm;
+    if (PDLN_NUM_GRID_READERS > 0)
+        MPI_Comm_split(comm, (int)((long long)rank * std::min(PDLN_NUM_GRID_READERS, num_procs) / num_procs), rank, &group_comm);
+    else
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &group_comm);
+
+    int group_rank;
+    MPI_Comm_rank(group_comm, &group_rank);
+
+    Grid_input grid;
+    Grid_input_info info;
+    memset(&info, 0, sizeof(info));
+    init_grid_input(&grid);
+    if (group_rank == 0 && read_grid_file(filename, &grid) == 0) {
+        info.valid            = check_grid_input(&grid);
+        info.num_points       = grid.num_points;
+        info.has_mask         = grid.mask != NULL;
+        info.has_xyz          = grid.xyz[0] != NULL;
+        info.disabling_method = grid.disabling_method;
+        info.disabling_num    = grid.disabling_num;
+        memcpy(info.boundary, grid.boundary, sizeof(info.boundary));
+    }
+    MPI_Bcast(&info, sizeof(info), MPI_BYTE, 0, group_comm);
+
+    if (info.valid && group_rank != 0) {
+        grid.num_points       = info.num_points;
+        grid.disabling_method = info.disabling_method;
+        grid.disabling_num    = info.disabling_num;
+        memcpy(grid.boundary, info.boundary, sizeof(info.boundary));
+        grid.lon = new double[grid.num_points];
+        grid.lat = new double[grid.num_points];
+        for (int k = 0; info.has_xyz && k < 3; k++)
+            grid.xyz[k] = new double[grid.num_points];
+        if (info.has_mask)
+            grid.mask = new bool[grid.num_points];
+        if (grid.disabling_method == PDLN_GRID_DISABLE_BY_INDEX)
+            grid.disabling_data = new int[grid.disabling_num];
+        else if (grid.disabling_method == PDLN_GRID_DISABLE_BY_RANGE)
+            grid.disabling_data = new double[grid.disabling_num*3];
     }
 
-    is_cyclic = float_eq(max_lon - min_lon, 360);
+    if (info.valid) {
+        MPI_Bcast(grid.lon, grid.num_points, MPI_DOUBLE, 0, group_comm);
+        MPI_Bcast(grid.lat, grid.num_points, MPI_DOUBLE, 0, group_comm);
+        for (int k = 0; info.has_xyz && k < 3; k++)
+            MPI_Bcast(grid.xyz[k], grid.num_points, MPI_DOUBLE, 0, group_comm);
+        if (info.has_mask)
+            MPI_Bcast(grid.mask, grid.num_points * sizeof(bool), MPI_BYTE, 0, group_comm);
+        if (grid.disabling_method == PDLN_GRID_DISABLE_BY_INDEX)
+            MPI_Bcast(grid.disabling_data, grid.disabling_num, MPI_INT, 0, group_comm);
+        else if (grid.disabling_method == PDLN_GRID_DISABLE_BY_RANGE)
+            MPI_Bcast(grid.disabling_data, grid.disabling_num*3, MPI_DOUBLE, 0, group_comm);
+        set_grid_input(&grid);
+    } else
+        free_grid_input(&grid);
+    MPI_Comm_free(&group_comm);
 
-    char disable_method[64];
-    if(fread(disable_method, 1, 23, fp)) {
-        if (strncmp(disable_method, "DISABLE_POINTS_BY_INDEX", 23) == 0) {
-            fscanf(fp, "%d", &disabling_num);
-            
-            int* tmp_buf = new int[disabling_num];
-            for (int i = 0; i < disabling_num; i++)
-                fscanf(fp, "%d", &tmp_buf[i]);
+    /* every group must have got the grid */
+    int valid = info.valid, all_valid;
+    MPI_Allreduce(&valid, &all_valid, 1, MPI_INT, MPI_MIN, comm);
+    return all_valid;
+}
 
-            disabling_data = (void*) tmp_buf;
-        } else if (strncmp(disable_method, "DISABLE_POINTS_BY_RANGE", 23) == 0) {
-            fscanf(fp, "%d", &disabling_num);
 
-            double* tmp_buf = new double[disabling_num*3];
-            for (int i = 0; i < disabling_num; i++)
-                fscanf(fp, "(%lf, %lf, %lf)", &tmp_buf[i*3], &tmp_buf[i*3+1], &tmp_buf[i*3+2]);
+#ifdef NETCDF
+#include "netcdf.h"
+
+/*
+ * Layouts of grids in NetCDF files:
+ *   rectilinear   1-D lon(x) and lat(y) on different dimensions, the points
+ *                 are their product, rows from the last latitude to the first
+ *   unstructured  1-D lon(n) and lat(n) on the same dimension
+ *   curvilinear   2-D lon(y, x) and lat(y, x)
+ * A mask variable, if any, has the shape of the points, 0 for disabled points.
+ */
+#define PDLN_NC_RECTILINEAR     (0)
+#define PDLN_NC_UNSTRUCTURED    (1)
+#define PDLN_NC_CURVILINEAR     (2)
+
+
+/*
+ * Boundary of points read from a file that has none. Longitudes are wrapped
+ * into [0, 360), and are cyclic if they leave no bucket of a coarse histogram
+ * empty; otherwise they are moved to start after the widest empty gap, so
+ * that min_lon < max_lon.
+ */
+static void calculate_nc_grid_boundary(double *lon, const double *lat, int num, double boundary[4])
+{
+    int num_buckets = std::max(4, std::min(360, (int)sqrt((double)num) / 4));
+    std::vector<char> filled(num_buckets, 0);
+    double min_lat = 1e10, max_lat = -1e10;
+
+    for (int i = 0; i < num; i++) {
+        double l = fmod(lon[i], 360);
+        if (l < 0) l += 360;
+        /* tiny negative longitudes round up to 360 */
+        if (l >= 360) l = 0;
+        lon[i] = l;
+        filled[std::min(num_buckets-1, (int)(l / 360 * num_buckets))] = 1;
+        min_lat = std::min(min_lat, lat[i]);
+        max_lat = std::max(max_lat, lat[i]);
+    }
 
-            disabling_data = (void*) tmp_buf;
-        } else if (strncmp(disable_method, "DISABLE_POINTS_NONE", 19) != 0) {
-            goto fail;
+    /* the widest run of empty buckets, each starting right after a filled one */
+    int gap_start = -1, gap_len = 0;
+    for (int i = 0; i < num_buckets; i++) {
+        if (filled[i] || !filled[(i+num_buckets-1) % num_buckets])
+            continue;
+        int len = 0;
+        while (len < num_buckets && !filled[(i+len) % num_buckets])
+            len++;
+        if (len > gap_len) {
+            gap_start = i;
+            gap_len   = len;
         }
     }
 
-    fclose(fp);
-    return true;
+    if (gap_start < 0) {
+        boundary[0] = 0;
+        boundary[1] = 360;
+        boundary[2] = -90;
+        boundary[3] = 90;
+        return;
+    }
 
-fail:
-    fclose(fp);
-    return false;
+    double seam    = (double)((gap_start + gap_len) % num_buckets) * 360 / num_buckets;
+    double min_lon = 1e10, max_lon = -1e10;
+    for (int i = 0; i < num; i++) {
+        double l = fmod(lon[i] - seam, 360);
+        if (l < 0) l += 360;
+        lon[i]  = seam + l;
+        min_lon = std::min(min_lon, lon[i]);
+        max_lon = std::max(max_lon, lon[i]);
+    }
+
+    boundary[0] = min_lon;
+    boundary[1] = max_lon;
+    boundary[2] = min_lat;
+    boundary[3] = max_lat;
 }
 
 
-#ifdef NETCDF
-void Grid_info_manager::read_grid_from_nc(const char filename[], const char lon_var_name[], const char lat_var_name[])
+/*
+ * Read a grid of any layout above from a NetCDF file. Each process of comm
+ * reads a hyperslab of consecutive rows, and the pieces are gathered by all
+ * processes; process 0 checks the grid. Collective over comm.
+ */
+bool Grid_info_manager::read_grid_from_nc_collectively(const char filename[], const char lon_var_name[],
+                                                       const char lat_var_name[], const char mask_var_name[], MPI_Comm comm)
 {
-    int num_dims;
-    int *dim_size_ptr;
-    int field_size;
-    int field_size2;
-    void *coord_buf0, *coord_buf1;
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    int ncfile_id;
+    int rcode = nc_open(filename, NC_NOWRITE, &ncfile_id);
+    report_nc_error(rcode);
+    bool valid = rcode == NC_NOERR;
+
+    int    lon_id, lat_id, mask_id = -1;
+    int    lon_dims[2], lat_dims[2], mask_dims[2];
+    size_t lon_sizes[2], lat_sizes[2], mask_sizes[2];
+    int num_lon_dims = valid ? get_nc_variable_shape(ncfile_id, lon_var_name, &lon_id, lon_dims, lon_sizes, 2) : -1;
+    int num_lat_dims = valid ? get_nc_variable_shape(ncfile_id, lat_var_name, &lat_id, lat_dims, lat_sizes, 2) : -1;
+
+    int layout = -1;
+    size_t num_rows = 0, row_len = 0;
+    if (num_lon_dims == 1 && num_lat_dims == 1 && lon_dims[0] != lat_dims[0]) {
+        layout   = PDLN_NC_RECTILINEAR;
+        num_rows = lat_sizes[0];
+        row_len  = lon_sizes[0];
+    } else if (num_lon_dims == 1 && num_lat_dims == 1) {
+        layout   = PDLN_NC_UNSTRUCTURED;
+        num_rows = lon_sizes[0];
+        row_len  = 1;
+    } else if (num_lon_dims == 2 && num_lat_dims == 2 && lon_sizes[0] == lat_sizes[0] && lon_sizes[1] == lat_sizes[1]) {
+        layout   = PDLN_NC_CURVILINEAR;
+        num_rows = lon_sizes[0];
+        row_len  = lon_sizes[1];
+    }
+    valid = valid && layout >= 0 && num_rows * row_len > 0 && num_rows * row_len <= INT_MAX;
 
-    read_file_field_as_double(filename, lon_var_name, &coord_buf0, &num_dims, &dim_size_ptr, &field_size);
-    delete dim_size_ptr;
-    read_file_field_as_double(filename, lat_var_name, &coord_buf1, &num_dims, &dim_size_ptr, &field_size2);
-    delete dim_size_ptr;
+    if (valid && mask_var_name) {
+        int num_mask_dims = get_nc_variable_shape(ncfile_id, mask_var_name, &mask_id, mask_dims, mask_sizes, 2);
+        if (layout == PDLN_NC_UNSTRUCTURED)
+            valid = num_mask_dims == 1 && mask_sizes[0] == num_rows;
+        else
+            valid = num_mask_dims == 2 && mask_sizes[0] == num_rows && mask_sizes[1] == row_len;
+    }
 
-    num_points = field_size*field_size2;
-    coord_values[PDLN_LON] = new double [num_points];
-    coord_values[PDLN_LAT] = new double [num_points];
+    /* rows [row_start, row_end) of the points are read by this process */
+    size_t row_start = valid ? num_rows * rank / num_procs : 0;
+    size_t row_end   = valid ? num_rows * (rank+1) / num_procs : 0;
+    int    local_num = (row_end - row_start) * row_len;
+    double *local_lon  = new double[local_num];
+    double *local_lat  = new double[local_num];
+    double *local_mask = mask_var_name ? new double[local_num] : NULL;
+    double *row_lon    = layout == PDLN_NC_RECTILINEAR ? new double[row_len] : NULL;
+    double *row_lat    = layout == PDLN_NC_RECTILINEAR ? new double[row_end - row_start] : NULL;
+
+    if (valid && row_end > row_start) {
+        if (layout == PDLN_NC_RECTILINEAR) {
+            /* point rows run from the last latitude */
+            size_t start[2] = {num_rows - row_end, 0};
+            size_t count[2] = {row_end - row_start, row_len};
+            size_t lon_start = 0;
+            valid = read_nc_variable_slab(ncfile_id, lon_id, &lon_start, &row_len, row_lon) &&
+                    read_nc_variable_slab(ncfile_id, lat_id, start, count, row_lat) &&
+                    (!local_mask || read_nc_variable_slab(ncfile_id, mask_id, start, count, local_mask));
+
+            int num_local_rows = row_end - row_start;
+            if (local_mask)
+                for (int j = 0; j < num_local_rows / 2; j++)
+                    std::swap_ranges(local_mask + j * row_len, local_mask + (j+1) * row_len,
+                                     local_mask + (num_local_rows-1-j) * row_len);
+            #pragma omp parallel for
+            for (int j = 0; j < num_local_rows; j++)
+                for (size_t i = 0; i < row_len; i++) {
+                    local_lon[j*row_len+i] = row_lon[i];
+                    local_lat[j*row_len+i] = row_lat[num_local_rows-1-j];
+                }
+        } else {
+            size_t start[2] = {row_start, 0};
+            size_t count[2] = {row_end - row_start, row_len};
+            valid = read_nc_variable_slab(ncfile_id, lon_id, start, count, local_lon) &&
+                    read_nc_variable_slab(ncfile_id, lat_id, start, count, local_lat) &&
+                    (!local_mask || read_nc_variable_slab(ncfile_id, mask_id, start, count, local_mask));
+        }
+    }
 
-    int count = 0;
-    for(int j = field_size2-1; j >= 0; j--)
-        for(int i = 0; i < field_size; i ++) {
-            coord_values[PDLN_LON][count] = ((double*)coord_buf0)[i];
-            coord_values[PDLN_LAT][count++] = ((double*)coord_buf1)[j];
+    if (rcode == NC_NOERR)
+        report_nc_error(nc_close(ncfile_id));
+    delete[] row_lon;
+    delete[] row_lat;
+
+    int local_valid = valid, all_valid;
+    MPI_Allreduce(&local_valid, &all_valid, 1, MPI_INT, MPI_MIN, comm);
+
+    Grid_input grid;
+    init_grid_input(&grid);
+    if (all_valid) {
+        std::vector<int> counts(num_procs), displs(num_procs+1, 0);
+        MPI_Allgather(&local_num, 1, MPI_INT, &counts[0], 1, MPI_INT, comm);
+        for (int i = 0; i < num_procs; i++)
+            displs[i+1] = displs[i] + counts[i];
+
+        grid.num_points = displs[num_procs];
+        grid.lon = new double[grid.num_points];
+        grid.lat = new double[grid.num_points];
+        MPI_Allgatherv(local_lon, local_num, MPI_DOUBLE, grid.lon, &counts[0], &displs[0], MPI_DOUBLE, comm);
+        MPI_Allgatherv(local_lat, local_num, MPI_DOUBLE, grid.lat, &counts[0], &displs[0], MPI_DOUBLE, comm);
+
+        if (local_mask) {
+            bool *local_bool_mask = new bool[local_num];
+            for (int i = 0; i < local_num; i++)
+                local_bool_mask[i] = local_mask[i] != 0;
+            std::vector<int> byte_counts(num_procs), byte_displs(num_procs);
+            for (int i = 0; i < num_procs; i++) {
+                byte_counts[i] = counts[i] * sizeof(bool);
+                byte_displs[i] = displs[i] * sizeof(bool);
+            }
+            grid.mask = new bool[grid.num_points];
+            MPI_Allgatherv(local_bool_mask, local_num * sizeof(bool), MPI_BYTE, grid.mask, &byte_counts[0], &byte_displs[0],
+                           MPI_BYTE, comm);
+            delete[] local_bool_mask;
+            disable_masked_points(&grid);
         }
 
-    PDASSERT(count == num_points);
-    PDASSERT(!have_redundent_points(coord_values[PDLN_LON], coord_values[PDLN_LAT], num_points));
+        calculate_nc_grid_boundary(grid.lon, grid.lat, grid.num_points, grid.boundary);
 
-    min_lon =   0.0;
-    max_lon = 360.0;
-    min_lat = -90.0;
-    max_lat =  90.0;
-    is_cyclic = true;
+        int checked = rank == 0 ? check_grid_input(&grid) : 0;
+        MPI_Bcast(&checked, 1, MPI_INT, 0, comm);
+        all_valid = checked;
+    }
+    delete[] local_lon;
+    delete[] local_lat;
+    delete[] local_mask;
+
+    if (!all_valid) {
+        free_grid_input(&grid);
+        return false;
+    }
+
+    set_grid_input(&grid);
+    return true;
+}
+
+
+void Grid_info_manager::read_grid_from_nc(const char filename[], const char lon_var_name[], const char lat_var_name[])
+{
+    if (!read_grid_from_nc_collectively(filename, lon_var_name, lat_var_name, NULL, MPI_COMM_WORLD))
+        log(LOG_ERROR, "failed in reading %s\n", filename);
 }
 #endif
 
@@ -3312,9 +4309,16 @@ double** Grid_info_manager::get_grid_coord_values(int grid_id)
 }
 
 
+/* unit vectors of the points if the grid was given by them, NULL otherwise */
+double** Grid_info_manager::get_grid_xyz_values(int grid_id)
+{
+    return xyz_values[0] ? xyz_values : NULL;
+}
+
+
 bool* Grid_info_manager::get_grid_mask(int grid_id)
 {
-    return NULL;
+    return mask;
 }
 
 
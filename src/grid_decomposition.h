@@ -12,11 +12,21 @@
 
 #include "processing_unit_mgt.h"
 #include "triangulation.h"
+#include "mesh_adjacency.h"
+#include "grid_file.h"
+#include <map>
 
 #define PDLN_LON 0
 #define PDLN_LAT 1
 #define PDLN_HIGH_BOUNDRY_SHIFTING (1e-6)
 
+/* sub-grids of cubed-sphere faces also carry the points within this many mean point spacings beyond the face edges */
+#define PDLN_CUBE_APRON_LAYERS     (8)
+/* aprons are widened up to this width (in chart units) when triangles reach out of them */
+#define PDLN_CUBE_MAX_APRON_WIDTH  (2 * PDLN_CUBE_CHART_SCALE)
+/* margin of cosines when checking that circumcircles reaching out of the widest apron are empty */
+#define PDLN_CUBE_CAP_TOLERANCE    (1e-12)
+
 
 using std::pair;
 
@@ -50,12 +60,16 @@ public:
 struct Grid_info
 {
     double* coord_values[2];
+    double* xyz_values[3];
     bool*   mask;
     int     num_total_points;
     int     num_vitual_poles;
     int     num_fence_points;
     Boundry boundary;
     bool    is_cyclic;
+    int*    global_index;   /* ids in the whole grid, NULL unless this is a sub-grid */
+    int     chart_face;     /* cubed-sphere face the coordinates are charted on, -1 for lon/lat */
+    unsigned long long fingerprint;     /* of the user grid, written into binary outputs */
 };
 
 class Search_tree_node;
@@ -71,6 +85,7 @@ private:
     int  region_id;
     bool is_leaf;
     bool fast_triangulate;
+    bool polar_sector;
 
     Boundry* kernel_boundry;
     Boundry* expand_boundry;
@@ -87,6 +102,11 @@ private:
     bool*   kernel_mask;
     bool*   expand_mask;
 
+    /* 32-bit fixed-point copy of kernel_coord for halo searching, built on first use */
+    unsigned* quantized_coord[2];
+    double    quantized_base[2];
+    double    quantized_scale[2];
+
     int     len_expand_coord_buf;
     int     num_kernel_points;
     int     num_expand_points;
@@ -103,8 +123,6 @@ private:
     int expanding_scale[4];
     Neighbors neighbors;
     Delaunay_Voronoi* triangulation;
-    int  bind_with;
-    bool is_bind;
 
     vector<int>* polars_local_index;
     double       shifted_polar_lat;
@@ -119,6 +137,7 @@ private:
 
     void fix_view_point();
     void calculate_real_boundary();
+    void quantize_kernel_coord();
     void fix_expand_boundry(int index, int count);
     double load_polars_info();
     void reset_polars(double*);
@@ -141,8 +160,8 @@ public:
     inline int ids_size() {return ids_end - ids_start; };
 
     /* Triangulation */
-    void project_grid();
-    void generate_local_triangulation(bool, int, int, bool);
+    void project_grid(double**, const double (*)[3] = NULL);
+    void generate_local_triangulation(bool, int, int, bool, bool =false);
 
     /* Expanding */
     Boundry expand();
@@ -154,8 +173,8 @@ public:
 
     /* Points searching */
     static void search_points_in_halo_internal(const Boundry*, const Boundry*, double *const *, const int*, const bool*, int, double**, int*, bool*, int*);
+    void search_points_in_quantized_halo(const Boundry*, const Boundry*, double**, int*, bool*, int*);
     void search_points_in_halo(const Boundry*, const Boundry*, double**, int*, bool*, int*);
-    static bool is_coordinate_in_halo(double x, double y, const Boundry *inner, const Boundry *outer);
 
     /* Consistency checking */
     void reduce_num_neighbors_on_boundry(unsigned long);
@@ -163,22 +182,30 @@ public:
 
     friend class Delaunay_grid_decomposition;
     friend bool node_ptr_comp(Search_tree_node*, Search_tree_node*);
+    friend bool node_workload_comp(Search_tree_node*, Search_tree_node*);
     friend void decompose_common_node_recursively(Delaunay_grid_decomposition *, Search_tree_node *, int, bool);
     friend void extend_search_tree(Delaunay_grid_decomposition *, Search_tree_node *, const Boundry*, int, int);
 };
 
 class Delaunay_grid_decomposition {
 public:
-    Delaunay_grid_decomposition(Grid_info, Processing_resource*, int);
+    Delaunay_grid_decomposition(Grid_info, Processing_resource*, int, int =1, int =0);
     ~Delaunay_grid_decomposition();
 
     int generate_grid_decomposition(bool =true);
     int generate_trianglulation_for_local_decomp();
+    void set_triangle_streaming(bool);
     vector<Search_tree_node*> get_local_leaf_nodes() {return local_leaf_nodes; };
 
     /* Debug */
     void print_whole_search_tree_info();
     void merge_all_triangles(bool);
+    int  get_local_triangles(Triangle_inline**);
+    static void merge_triangles_into_file(Processing_resource*, unsigned long long, double**, int, Triangle_inline*, int, bool);
+
+    /* Distributed output */
+    void get_local_mesh(int, Local_mesh*);
+    static void make_local_mesh(Processing_resource*, Triangle_inline*, int, int, Local_mesh*);
 
 #ifdef OPENCV
     void plot_grid_decomposition(const char*);
@@ -190,6 +217,9 @@ private:
     int  initialze_workloads(bool, bool);
     void initialze_buffer();
     int  assign_polars(bool, bool);
+    void assign_polar_sectors(Search_tree_node*, int);
+    void decompose_polar_ring_recursively(Search_tree_node*);
+    void add_polar_leaf_node(Search_tree_node*);
 
     /* Pre-treatment */
     int calculate_num_inserted_points(Boundry*, int);
@@ -200,7 +230,7 @@ private:
     void update_workloads(int, int, int, bool);
     Search_tree_node* alloc_search_tree_node(Search_tree_node*, double**, int*, bool*, int, Boundry, int, int, int, bool=false);
     bool is_polar_node(Search_tree_node*) const;
-    void set_binding_relationship();
+    void schedule_local_leaf_nodes();
     double is_polar_region_valid(int, Boundry*);
 
     /* Grid Expanding */
@@ -221,16 +251,25 @@ private:
     unsigned compute_common_boundry(Search_tree_node*, Search_tree_node*, Point*, Point*, Point*, Point*);
     void send_recv_checksums_with_neighbors(Search_tree_node*, unsigned long*, unsigned long*, vector<MPI_Request*> *, int);
     bool are_checksums_identical(Search_tree_node*, unsigned long*, unsigned long*);
-    void send_checksum_to_remote(int src_common_id, int dst_common_id, unsigned long* , int tag, MPI_Request** req);
-    void recv_checksum_from_remote(int src_common_id, int dst_common_id, unsigned long*, int tag, MPI_Request** req);
+    void send_checksum_to_remote(int src_region_id, int dst_region_id, unsigned long* , int tag, MPI_Request** req);
+    void recv_checksum_from_remote(int src_region_id, int dst_region_id, unsigned long*, int tag, MPI_Request** req);
     
     /* Process thread communication */
     int recv_triangles_from_remote(int, int, Triangle_inline *, int, int);
     void send_triangles_to_remote(int, int, Triangle_inline *, int, int);
 
+    /* Triangle streaming */
+    static int max_num_leaf_triangles(Search_tree_node*);
+    int  get_leaf_owned_triangles(Search_tree_node*, Triangle_inline*, int);
+    void stream_finished_leaves(const bool*, int);
+    void recv_streamed_triangles(int);
+    void finish_triangle_streaming();
+
     /* Debug */
     void print_tree_node_info_recursively(Search_tree_node*);
-    void save_unique_triangles_into_file(Triangle_inline *&, int, bool);
+    static void save_triangles_into_file(Processing_resource*, double**, int, int*, int, bool);
+    static void save_vertex_permutation(Processing_resource*, double**, int);
+    static void write_triangles_into_binary_file(Processing_resource*, unsigned long long, double**, int, Triangle_inline *, int, bool);
 
     /* Search tree info */
     Search_tree_node*         search_tree_root;
@@ -238,16 +277,22 @@ private:
     vector<Search_tree_node*> all_leaf_nodes;
     vector<Search_tree_node*> local_leaf_nodes;
     int  min_points_per_chunk;
+    int  over_decomposition_factor;
+    int  num_polar_sectors;
 
     /* Grid info */
     int     original_grid;
     bool    is_cyclic;
     double* coord_values[2];
+    double* xyz_values[3];
     bool*   mask;
     int*    global_index;
     int     num_points;
     int     num_fence_points;
     Boundry boundary_from_user;
+    int     chart_face;
+    double  chart_frame[3][3];
+    unsigned long long grid_fingerprint;
 
     /* Proc info */
     Processing_resource* processing_info;
@@ -259,6 +304,14 @@ private:
     int*      regionID_to_unitID;
     int*      all_group_intervals;
 
+    /* Triangle streaming, triangles of verified leaves are sent to process 0 during iterations */
+    bool                 stream_triangles;
+    bool*                is_leaf_streamed;
+    vector<MPI_Request>  stream_requests;
+    vector<int*>         stream_buffers;
+    int                  num_streamed_received;
+    std::map<int, pair<int, vector<int> > > streamed_triangles;   /* region id -> (iteration, id triplets) */
+
     /* Temp buffer */
     double** buf_double[2];
     int**    buf_int;
@@ -286,7 +339,9 @@ enum DISABLING_POINTS_METHOD {
 class Grid_info_manager {
 private:
     double *coord_values[2];
+    double *xyz_values[3];
     int num_points;
+    bool *mask;
     double min_lon;
     double max_lon;
     double min_lat;
@@ -297,21 +352,28 @@ private:
     void* disabling_data;
 
     void gen_basic_grid();
+    bool check_grid_input(const Grid_input*);
+    void set_grid_input(Grid_input*);
 
 public:
     /* for unittest */
     Grid_info_manager();
     virtual ~Grid_info_manager();
     virtual double** get_grid_coord_values(int);
+    virtual double** get_grid_xyz_values(int);
     virtual bool* get_grid_mask(int);
     virtual int get_grid_num_points(int);
     virtual void get_grid_boundry(int, double*, double*, double*, double*);
     virtual void set_grid_boundry(int, double, double, double, double);
     virtual bool is_grid_cyclic(int);
     virtual bool read_grid_from_text(const char []);
+    virtual bool read_grid_from_binary(const char []);
+    virtual bool read_grid_from_file(const char []);
+    virtual bool read_grid_collectively(const char [], MPI_Comm);
     virtual void get_disabled_points_info(int, DISABLING_POINTS_METHOD*, int*, void**);
 #ifdef NETCDF
     virtual void read_grid_from_nc(const char [], const char [], const char []);
+    virtual bool read_grid_from_nc_collectively(const char [], const char [], const char [], const char [], MPI_Comm);
     void gen_three_polar_grid();
     void gen_latlon_grid();
     void gen_latlon_90_grid();
@@ -0,0 +1,673 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "grid_file.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PDLN_MAX_NUMBER_LENGTH          (64)
+#define PDLN_MAX_EXACT_MANTISSA         (1ULL << 53)
+#define PDLN_MAX_EXACT_POWER_OF_TEN     (22)
+#define PDLN_MIN_PARALLEL_PARSE_SIZE    (1 << 20)
+#define PDLN_GRID_COPY_CHUNK_SIZE       (1 << 20)
+#define PDLN_GRID_RADIAN_TO_DEGREE      (57.2957795130823208768)
+
+static const double exact_powers_of_ten[PDLN_MAX_EXACT_POWER_OF_TEN+1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+
+/* separators of the circles of DISABLE_POINTS_BY_RANGE, written as (lon, lat, radius) */
+static inline bool is_circle_separator(char c)
+{
+    return is_space(c) || c == '(' || c == ',' || c == ')';
+}
+
+
+/* find the next token from *p, return false if there is none; *p is moved to its end */
+static inline bool next_token(const char **p, const char *end, bool in_circles, const char **token)
+{
+    const char *s = *p;
+    while (s < end && (in_circles ? is_circle_separator(*s) : is_space(*s)))
+        s++;
+    if (s == end)
+        return false;
+
+    *token = s;
+    while (s < end && !(in_circles ? is_circle_separator(*s) : is_space(*s)))
+        s++;
+    *p = s;
+    return true;
+}
+
+
+/* strtod on the token [p, end), which is not terminated */
+static bool parse_double_slow(const char *p, const char *end, double *value)
+{
+    char buf[PDLN_MAX_NUMBER_LENGTH];
+    size_t len = end - p;
+    if (len == 0 || len >= PDLN_MAX_NUMBER_LENGTH)
+        return false;
+
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    char *parsed_end;
+    *value = strtod(buf, &parsed_end);
+    return parsed_end == buf + len;
+}
+
+
+/*
+ * Parse the token [p, end) as a double, giving the value strtod gives.
+ * Decimals whose significant digits and power of ten are both exact in a
+ * double take one correctly rounded multiplication or division; the others,
+ * such as long mantissas, large exponents, inf or nan, go to strtod.
+ */
+bool parse_double(const char *p, const char *end, double *value)
+{
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '+' || *s == '-'))
+        negative = *s++ == '-';
+
+    unsigned long long mantissa = 0;
+    int  num_digits = 0;
+    int  exponent   = 0;
+    bool has_digit  = false;
+    for (bool in_fraction = false; s < end; s++) {
+        if (*s == '.' && !in_fraction) {
+            in_fraction = true;
+            continue;
+        }
+        if (*s < '0' || *s > '9')
+            break;
+        has_digit = true;
+        if (mantissa != 0 || *s != '0') {
+            if (++num_digits > 19)
+                return parse_double_slow(p, end, value);
+            mantissa = mantissa * 10 + (*s - '0');
+        }
+        if (in_fraction)
+            exponent--;
+    }
+
+    if (!has_digit)
+        return parse_double_slow(p, end, value);
+
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        s++;
+        bool negative_exponent = false;
+        if (s < end && (*s == '+' || *s == '-'))
+            negative_exponent = *s++ == '-';
+        if (s == end)
+            return false;
+        int e = 0;
+        for (; s < end && *s >= '0' && *s <= '9' && e < 10000; s++)
+            e = e * 10 + (*s - '0');
+        exponent += negative_exponent ? -e : e;
+    }
+
+    if (s != end || mantissa > PDLN_MAX_EXACT_MANTISSA || exponent < -PDLN_MAX_EXACT_POWER_OF_TEN ||
+        exponent > PDLN_MAX_EXACT_POWER_OF_TEN)
+        return parse_double_slow(p, end, value);
+
+    double v = (double)mantissa;
+    v = exponent < 0 ? v / exact_powers_of_ten[-exponent] : v * exact_powers_of_ten[exponent];
+    *value = negative ? -v : v;
+    return true;
+}
+
+
+static bool parse_int(const char *p, const char *end, int *value)
+{
+    double v;
+    if (!parse_double(p, end, &v) || v != (int)v)
+        return false;
+    *value = (int)v;
+    return true;
+}
+
+
+static bool next_double(const char **p, const char *end, bool in_circles, double *value)
+{
+    const char *token;
+    return next_token(p, end, in_circles, &token) && parse_double(token, *p, value);
+}
+
+
+static bool next_int(const char **p, const char *end, int *value)
+{
+    const char *token;
+    return next_token(p, end, false, &token) && parse_int(token, *p, value);
+}
+
+
+static void copy_in_parallel(void *dst, const void *src, size_t len)
+{
+    long num_chunks = (len + PDLN_GRID_COPY_CHUNK_SIZE - 1) / PDLN_GRID_COPY_CHUNK_SIZE;
+
+    #pragma omp parallel for
+    for (long c = 0; c < num_chunks; c++) {
+        size_t start = c * PDLN_GRID_COPY_CHUNK_SIZE;
+        size_t num   = start + PDLN_GRID_COPY_CHUNK_SIZE < len ? PDLN_GRID_COPY_CHUNK_SIZE : len - start;
+        memcpy((char*)dst + start, (const char*)src + start, num);
+    }
+}
+
+
+/* map the whole file for reading, return NULL on failure */
+static const char* map_file(const char *filename, size_t *length)
+{
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return NULL;
+    }
+
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return NULL;
+
+    *length = st.st_size;
+    return (const char*)addr;
+}
+
+
+void init_grid_input(Grid_input *grid)
+{
+    memset(grid, 0, sizeof(Grid_input));
+    grid->disabling_method = PDLN_GRID_DISABLE_NONE;
+}
+
+
+void free_grid_input(Grid_input *grid)
+{
+    delete[] grid->lon;
+    delete[] grid->lat;
+    for (int k = 0; k < 3; k++)
+        delete[] grid->xyz[k];
+    delete[] grid->mask;
+    if (grid->disabling_method == PDLN_GRID_DISABLE_BY_INDEX)
+        delete[] (int*)grid->disabling_data;
+    else
+        delete[] (double*)grid->disabling_data;
+    init_grid_input(grid);
+}
+
+
+/*
+ * Normalize the unit vectors of a grid given by xyz, and derive longitudes in
+ * [0, 360) and latitudes from them. The loop has no branch, so that atan2 is
+ * vectorized where the math library has a vector version.
+ * return false if some vector is zero or not finite.
+ */
+static bool derive_lonlat_from_xyz(Grid_input *grid)
+{
+    int num = grid->num_points;
+    double *x = grid->xyz[0], *y = grid->xyz[1], *z = grid->xyz[2];
+    double *lon = grid->lon = new double[num];
+    double *lat = grid->lat = new double[num];
+    int num_invalid = 0;
+
+    #pragma omp parallel for simd reduction(+:num_invalid)
+    for (int i = 0; i < num; i++) {
+        double len = sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]);
+        num_invalid += !(len > 0 && len < HUGE_VAL);
+        x[i] /= len;
+        y[i] /= len;
+        z[i] /= len;
+        double l = atan2(y[i], x[i]) * PDLN_GRID_RADIAN_TO_DEGREE;
+        lon[i] = l + (l < 0) * 360.0;
+        lat[i] = atan2(z[i], sqrt(x[i]*x[i] + y[i]*y[i])) * PDLN_GRID_RADIAN_TO_DEGREE;
+    }
+
+    return num_invalid == 0;
+}
+
+
+/*
+ * Parse the point list of num_points tuples of num_components values in
+ * [begin, end), which starts after a separator, into values[0..num_components).
+ * The range is cut at newlines into one chunk per thread, up to max_threads;
+ * tokens are counted per chunk first, so each chunk knows which points it
+ * holds. *tail is set to the first token after the point list.
+ * return false if there are not enough points or a value can not be parsed.
+ */
+bool parse_points(const char *begin, const char *end, int num_points, int num_components, double **values,
+                  const char **tail, int max_threads)
+{
+    const char **chunk_starts = new const char*[max_threads+1];
+    long *token_bases = new long[max_threads+1];
+    long num_values = (long)num_points * num_components;
+    bool valid = true;
+
+    *tail = end;
+
+    #pragma omp parallel num_threads(max_threads)
+    {
+        int nt = omp_get_num_threads();
+        int t  = omp_get_thread_num();
+
+        const char *start = begin + (end - begin) * t / nt;
+        if (t > 0) {
+            while (start < end && *start != '\n')
+                start++;
+            if (start < end)
+                start++;
+        }
+        chunk_starts[t] = start;
+        if (t == 0)
+            chunk_starts[nt] = end;
+
+        #pragma omp barrier
+
+        long num_tokens = 0;
+        const char *token;
+        for (const char *p = chunk_starts[t]; next_token(&p, chunk_starts[t+1], false, &token); )
+            num_tokens++;
+        token_bases[t+1] = num_tokens;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            token_bases[0] = 0;
+            for (int k = 0; k < nt; k++)
+                token_bases[k+1] += token_bases[k];
+        }
+
+        long i = token_bases[t];
+        bool chunk_valid = true;
+        for (const char *p = chunk_starts[t]; i <= num_values && next_token(&p, chunk_starts[t+1], false, &token); i++) {
+            if (i == num_values) {
+                *tail = token;
+                break;
+            }
+            chunk_valid = chunk_valid && parse_double(token, p, &values[i%num_components][i/num_components]);
+        }
+
+        if (!chunk_valid) {
+            #pragma omp atomic write
+            valid = false;
+        }
+
+        #pragma omp barrier
+        #pragma omp single
+        valid = valid && token_bases[nt] >= num_values;
+    }
+
+    delete[] chunk_starts;
+    delete[] token_bases;
+    return valid;
+}
+
+
+/* the optional section after the points, the same as DISABLE_POINTS_NONE if empty */
+static bool parse_disabling_section(const char *p, const char *end, Grid_input *grid)
+{
+    const char *token;
+    if (!next_token(&p, end, false, &token))
+        return true;
+
+    size_t len = p - token;
+    if (len == 19 && strncmp(token, "DISABLE_POINTS_NONE", 19) == 0)
+        return true;
+
+    if (len != 23)
+        return false;
+
+    if (strncmp(token, "DISABLE_POINTS_BY_INDEX", 23) == 0) {
+        if (!next_int(&p, end, &grid->disabling_num) || grid->disabling_num < 0)
+            return false;
+
+        int *indexes = new int[grid->disabling_num];
+        grid->disabling_method = PDLN_GRID_DISABLE_BY_INDEX;
+        grid->disabling_data   = indexes;
+        for (int i = 0; i < grid->disabling_num; i++)
+            if (!next_int(&p, end, &indexes[i]) || indexes[i] < 0 || indexes[i] >= grid->num_points)
+                return false;
+        return true;
+    }
+
+    if (strncmp(token, "DISABLE_POINTS_BY_RANGE", 23) == 0) {
+        if (!next_int(&p, end, &grid->disabling_num) || grid->disabling_num < 0)
+            return false;
+
+        double *circles = new double[grid->disabling_num*3];
+        grid->disabling_method = PDLN_GRID_DISABLE_BY_RANGE;
+        grid->disabling_data   = circles;
+        for (int i = 0; i < grid->disabling_num*3; i++)
+            if (!next_double(&p, end, true, &circles[i]))
+                return false;
+        return true;
+    }
+
+    return false;
+}
+
+
+/*
+ * Read a grid in the text format:
+ *   N [xyz]
+ *   minLon maxLon minLat maxLat
+ *   N lines of "lon lat", or "x y z" with xyz
+ *   an optional disabling section, see README.md
+ * The file is mapped into memory and the points are parsed in parallel.
+ * return 0 on success, -1 if the file can not be read or is malformed.
+ */
+int read_grid_text(const char *filename, Grid_input *grid)
+{
+    init_grid_input(grid);
+
+    size_t length;
+    const char *text = map_file(filename, &length);
+    if (!text)
+        return -1;
+
+    const char *p   = text;
+    const char *end = text + length;
+    bool valid = next_int(&p, end, &grid->num_points) && grid->num_points > 0;
+
+    /* unit vectors instead of lon & lat */
+    bool has_xyz = false;
+    const char *token, *q = p;
+    if (valid && next_token(&q, end, false, &token) && q - token == 3 && strncmp(token, "xyz", 3) == 0) {
+        has_xyz = true;
+        p = q;
+    }
+
+    for (int i = 0; valid && i < 4; i++)
+        valid = next_double(&p, end, false, &grid->boundary[i]);
+
+    if (valid) {
+        const char *tail;
+        double *values[3];
+        if (has_xyz) {
+            for (int k = 0; k < 3; k++)
+                values[k] = grid->xyz[k] = new double[grid->num_points];
+        } else {
+            values[0] = grid->lon = new double[grid->num_points];
+            values[1] = grid->lat = new double[grid->num_points];
+        }
+        int max_threads = end - p >= PDLN_MIN_PARALLEL_PARSE_SIZE ? omp_get_max_threads() : 1;
+        valid = parse_points(p, end, grid->num_points, has_xyz ? 3 : 2, values, &tail, max_threads) &&
+                parse_disabling_section(tail, end, grid) && (!has_xyz || derive_lonlat_from_xyz(grid));
+    }
+
+    munmap((void*)text, length);
+    if (!valid) {
+        free_grid_input(grid);
+        return -1;
+    }
+    return 0;
+}
+
+
+Grid_file_reader::Grid_file_reader()
+    : base(NULL)
+    , length(0)
+    , header(NULL)
+{
+}
+
+
+Grid_file_reader::~Grid_file_reader()
+{
+    close();
+}
+
+
+/*
+ * whether count items of width bytes at offset, aligned to align bytes, lie after
+ * the header and within length bytes, without summing sizes that could overflow.
+ */
+static inline bool is_section_valid(unsigned long long offset, unsigned long long count, unsigned long long width,
+                                    unsigned long long align, size_t length)
+{
+    return offset >= PDLN_GRID_HEADER_SIZE && offset <= length && offset % align == 0 && count <= (length - offset) / width;
+}
+
+
+/* return 0 on success, -1 if the file can not be mapped or is not a valid grid file */
+int Grid_file_reader::open(const char *filename)
+{
+    close();
+
+    base = map_file(filename, &length);
+    if (!base)
+        return -1;
+
+    const Grid_file_header *h = (const Grid_file_header*)base;
+    bool valid = length >= PDLN_GRID_HEADER_SIZE && memcmp(h->magic, PDLN_GRID_FILE_MAGIC, sizeof(h->magic)) == 0 &&
+                 h->version == PDLN_GRID_FILE_VERSION && h->byte_order == PDLN_GRID_BYTE_ORDER &&
+                 h->num_points > 0 && h->num_points <= INT_MAX && h->num_disabling <= INT_MAX &&
+                 h->disabling_method <= PDLN_GRID_DISABLE_BY_RANGE;
+
+    if (valid) {
+        unsigned long long disabling_width = h->disabling_method == PDLN_GRID_DISABLE_BY_INDEX ? sizeof(int) : 3 * sizeof(double);
+        if (h->flags & PDLN_GRID_HAS_XYZ)
+            valid = is_section_valid(h->xyz_offset, 3 * h->num_points, sizeof(double), 8, length);
+        else
+            valid = is_section_valid(h->lon_offset, h->num_points, sizeof(double), 8, length) &&
+                    is_section_valid(h->lat_offset, h->num_points, sizeof(double), 8, length);
+        valid = valid && is_section_valid(h->disabling_offset, h->num_disabling, disabling_width, 8, length);
+        if (h->flags & PDLN_GRID_HAS_MASK)
+            valid = valid && is_section_valid(h->mask_offset, h->num_points, 1, 1, length);
+    }
+
+    if (!valid) {
+        close();
+        return -1;
+    }
+
+    header = h;
+    return 0;
+}
+
+
+void Grid_file_reader::close()
+{
+    if (base)
+        munmap((void*)base, length);
+    base   = NULL;
+    length = 0;
+    header = NULL;
+}
+
+
+/* return 0 on success, -1 if the file can not be read or is not a valid grid file */
+int read_grid_binary(const char *filename, Grid_input *grid)
+{
+    init_grid_input(grid);
+
+    Grid_file_reader reader;
+    if (reader.open(filename) != 0)
+        return -1;
+
+    const Grid_file_header *header = reader.get_header();
+    grid->num_points = header->num_points;
+    memcpy(grid->boundary, header->boundary, sizeof(grid->boundary));
+
+    if (header->flags & PDLN_GRID_HAS_XYZ) {
+        for (int k = 0; k < 3; k++) {
+            grid->xyz[k] = new double[grid->num_points];
+            copy_in_parallel(grid->xyz[k], reader.get_xyz(k), grid->num_points * sizeof(double));
+        }
+        if (!derive_lonlat_from_xyz(grid)) {
+            free_grid_input(grid);
+            return -1;
+        }
+    } else {
+        grid->lon = new double[grid->num_points];
+        grid->lat = new double[grid->num_points];
+        copy_in_parallel(grid->lon, reader.get_lon(), grid->num_points * sizeof(double));
+        copy_in_parallel(grid->lat, reader.get_lat(), grid->num_points * sizeof(double));
+    }
+
+    if (reader.get_mask()) {
+        const unsigned char *mask = reader.get_mask();
+        grid->mask = new bool[grid->num_points];
+        #pragma omp parallel for
+        for (int i = 0; i < grid->num_points; i++)
+            grid->mask[i] = mask[i] != 0;
+    }
+
+    if (header->disabling_method == PDLN_GRID_DISABLE_NONE) {
+        disable_masked_points(grid);
+        return 0;
+    }
+
+    grid->disabling_method = header->disabling_method;
+    grid->disabling_num    = header->num_disabling;
+    if (header->disabling_method == PDLN_GRID_DISABLE_BY_INDEX) {
+        int *indexes = new int[grid->disabling_num];
+        memcpy(indexes, reader.get_disabling_data(), grid->disabling_num * sizeof(int));
+        grid->disabling_data = indexes;
+        for (int i = 0; i < grid->disabling_num; i++)
+            if (indexes[i] < 0 || indexes[i] >= grid->num_points) {
+                free_grid_input(grid);
+                return -1;
+            }
+    } else if (header->disabling_method == PDLN_GRID_DISABLE_BY_RANGE) {
+        double *circles = new double[grid->disabling_num*3];
+        memcpy(circles, reader.get_disabling_data(), grid->disabling_num * 3 * sizeof(double));
+        grid->disabling_data = circles;
+    }
+
+    return 0;
+}
+
+
+bool is_binary_grid_file(const char *filename)
+{
+    char magic[8];
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+        return false;
+
+    bool is_binary = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, PDLN_GRID_FILE_MAGIC, sizeof(magic)) == 0;
+    fclose(fp);
+    return is_binary;
+}
+
+
+/* disable the points masked out by index, unless points are already disabled otherwise */
+void disable_masked_points(Grid_input *grid)
+{
+    if (!grid->mask || grid->disabling_method != PDLN_GRID_DISABLE_NONE)
+        return;
+
+    int num_disabled = 0;
+    for (int i = 0; i < grid->num_points; i++)
+        num_disabled += !grid->mask[i];
+    if (num_disabled == 0)
+        return;
+
+    int *indexes = new int[num_disabled];
+    for (int i = 0, j = 0; i < grid->num_points; i++)
+        if (!grid->mask[i])
+            indexes[j++] = i;
+
+    grid->disabling_method = PDLN_GRID_DISABLE_BY_INDEX;
+    grid->disabling_num    = num_disabled;
+    grid->disabling_data   = indexes;
+}
+
+
+/* read a grid file in either format, telling them by the magic of the binary one */
+int read_grid_file(const char *filename, Grid_input *grid)
+{
+    if (is_binary_grid_file(filename))
+        return read_grid_binary(filename, grid);
+    return read_grid_text(filename, grid);
+}
+
+
+/* return 0 on success, -1 if the file can not be written */
+int write_grid_binary(const char *filename, const Grid_input *grid)
+{
+    Grid_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PDLN_GRID_FILE_MAGIC, sizeof(header.magic));
+    header.version          = PDLN_GRID_FILE_VERSION;
+    header.byte_order       = PDLN_GRID_BYTE_ORDER;
+    header.flags            = (grid->mask ? PDLN_GRID_HAS_MASK : 0) | (grid->xyz[0] ? PDLN_GRID_HAS_XYZ : 0);
+    header.disabling_method = grid->disabling_method;
+    header.num_points       = grid->num_points;
+    memcpy(header.boundary, grid->boundary, sizeof(header.boundary));
+
+    size_t disabling_len = 0;
+    if (grid->disabling_method == PDLN_GRID_DISABLE_BY_INDEX)
+        disabling_len = grid->disabling_num * sizeof(int);
+    else if (grid->disabling_method == PDLN_GRID_DISABLE_BY_RANGE)
+        disabling_len = grid->disabling_num * 3 * sizeof(double);
+    header.num_disabling = disabling_len ? grid->disabling_num : 0;
+
+    /* all sections are multiples of 8 bytes but the disabling one; grids given
+     * by unit vectors keep them instead of the derived lon & lat */
+    int num_arrays = grid->xyz[0] ? 3 : 2;
+    if (grid->xyz[0])
+        header.xyz_offset   = PDLN_GRID_HEADER_SIZE;
+    else {
+        header.lon_offset   = PDLN_GRID_HEADER_SIZE;
+        header.lat_offset   = header.lon_offset + grid->num_points * sizeof(double);
+    }
+    header.disabling_offset = PDLN_GRID_HEADER_SIZE + num_arrays * grid->num_points * sizeof(double);
+    size_t padding          = (8 - disabling_len % 8) % 8;
+    if (grid->mask)
+        header.mask_offset  = header.disabling_offset + disabling_len + padding;
+
+    FILE *fp = fopen(filename, "wb");
+    if (!fp)
+        return -1;
+
+    char header_buf[PDLN_GRID_HEADER_SIZE];
+    char zeros[8] = {0};
+    memset(header_buf, 0, sizeof(header_buf));
+    memcpy(header_buf, &header, sizeof(header));
+
+    double *arrays[3] = {grid->lon, grid->lat, NULL};
+    if (grid->xyz[0])
+        for (int k = 0; k < 3; k++)
+            arrays[k] = grid->xyz[k];
+
+    bool valid = fwrite(header_buf, 1, sizeof(header_buf), fp) == sizeof(header_buf);
+    for (int k = 0; k < num_arrays; k++)
+        valid = valid && fwrite(arrays[k], sizeof(double), grid->num_points, fp) == (size_t)grid->num_points;
+    valid = valid && (disabling_len == 0 || fwrite(grid->disabling_data, 1, disabling_len, fp) == disabling_len);
+    if (valid && grid->mask) {
+        unsigned char *mask = new unsigned char[grid->num_points];
+        for (int i = 0; i < grid->num_points; i++)
+            mask[i] = grid->mask[i];
+        valid = fwrite(zeros, 1, padding, fp) == padding &&
+                fwrite(mask, 1, grid->num_points, fp) == (size_t)grid->num_points;
+        delete[] mask;
+    }
+
+    return fclose(fp) == 0 && valid ? 0 : -1;
+}
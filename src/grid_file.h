@@ -0,0 +1,118 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#ifndef PDLN_GRID_FILE_H
+#define PDLN_GRID_FILE_H
+
+#include <cstddef>
+
+/*
+ * Binary grid file, all fields in native byte order, which byte_order tells:
+ *
+ *   header        PDLN_GRID_HEADER_SIZE bytes, Grid_file_header then zeros
+ *   lon, lat      num_points doubles each, in degree, or with PDLN_GRID_HAS_XYZ
+ *   x, y, z       num_points doubles each, unit vectors with z to the north pole
+ *                 and x to longitude 0
+ *   disabling     num_disabling point indexes as ints, or num_disabling circles
+ *                 as (lon, lat, radius) doubles in degree, 8-byte aligned
+ *   mask          optional, num_points bytes, 0 for disabled points
+ *
+ * It holds what the text format holds, so the arrays can be mapped into
+ * memory instead of being parsed. Longitudes and latitudes of grids given by
+ * unit vectors are derived when reading.
+ */
+#define PDLN_GRID_FILE_MAGIC        "PDLNGRID"
+#define PDLN_GRID_FILE_VERSION      (1)
+#define PDLN_GRID_HEADER_SIZE       (128)
+#define PDLN_GRID_BYTE_ORDER        (0x01020304)
+
+/* same values as DISABLING_POINTS_METHOD */
+#define PDLN_GRID_DISABLE_NONE      (0)
+#define PDLN_GRID_DISABLE_BY_INDEX  (1)
+#define PDLN_GRID_DISABLE_BY_RANGE  (2)
+
+#define PDLN_GRID_HAS_MASK          (0x1)
+#define PDLN_GRID_HAS_XYZ           (0x2)
+
+
+struct Grid_file_header {
+    char               magic[8];
+    unsigned           version;
+    unsigned           byte_order;          /* PDLN_GRID_BYTE_ORDER as written */
+    unsigned           flags;
+    unsigned           disabling_method;
+    unsigned long long num_points;
+    double             boundary[4];         /* min_lon, max_lon, min_lat, max_lat */
+    unsigned long long num_disabling;
+    unsigned long long lon_offset;
+    unsigned long long lat_offset;
+    unsigned long long disabling_offset;
+    unsigned long long mask_offset;         /* 0 without mask */
+    unsigned long long xyz_offset;          /* 0 without xyz, then lon & lat offsets are 0 */
+};
+
+
+/* a grid as given to PatCC, arrays allocated with new[] */
+struct Grid_input {
+    int     num_points;
+    double  boundary[4];        /* min_lon, max_lon, min_lat, max_lat */
+    double* lon;
+    double* lat;
+    double* xyz[3];             /* NULL if the points were given by lon & lat, unit vectors as in the binary file */
+    bool*   mask;               /* NULL if not given */
+    int     disabling_method;   /* PDLN_GRID_DISABLE_* */
+    int     disabling_num;
+    void*   disabling_data;     /* disabling_num ints, or disabling_num (lon, lat, radius) triplets */
+};
+
+
+/*
+ * Read-only view of a binary grid file mapped into memory. Pointers stay
+ * valid until close() or destruction; nothing is copied.
+ */
+class Grid_file_reader {
+public:
+    Grid_file_reader();
+    ~Grid_file_reader();
+
+    int  open(const char*);
+    void close();
+
+    const Grid_file_header* get_header() const { return header; }
+    const double* get_lon() const { return header && header->lon_offset ? (const double*)(base + header->lon_offset) : NULL; }
+    const double* get_lat() const { return header && header->lat_offset ? (const double*)(base + header->lat_offset) : NULL; }
+    const double* get_xyz(int k) const {
+        return header && (header->flags & PDLN_GRID_HAS_XYZ) ? (const double*)(base + header->xyz_offset) + k * header->num_points : NULL;
+    }
+    const void*   get_disabling_data() const { return header ? base + header->disabling_offset : NULL; }
+    const unsigned char* get_mask() const {
+        return header && (header->flags & PDLN_GRID_HAS_MASK) ? (const unsigned char*)(base + header->mask_offset) : NULL;
+    }
+
+private:
+    const char*             base;
+    size_t                  length;
+    const Grid_file_header* header;
+};
+
+
+void init_grid_input(Grid_input*);
+void free_grid_input(Grid_input*);
+bool is_binary_grid_file(const char*);
+int  read_grid_text(const char*, Grid_input*);
+int  read_grid_binary(const char*, Grid_input*);
+int  read_grid_file(const char*, Grid_input*);
+int  write_grid_binary(const char*, const Grid_input*);
+void disable_masked_points(Grid_input*);
+
+/* parsers of the text format, exposed for the unit tests */
+bool parse_double(const char*, const char*, double*);
+bool parse_points(const char*, const char*, int, int, double**, const char**, int);
+
+#endif
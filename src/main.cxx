@@ -17,7 +17,12 @@
 Grid_info_manager *grid_info_mgr;
 Process_thread_manager *process_thread_mgr;
 
+#ifdef NETCDF
+char usage[] = "usage: OMP_NUM_THREADS=nt mpiexec -n np ./patcc gridFile\n"
+               "       OMP_NUM_THREADS=nt mpiexec -n np ./patcc ncFile lonVar latVar [maskVar]\n";
+#else
 char usage[] = "usage: OMP_NUM_THREADS=nt mpiexec -n np ./patcc gridFile\n";
+#endif
 
 void redirect_stdout()
 {
@@ -44,7 +49,11 @@ void redirect_stdout()
 
 int main(int argc, char** argv)
 {
+#ifdef NETCDF
+    if (argc != 2 && argc != 4 && argc != 5) {
+#else
     if (argc != 2) {
+#endif
         perror(usage);
         return -1;
     }
@@ -56,7 +65,15 @@ int main(int argc, char** argv)
     process_thread_mgr = new Process_thread_manager();
     grid_info_mgr = new Grid_info_manager();
 
-    if(!grid_info_mgr->read_grid_from_text(argv[1])) {
+    bool success;
+#ifdef NETCDF
+    if (argc > 2)
+        success = grid_info_mgr->read_grid_from_nc_collectively(argv[1], argv[2], argv[3], argc == 5 ? argv[4] : NULL, MPI_COMM_WORLD);
+    else
+#endif
+        success = grid_info_mgr->read_grid_collectively(argv[1], MPI_COMM_WORLD);
+
+    if(!success) {
         log(LOG_ERROR, "Failed in reading grid file\n");
         return -1;
     }
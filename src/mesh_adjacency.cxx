@@ -0,0 +1,298 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "mesh_adjacency.h"
+#include "logger.h"
+#include <algorithm>
+#include <tr1/unordered_set>
+
+
+/* an edge of a triangle, v[0] < v[1], slot is the vertex of the triangle opposite to it */
+struct Edge_record {
+    int       v[2];
+    long long triangle;
+    int       slot;
+};
+
+
+/* neighbor of triangle across the edge opposite to its vertex slot */
+struct Neighbor_record {
+    long long triangle;
+    long long neighbor;
+    int       slot;
+};
+
+
+/* directed edge of the vertex graph */
+struct Vertex_edge {
+    int from;
+    int to;
+};
+
+
+static inline bool operator < (const Edge_record &e1, const Edge_record &e2)
+{
+    if (e1.v[0] != e2.v[0])
+        return e1.v[0] < e2.v[0];
+    if (e1.v[1] != e2.v[1])
+        return e1.v[1] < e2.v[1];
+    return e1.triangle < e2.triangle;
+}
+
+
+static inline bool operator < (const Vertex_edge &e1, const Vertex_edge &e2)
+{
+    return e1.from < e2.from || (e1.from == e2.from && e1.to < e2.to);
+}
+
+
+static inline int edge_owner(int v0, int v1, int num_procs)
+{
+    unsigned long long key = ((unsigned long long)(unsigned)v0 << 32) | (unsigned)v1;
+    return (int)(((key * 0x9E3779B97F4A7C15ULL) >> 32) % num_procs);
+}
+
+
+/* the process owning the range [starts[i], starts[i+1]) that contains value */
+static inline int range_owner(const std::vector<long long> &starts, long long value)
+{
+    return std::upper_bound(starts.begin(), starts.end(), value) - starts.begin() - 1;
+}
+
+
+/*
+ * Build the triangle neighbors and the vertex graph of num_triangles local
+ * triangles, given as vertex-id triplets, whose global indexes start from
+ * first_triangle. Collective over comm.
+ *
+ * Edges are hashed to processes, so that both triangles of an edge meet on the
+ * same process wherever they were triangulated; the pairs go back to the
+ * owners of the triangles, and each distinct edge goes to the owners of its
+ * two vertices as a row entry of the graph.
+ * return 0 on success, -1 if some edge is shared by more than two triangles.
+ */
+int build_mesh_adjacency(MPI_Comm comm, const int *ids, int num_triangles, long long first_triangle, int num_points,
+                         Mesh_adjacency *adjacency)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    std::vector<long long> triangle_starts(num_procs+1);
+    MPI_Allgather(&first_triangle, 1, MPI_LONG_LONG, &triangle_starts[0], 1, MPI_LONG_LONG, comm);
+    triangle_starts[num_procs] = triangle_starts[num_procs-1] + num_triangles;
+    MPI_Bcast(&triangle_starts[num_procs], 1, MPI_LONG_LONG, num_procs-1, comm);
+
+    std::vector<long long> vertex_starts(num_procs+1);
+    for (int i = 0; i <= num_procs; i++)
+        vertex_starts[i] = (long long)num_points * i / num_procs;
+
+    std::vector<Edge_record> edges(num_triangles * 3);
+    std::vector<int> dest(num_triangles * 3);
+    #pragma omp parallel for
+    for (int i = 0; i < num_triangles; i++)
+        for (int k = 0; k < 3; k++) {
+            Edge_record &e = edges[i*3+k];
+            int v0 = ids[i*3+(k+1)%3];
+            int v1 = ids[i*3+(k+2)%3];
+            e.v[0]     = std::min(v0, v1);
+            e.v[1]     = std::max(v0, v1);
+            e.triangle = first_triangle + i;
+            e.slot     = k;
+            dest[i*3+k] = edge_owner(e.v[0], e.v[1], num_procs);
+        }
+
+    std::vector<Edge_record> recv_edges;
+    exchange_records(comm, edges, dest, recv_edges);
+    std::vector<Edge_record>().swap(edges);
+    std::sort(recv_edges.begin(), recv_edges.end());
+
+    std::vector<Neighbor_record> neighbors;
+    std::vector<Vertex_edge> graph_edges;
+    int num_nonmanifold = 0;
+    for (size_t i = 0, j; i < recv_edges.size(); i = j) {
+        for (j = i + 1; j < recv_edges.size() && recv_edges[j].v[0] == recv_edges[i].v[0] &&
+                        recv_edges[j].v[1] == recv_edges[i].v[1]; j++);
+
+        if (j - i == 2) {
+            Neighbor_record n1 = {recv_edges[i].triangle, recv_edges[i+1].triangle, recv_edges[i].slot};
+            Neighbor_record n2 = {recv_edges[i+1].triangle, recv_edges[i].triangle, recv_edges[i+1].slot};
+            neighbors.push_back(n1);
+            neighbors.push_back(n2);
+        } else if (j - i > 2)
+            num_nonmanifold++;
+
+        Vertex_edge e1 = {recv_edges[i].v[0], recv_edges[i].v[1]};
+        Vertex_edge e2 = {recv_edges[i].v[1], recv_edges[i].v[0]};
+        graph_edges.push_back(e1);
+        graph_edges.push_back(e2);
+    }
+    std::vector<Edge_record>().swap(recv_edges);
+
+    if (num_nonmanifold > 0)
+        log(LOG_WARNING, "%d edges are shared by more than two triangles, their neighbors are left unset\n", num_nonmanifold);
+
+    dest.resize(neighbors.size());
+    for (size_t i = 0; i < neighbors.size(); i++)
+        dest[i] = range_owner(triangle_starts, neighbors[i].triangle);
+    std::vector<Neighbor_record> recv_neighbors;
+    exchange_records(comm, neighbors, dest, recv_neighbors);
+
+    adjacency->triangle_neighbors.assign(num_triangles * 3, -1);
+    for (size_t i = 0; i < recv_neighbors.size(); i++)
+        adjacency->triangle_neighbors[(recv_neighbors[i].triangle - first_triangle) * 3 + recv_neighbors[i].slot] = recv_neighbors[i].neighbor;
+
+    dest.resize(graph_edges.size());
+    for (size_t i = 0; i < graph_edges.size(); i++)
+        dest[i] = range_owner(vertex_starts, graph_edges[i].from);
+    std::vector<Vertex_edge> recv_graph_edges;
+    exchange_records(comm, graph_edges, dest, recv_graph_edges);
+    std::sort(recv_graph_edges.begin(), recv_graph_edges.end());
+
+    long long num_local_neighbors = recv_graph_edges.size();
+    long long prev_neighbors = 0;
+    MPI_Exscan(&num_local_neighbors, &prev_neighbors, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&num_local_neighbors, &adjacency->num_all_vertex_neighbors, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0)
+        prev_neighbors = 0;
+
+    adjacency->first_vertex = vertex_starts[rank];
+    adjacency->num_vertices = vertex_starts[rank+1] - vertex_starts[rank];
+    adjacency->vertex_offsets.assign(adjacency->num_vertices + 1, 0);
+    adjacency->vertex_neighbors.resize(recv_graph_edges.size());
+    for (size_t i = 0; i < recv_graph_edges.size(); i++) {
+        adjacency->vertex_offsets[recv_graph_edges[i].from - adjacency->first_vertex + 1]++;
+        adjacency->vertex_neighbors[i] = recv_graph_edges[i].to;
+    }
+    adjacency->vertex_offsets[0] = prev_neighbors;
+    for (int i = 0; i < adjacency->num_vertices; i++)
+        adjacency->vertex_offsets[i+1] += adjacency->vertex_offsets[i];
+
+    int num_all_nonmanifold;
+    MPI_Allreduce(&num_nonmanifold, &num_all_nonmanifold, 1, MPI_INT, MPI_SUM, comm);
+    return num_all_nonmanifold > 0 ? -1 : 0;
+}
+
+
+/* a triangle incident to a vertex, as kept by the process the vertex is hashed to */
+struct Incidence_record {
+    int       vertex;
+    int       owner;
+    int       index;    /* index of the triangle on its owner */
+    int       v[3];
+};
+
+
+struct Incidence_request {
+    int vertex;
+    int requester;
+};
+
+
+static inline bool operator < (const Incidence_record &r1, const Incidence_record &r2)
+{
+    return r1.vertex < r2.vertex;
+}
+
+
+static inline int vertex_owner(int vertex, int num_procs)
+{
+    return (int)((((unsigned long long)(unsigned)vertex * 0x9E3779B97F4A7C15ULL) >> 32) % num_procs);
+}
+
+
+/*
+ * Extend the num_owned triangles of this process, given as vertex-id triplets,
+ * with num_ghost_layers layers of ghost triangles. Collective over comm.
+ *
+ * The incidences of all triangles are first hashed by vertex to processes, so
+ * each layer costs one round of requests for the vertices of the previous
+ * layer and one round of replies, whatever the decomposition was.
+ */
+void build_local_mesh(MPI_Comm comm, const int *ids, int num_owned, int num_ghost_layers, Local_mesh *mesh)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    mesh->triangles.assign(ids, ids + num_owned * 3);
+    mesh->owners.assign(num_owned, rank);
+    mesh->layer_offsets.assign(1, 0);
+    mesh->layer_offsets.push_back(num_owned);
+
+    std::vector<Incidence_record> incidences(num_owned * 3);
+    std::vector<int> dest(num_owned * 3);
+    for (int i = 0; i < num_owned; i++)
+        for (int k = 0; k < 3; k++) {
+            Incidence_record &r = incidences[i*3+k];
+            r.vertex = ids[i*3+k];
+            r.owner  = rank;
+            r.index  = i;
+            for (int j = 0; j < 3; j++)
+                r.v[j] = ids[i*3+j];
+            dest[i*3+k] = vertex_owner(r.vertex, num_procs);
+        }
+
+    std::vector<Incidence_record> directory;
+    exchange_records(comm, incidences, dest, directory);
+    std::vector<Incidence_record>().swap(incidences);
+    std::stable_sort(directory.begin(), directory.end());
+
+    std::tr1::unordered_set<long long> held_triangles;
+    for (int i = 0; i < num_owned; i++)
+        held_triangles.insert(((long long)rank << 32) | i);
+
+    std::tr1::unordered_set<int> visited_vertices;
+    std::vector<int> frontier;
+    for (int i = 0; i < num_owned * 3; i++)
+        if (visited_vertices.insert(ids[i]).second)
+            frontier.push_back(ids[i]);
+
+    for (int layer = 1; layer <= num_ghost_layers; layer++) {
+        std::vector<Incidence_request> requests(frontier.size());
+        dest.resize(frontier.size());
+        for (size_t i = 0; i < frontier.size(); i++) {
+            requests[i].vertex    = frontier[i];
+            requests[i].requester = rank;
+            dest[i] = vertex_owner(frontier[i], num_procs);
+        }
+
+        std::vector<Incidence_request> recv_requests;
+        exchange_records(comm, requests, dest, recv_requests);
+
+        std::vector<Incidence_record> replies;
+        dest.clear();
+        for (size_t i = 0; i < recv_requests.size(); i++) {
+            Incidence_record key;
+            key.vertex = recv_requests[i].vertex;
+            std::pair<std::vector<Incidence_record>::iterator, std::vector<Incidence_record>::iterator> range =
+                std::equal_range(directory.begin(), directory.end(), key);
+            for (std::vector<Incidence_record>::iterator it = range.first; it != range.second; ++it) {
+                replies.push_back(*it);
+                dest.push_back(recv_requests[i].requester);
+            }
+        }
+
+        std::vector<Incidence_record> recv_replies;
+        exchange_records(comm, replies, dest, recv_replies);
+
+        frontier.clear();
+        for (size_t i = 0; i < recv_replies.size(); i++) {
+            const Incidence_record &r = recv_replies[i];
+            if (!held_triangles.insert(((long long)r.owner << 32) | r.index).second)
+                continue;
+            mesh->triangles.insert(mesh->triangles.end(), r.v, r.v + 3);
+            mesh->owners.push_back(r.owner);
+            for (int j = 0; j < 3; j++)
+                if (visited_vertices.insert(r.v[j]).second)
+                    frontier.push_back(r.v[j]);
+        }
+        mesh->layer_offsets.push_back(mesh->owners.size());
+    }
+}
@@ -0,0 +1,92 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#ifndef PDLN_MESH_ADJACENCY_H
+#define PDLN_MESH_ADJACENCY_H
+
+#include "mpi.h"
+#include <vector>
+
+
+/*
+ * Connectivity of a triangulation distributed over the processes of a
+ * communicator. Each process keeps the neighbors of its own triangles and the
+ * CSR rows of a contiguous range of vertices.
+ */
+struct Mesh_adjacency {
+    /* neighbor across the edge opposite to each vertex of the local triangles,
+     * as global triangle indexes, -1 on the boundary */
+    std::vector<long long> triangle_neighbors;
+
+    /* vertices [first_vertex, first_vertex + num_vertices) */
+    int first_vertex;
+    int num_vertices;
+    /* num_vertices+1 offsets into vertex_neighbors of the whole graph, so the
+     * first one is the number of neighbors kept by the previous processes */
+    std::vector<long long> vertex_offsets;
+    std::vector<int>       vertex_neighbors;
+    long long              num_all_vertex_neighbors;
+};
+
+
+/*
+ * Triangles of one process: those it owns, then layers of ghost triangles
+ * owned by other processes. A ghost triangle of layer k shares a vertex with
+ * layer k-1 and belongs to no lower layer; layer 0 is the owned triangles.
+ */
+struct Local_mesh {
+    std::vector<int> triangles;         /* vertex-id triplets */
+    std::vector<int> owners;            /* process owning each triangle */
+    std::vector<int> layer_offsets;     /* layer k is triangles [layer_offsets[k], layer_offsets[k+1]) */
+};
+
+
+/* send records[i] to process dest[i] and receive the records sent to this process */
+template <typename T>
+void exchange_records(MPI_Comm comm, const std::vector<T> &records, const std::vector<int> &dest,
+                      std::vector<T> &received)
+{
+    int num_procs;
+    MPI_Comm_size(comm, &num_procs);
+
+    std::vector<int> send_counts(num_procs, 0), recv_counts(num_procs);
+    for (size_t i = 0; i < dest.size(); i++)
+        send_counts[dest[i]]++;
+    MPI_Alltoall(&send_counts[0], 1, MPI_INT, &recv_counts[0], 1, MPI_INT, comm);
+
+    std::vector<int> send_displs(num_procs+1, 0), recv_displs(num_procs+1, 0);
+    for (int i = 0; i < num_procs; i++) {
+        send_displs[i+1] = send_displs[i] + send_counts[i];
+        recv_displs[i+1] = recv_displs[i] + recv_counts[i];
+    }
+
+    std::vector<T> send_buf(records.size());
+    std::vector<int> pos(send_displs.begin(), send_displs.end() - 1);
+    for (size_t i = 0; i < records.size(); i++)
+        send_buf[pos[dest[i]]++] = records[i];
+
+    for (int i = 0; i <= num_procs; i++) {
+        if (i < num_procs) {
+            send_counts[i] *= sizeof(T);
+            recv_counts[i] *= sizeof(T);
+        }
+        send_displs[i] *= sizeof(T);
+        recv_displs[i] *= sizeof(T);
+    }
+
+    received.resize(recv_displs[num_procs] / sizeof(T));
+    MPI_Alltoallv(send_buf.empty() ? NULL : &send_buf[0], &send_counts[0], &send_displs[0], MPI_BYTE,
+                  received.empty() ? NULL : &received[0], &recv_counts[0], &recv_displs[0], MPI_BYTE, comm);
+}
+
+
+int build_mesh_adjacency(MPI_Comm, const int*, int, long long, int, Mesh_adjacency*);
+void build_local_mesh(MPI_Comm, const int*, int, int, Local_mesh*);
+
+#endif
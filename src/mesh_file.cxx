@@ -0,0 +1,209 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "mesh_file.h"
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PDLN_FNV_OFFSET_BASIS           (0xcbf29ce484222325ULL)
+#define PDLN_FNV_PRIME                  (0x100000001b3ULL)
+#define PDLN_FINGERPRINT_CHUNK_SIZE     (4096)
+
+
+static inline unsigned long long fnv1a(unsigned long long hash, const void *data, size_t len)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= PDLN_FNV_PRIME;
+    }
+    return hash;
+}
+
+
+/*
+ * 64-bit FNV-1a over the coordinate values, hashed per chunk of points in
+ * parallel and then over the chunk hashes, so the result does not depend on
+ * the number of threads.
+ */
+unsigned long long calculate_grid_fingerprint(const double *lon, const double *lat, int num_points)
+{
+    int num_chunks = (num_points + PDLN_FINGERPRINT_CHUNK_SIZE - 1) / PDLN_FINGERPRINT_CHUNK_SIZE;
+    unsigned long long *chunk_hash = new unsigned long long[num_chunks];
+
+    #pragma omp parallel for
+    for (int c = 0; c < num_chunks; c++) {
+        int start = c * PDLN_FINGERPRINT_CHUNK_SIZE;
+        int end   = start + PDLN_FINGERPRINT_CHUNK_SIZE < num_points ? start + PDLN_FINGERPRINT_CHUNK_SIZE : num_points;
+        unsigned long long hash = PDLN_FNV_OFFSET_BASIS;
+        for (int i = start; i < end; i++) {
+            hash = fnv1a(hash, &lon[i], sizeof(double));
+            hash = fnv1a(hash, &lat[i], sizeof(double));
+        }
+        chunk_hash[c] = hash;
+    }
+
+    unsigned long long hash = fnv1a(PDLN_FNV_OFFSET_BASIS, &num_points, sizeof(int));
+    hash = fnv1a(hash, chunk_hash, num_chunks * sizeof(unsigned long long));
+
+    delete[] chunk_hash;
+    return hash;
+}
+
+
+static inline unsigned long long align_to_8(unsigned long long offset)
+{
+    return (offset + 7) / 8 * 8;
+}
+
+
+void init_mesh_file_header(Mesh_file_header *header, unsigned long long grid_fingerprint, unsigned long long num_points,
+                           unsigned long long num_triangles, unsigned long long num_blocks, unsigned ordering, bool has_adjacency,
+                           bool has_vertex_graph, unsigned long long num_vertex_neighbors)
+{
+    memset(header, 0, sizeof(Mesh_file_header));
+    memcpy(header->magic, PDLN_MESH_FILE_MAGIC, sizeof(header->magic));
+    header->version          = PDLN_MESH_FILE_VERSION;
+    header->index_width      = num_points > INT_MAX || num_triangles > INT_MAX ? 8 : 4;
+    header->ordering         = ordering;
+    header->flags            = (has_adjacency ? PDLN_MESH_HAS_ADJACENCY : 0) | (has_vertex_graph ? PDLN_MESH_HAS_VERTEX_GRAPH : 0);
+    header->grid_fingerprint = grid_fingerprint;
+    header->num_points       = num_points;
+    header->num_triangles    = num_triangles;
+    header->num_blocks       = num_blocks;
+
+    unsigned long long block_len = num_triangles * 3 * header->index_width;
+    unsigned long long offset    = PDLN_MESH_HEADER_SIZE;
+    header->triangles_offset     = offset;
+    offset += block_len;
+    if (has_adjacency) {
+        header->adjacency_offset = offset;
+        offset += block_len;
+    }
+    if (has_vertex_graph) {
+        header->num_vertex_neighbors    = num_vertex_neighbors;
+        header->vertex_offsets_offset   = align_to_8(offset);
+        header->vertex_neighbors_offset = header->vertex_offsets_offset + (num_points + 1) * sizeof(unsigned long long);
+        offset = header->vertex_neighbors_offset + num_vertex_neighbors * header->index_width;
+    }
+    header->block_index_offset   = align_to_8(offset);
+}
+
+
+Mesh_file_reader::Mesh_file_reader()
+    : base(NULL)
+    , length(0)
+    , header(NULL)
+{
+}
+
+
+Mesh_file_reader::~Mesh_file_reader()
+{
+    close();
+}
+
+
+/*
+ * whether count items of width bytes at offset, aligned to align bytes, lie after
+ * the header and within length bytes. Sizes are never summed, so hostile headers
+ * can not overflow the check.
+ */
+static inline bool is_section_valid(unsigned long long offset, unsigned long long count, unsigned long long width,
+                                    unsigned long long align, size_t length)
+{
+    return offset >= PDLN_MESH_HEADER_SIZE && offset <= length && offset % align == 0 && count <= (length - offset) / width;
+}
+
+
+/* return 0 on success, -1 if the file can not be mapped or is not a valid mesh file */
+int Mesh_file_reader::open(const char *filename)
+{
+    close();
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (unsigned long long)st.st_size < PDLN_MESH_HEADER_SIZE) {
+        ::close(fd);
+        return -1;
+    }
+
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return -1;
+
+    base   = (const char*)addr;
+    length = st.st_size;
+
+    const Mesh_file_header *h = (const Mesh_file_header*)base;
+    if (memcmp(h->magic, PDLN_MESH_FILE_MAGIC, sizeof(h->magic)) != 0 || h->version != PDLN_MESH_FILE_VERSION ||
+        (h->index_width != 4 && h->index_width != 8)) {
+        close();
+        return -1;
+    }
+
+    unsigned long long width = h->index_width;
+    bool valid = is_section_valid(h->triangles_offset, h->num_triangles, 3 * width, width, length) &&
+                 is_section_valid(h->block_index_offset, h->num_blocks, sizeof(Mesh_block_entry), 8, length);
+    if (h->flags & PDLN_MESH_HAS_ADJACENCY)
+        valid = valid && is_section_valid(h->adjacency_offset, h->num_triangles, 3 * width, width, length);
+    if (h->flags & PDLN_MESH_HAS_VERTEX_GRAPH)
+        valid = valid && is_section_valid(h->vertex_offsets_offset, h->num_points, sizeof(unsigned long long), 8, length) &&
+                h->num_points < (length - h->vertex_offsets_offset) / sizeof(unsigned long long) &&
+                is_section_valid(h->vertex_neighbors_offset, h->num_vertex_neighbors, width, width, length);
+    if (!valid) {
+        close();
+        return -1;
+    }
+
+    header = h;
+
+    Mesh_span<Mesh_block_entry> blocks = get_blocks();
+    for (size_t i = 0; i < blocks.size; i++)
+        if (blocks[i].first_triangle > h->num_triangles || blocks[i].num_triangles > h->num_triangles - blocks[i].first_triangle) {
+            close();
+            return -1;
+        }
+
+    return 0;
+}
+
+
+void Mesh_file_reader::close()
+{
+    if (base)
+        munmap((void*)base, length);
+    base   = NULL;
+    length = 0;
+    header = NULL;
+}
+
+
+Mesh_span<Mesh_block_entry> Mesh_file_reader::get_blocks() const
+{
+    if (!header)
+        return Mesh_span<Mesh_block_entry>();
+    return Mesh_span<Mesh_block_entry>((const Mesh_block_entry*)(base + header->block_index_offset), header->num_blocks);
+}
+
+
+Mesh_span<unsigned long long> Mesh_file_reader::get_vertex_offsets() const
+{
+    if (!header || !(header->flags & PDLN_MESH_HAS_VERTEX_GRAPH))
+        return Mesh_span<unsigned long long>();
+    return Mesh_span<unsigned long long>((const unsigned long long*)(base + header->vertex_offsets_offset), header->num_points + 1);
+}
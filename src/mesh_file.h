@@ -0,0 +1,140 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#ifndef PDLN_MESH_FILE_H
+#define PDLN_MESH_FILE_H
+
+#include <cstddef>
+
+/*
+ * Binary triangulation file, all fields in native byte order:
+ *
+ *   header        PDLN_MESH_HEADER_SIZE bytes, Mesh_file_header then zeros
+ *   triangles     num_triangles vertex-id triplets, index_width bytes per id
+ *   adjacency     optional, num_triangles triplets of neighbor triangle indexes,
+ *                 the neighbor across the edge opposite to each vertex, -1 for none
+ *   vertex graph  optional, CSR of the vertex-to-vertex graph: num_points+1 8-byte
+ *                 offsets, 8-byte aligned, then num_vertex_neighbors vertex ids
+ *   block index   num_blocks Mesh_block_entry, 8-byte aligned
+ *
+ * Triangles are stored in blocks of at most PDLN_MESH_BLOCK_SIZE consecutive
+ * triangles, the block index keeps the range of vertex ids used by each block,
+ * so that a part of the mesh can be loaded without touching the rest.
+ */
+#define PDLN_MESH_FILE_MAGIC        "PDLNMESH"
+#define PDLN_MESH_FILE_VERSION      (1)
+#define PDLN_MESH_HEADER_SIZE       (128)
+#define PDLN_MESH_BLOCK_SIZE        (65536)
+
+/* ordering of triangles, ids of each triangle are ascending unless unordered */
+#define PDLN_MESH_ORDER_NONE        (0)
+#define PDLN_MESH_ORDER_IDS         (1)     /* by vertex ids over the whole file */
+#define PDLN_MESH_ORDER_IDS_IN_BLOCK (2)    /* by vertex ids within each block */
+#define PDLN_MESH_ORDER_HILBERT     (3)     /* along the Hilbert curve of centroids over the whole file */
+#define PDLN_MESH_ORDER_HILBERT_IN_BLOCK (4)    /* along the Hilbert curve within each block */
+
+#define PDLN_MESH_HAS_ADJACENCY     (0x1)
+#define PDLN_MESH_HAS_VERTEX_GRAPH  (0x2)
+
+
+struct Mesh_file_header {
+    char               magic[8];
+    unsigned           version;
+    unsigned           index_width;         /* bytes per vertex id or triangle index, 4 or 8 */
+    unsigned           ordering;
+    unsigned           flags;
+    unsigned long long grid_fingerprint;    /* see calculate_grid_fingerprint */
+    unsigned long long num_points;
+    unsigned long long num_triangles;
+    unsigned long long num_blocks;
+    unsigned long long triangles_offset;
+    unsigned long long adjacency_offset;    /* 0 without adjacency */
+    unsigned long long block_index_offset;
+    unsigned long long num_vertex_neighbors;
+    unsigned long long vertex_offsets_offset;   /* 0 without vertex graph */
+    unsigned long long vertex_neighbors_offset;
+};
+
+
+struct Mesh_block_entry {
+    unsigned long long first_triangle;
+    unsigned long long num_triangles;
+    unsigned long long min_vertex;
+    unsigned long long max_vertex;
+};
+
+
+template <typename T>
+struct Mesh_span {
+    const T* data;
+    size_t   size;
+
+    Mesh_span() : data(NULL), size(0) {}
+    Mesh_span(const T* data, size_t size) : data(data), size(size) {}
+    const T& operator[](size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+};
+
+
+void init_mesh_file_header(Mesh_file_header*, unsigned long long, unsigned long long, unsigned long long,
+                           unsigned long long, unsigned, bool, bool =false, unsigned long long =0);
+unsigned long long calculate_grid_fingerprint(const double*, const double*, int);
+
+
+/*
+ * Read-only view of a mesh file mapped into memory. Spans stay valid until
+ * close() or destruction; nothing is copied.
+ */
+class Mesh_file_reader {
+public:
+    Mesh_file_reader();
+    ~Mesh_file_reader();
+
+    int  open(const char*);
+    void close();
+
+    const Mesh_file_header* get_header() const { return header; }
+    Mesh_span<Mesh_block_entry> get_blocks() const;
+
+    /* ids of triangles as 3*num values, T must be index_width bytes wide, otherwise the span is empty */
+    template <typename T> Mesh_span<T> get_triangles() const {
+        if (!header || sizeof(T) != header->index_width)
+            return Mesh_span<T>();
+        return Mesh_span<T>((const T*)(base + header->triangles_offset), header->num_triangles * 3);
+    }
+
+    template <typename T> Mesh_span<T> get_block_triangles(unsigned long long i) const {
+        if (!header || sizeof(T) != header->index_width || i >= header->num_blocks)
+            return Mesh_span<T>();
+        const Mesh_block_entry& block = get_blocks()[i];
+        return Mesh_span<T>((const T*)(base + header->triangles_offset) + block.first_triangle * 3, block.num_triangles * 3);
+    }
+
+    template <typename T> Mesh_span<T> get_adjacency() const {
+        if (!header || sizeof(T) != header->index_width || !(header->flags & PDLN_MESH_HAS_ADJACENCY))
+            return Mesh_span<T>();
+        return Mesh_span<T>((const T*)(base + header->adjacency_offset), header->num_triangles * 3);
+    }
+
+    /* neighbors of vertex v are vertex_neighbors[vertex_offsets[v], vertex_offsets[v+1]) */
+    Mesh_span<unsigned long long> get_vertex_offsets() const;
+
+    template <typename T> Mesh_span<T> get_vertex_neighbors() const {
+        if (!header || sizeof(T) != header->index_width || !(header->flags & PDLN_MESH_HAS_VERTEX_GRAPH))
+            return Mesh_span<T>();
+        return Mesh_span<T>((const T*)(base + header->vertex_neighbors_offset), header->num_vertex_neighbors);
+    }
+
+private:
+    const char*             base;
+    size_t                  length;
+    const Mesh_file_header* header;
+};
+
+#endif
@@ -188,3 +188,40 @@ void read_file_field_as_int(const char *file_name, const char *field_name, void
     rcode = nc_close(ncfile_id);
     report_nc_error(rcode);
 }
+
+
+/* look up a variable, the ids and lengths of its at most max_dims dimensions;
+ * return the number of dimensions, -1 if the variable is missing or has more */
+int get_nc_variable_shape(int ncfile_id, const char *field_name, int *variable_id, int *dim_ids, size_t *dim_sizes, int max_dims)
+{
+    int rcode, num_dims, all_dim_ids[NC_MAX_VAR_DIMS];
+
+    if (nc_inq_varid(ncfile_id, field_name, variable_id) != NC_NOERR)
+        return -1;
+
+    rcode = nc_inq_varndims(ncfile_id, *variable_id, &num_dims);
+    report_nc_error(rcode);
+    if (rcode != NC_NOERR || num_dims > max_dims)
+        return -1;
+
+    rcode = nc_inq_vardimid(ncfile_id, *variable_id, all_dim_ids);
+    report_nc_error(rcode);
+    for (int i = 0; i < num_dims; i ++) {
+        dim_ids[i] = all_dim_ids[i];
+        rcode = nc_inq_dimlen(ncfile_id, dim_ids[i], &dim_sizes[i]);
+        report_nc_error(rcode);
+        if (rcode != NC_NOERR)
+            return -1;
+    }
+
+    return num_dims;
+}
+
+
+/* read the hyperslab (start, count) of a variable, converted into doubles */
+bool read_nc_variable_slab(int ncfile_id, int variable_id, const size_t *start, const size_t *count, double *data_array)
+{
+    int rcode = nc_get_vara_double(ncfile_id, variable_id, start, count, data_array);
+    report_nc_error(rcode);
+    return rcode == NC_NOERR;
+}
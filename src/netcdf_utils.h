@@ -10,9 +10,13 @@
 #ifndef NETCDF_UTILS_H
 #define NETCDF_UTILS_H
 
+#include <cstddef>
+
 extern void report_nc_error(int rcode);
 extern void read_file_field_as_float(const char *, const char *, void **, int *, int **, int *);
 extern void read_file_field_as_double(const char *, const char *, void **, int *, int **, int *, char* unit=NULL);
 extern void read_file_field_as_int(const char *, const char *, void **, int *, int **, int *, char* unit=NULL);
+extern int  get_nc_variable_shape(int, const char *, int *, int *, size_t *, int);
+extern bool read_nc_variable_slab(int, int, const size_t *, const size_t *, double *);
 
 #endif
@@ -8,8 +8,11 @@
 
 
 #include "patcc.h"
+#include "cubed_sphere.h"
 #include "common_utils.h"
 #include "projection.h"
+#include "mesh_file.h"
+#include "circle_index.h"
 #include "timer.h"
 #include <cstdio>
 #include <sys/time.h>
@@ -18,6 +21,32 @@
 
 #define PDLN_DEFAULT_MIN_NUM_POINTS (100)
 
+/* number of leaves per processing unit, can be overridden at build time */
+#ifndef PDLN_OVER_DECOMPOSITION_FACTOR
+#define PDLN_OVER_DECOMPOSITION_FACTOR (1)
+#endif
+
+/* number of angular sectors of each polar cap, 0 for undivided caps */
+#ifndef PDLN_NUM_POLAR_SECTORS
+#define PDLN_NUM_POLAR_SECTORS (0)
+#endif
+
+/* decompose global grids by cubed-sphere faces instead of in lon/lat space */
+#ifndef PDLN_CUBED_SPHERE_DECOMPOSITION
+#define PDLN_CUBED_SPHERE_DECOMPOSITION (false)
+#endif
+
+/* sort the preprocessed points along the Hilbert curve, keeping their global indexes */
+#ifndef PDLN_HILBERT_INPUT_ORDER
+#define PDLN_HILBERT_INPUT_ORDER (false)
+#endif
+
+/* send triangles of verified leaves to process 0 while other leaves still iterate,
+ * see Delaunay_grid_decomposition::set_triangle_streaming */
+#ifndef PDLN_STREAM_MERGED_TRIANGLES
+#define PDLN_STREAM_MERGED_TRIANGLES (false)
+#endif
+
 long time_proc_mgt = 0;
 long time_pretreat = 0;
 long time_decomose = 0;
@@ -38,11 +67,25 @@ Grid* Patcc::search_grid_by_id(int id)
 Grid::~Grid()
 {
     delete delaunay_triangulation;
+    delete cubed_sphere;
 }
 
 int Grid::generate_delaunay_trianglulation(Processing_resource *proc_resource, Grid_info grid_info)
 {
-    delaunay_triangulation = new Delaunay_grid_decomposition(grid_info, proc_resource, PDLN_DEFAULT_MIN_NUM_POINTS);
+    if (PDLN_CUBED_SPHERE_DECOMPOSITION) {
+        /* grids with fence points are triangulated in the lon/lat plane */
+        if (grid_info.is_cyclic && grid_info.num_fence_points == 0) {
+            log(LOG_INFO, "decomposing grid by cubed-sphere faces\n");
+            cubed_sphere = new Cubed_sphere_decomposition(grid_info, proc_resource, PDLN_DEFAULT_MIN_NUM_POINTS,
+                                                          PDLN_OVER_DECOMPOSITION_FACTOR);
+            return cubed_sphere->generate_trianglulation();
+        }
+        log(LOG_WARNING, "cubed-sphere decomposition is only for global grids, decomposing in lon/lat space\n");
+    }
+
+    delaunay_triangulation = new Delaunay_grid_decomposition(grid_info, proc_resource, PDLN_DEFAULT_MIN_NUM_POINTS,
+                                                             PDLN_OVER_DECOMPOSITION_FACTOR, PDLN_NUM_POLAR_SECTORS);
+    delaunay_triangulation->set_triangle_streaming(PDLN_STREAM_MERGED_TRIANGLES);
 
     timeval start, end;
     MPI_Barrier(proc_resource->get_mpi_comm());
@@ -77,14 +120,27 @@ int Grid::generate_delaunay_trianglulation(Processing_resource *proc_resource, G
 #ifdef OPENCV
 void Grid::plot_triangles_into_file()
 {
-    this->delaunay_triangulation->plot_local_triangles("log/chunk");
+    if (delaunay_triangulation)
+        this->delaunay_triangulation->plot_local_triangles("log/chunk");
 }
 #endif
 
 
 void Grid::merge_all_triangles(bool sort)
 {
-    delaunay_triangulation->merge_all_triangles(sort);
+    if (cubed_sphere)
+        cubed_sphere->merge_all_triangles(sort);
+    else
+        delaunay_triangulation->merge_all_triangles(sort);
+}
+
+
+void Grid::get_local_mesh(int num_ghost_layers, Local_mesh *mesh)
+{
+    if (cubed_sphere)
+        cubed_sphere->get_local_mesh(num_ghost_layers, mesh);
+    else
+        delaunay_triangulation->get_local_mesh(num_ghost_layers, mesh);
 }
 
 
@@ -133,6 +189,80 @@ void combine_buckets(Bucket *buckets, int index, int buf_len, unsigned effective
 }
 
 
+static void init_buckets(Bucket *buckets, int num_buckets)
+{
+    for (int i = 0; i < num_buckets; i++) {
+        buckets[i].min = 1e10;
+        buckets[i].max = -1e10;
+        buckets[i].num = 0;
+    }
+}
+
+
+/* merge num_threads consecutive arrays of num_buckets partial buckets into buckets */
+static void merge_thread_buckets(Bucket *buckets, const Bucket *thread_buckets, int num_buckets, int num_threads)
+{
+    #pragma omp parallel for
+    for (int i = 0; i < num_buckets; i++)
+        for (int k = 0; k < num_threads; k++) {
+            const Bucket &partial = thread_buckets[k*num_buckets+i];
+            if (buckets[i].min > partial.min) buckets[i].min = partial.min;
+            if (buckets[i].max < partial.max) buckets[i].max = partial.max;
+            buckets[i].num += partial.num;
+        }
+}
+
+
+/* fill xyz[][start, end) with unit vectors of coord[][start, end) */
+static void calculate_xyz_in_parallel(double **coord, double **xyz, int start, int end)
+{
+    int total_threads = omp_get_max_threads();
+    int num = end - start;
+
+    #pragma omp parallel for
+    for (int k = 0; k < total_threads; k++) {
+        int local_start = start + k * (num / total_threads);
+        int local_num   = k==total_threads-1 ? num/total_threads+num%total_threads : num / total_threads;
+
+        lonlat2xyz_batch(&coord[PDLN_LON][local_start], &coord[PDLN_LAT][local_start], local_num,
+                         &xyz[0][local_start], &xyz[1][local_start], &xyz[2][local_start]);
+    }
+}
+
+
+/*
+ * Permute coord and mask of num points along the Hilbert curve of their unit
+ * vectors, so that the search tree, the halo scans and local triangulations
+ * go through neighboring points together. xyz stays indexed by global index.
+ * return the global index of each new position.
+ */
+static int* reorder_points_by_hilbert_curve(double **coord, double **xyz, bool *mask, int num)
+{
+    int *order = new int[num];
+    order_points_by_hilbert_curve(xyz, num, order);
+
+    double *buf = new double[num];
+    for (int k = 0; k < 2; k++) {
+        #pragma omp parallel for
+        for (int i = 0; i < num; i++)
+            buf[i] = coord[k][order[i]];
+        memcpy(coord[k], buf, num*sizeof(double));
+    }
+    delete[] buf;
+
+    if (mask) {
+        bool *mask_buf = new bool[num];
+        #pragma omp parallel for
+        for (int i = 0; i < num; i++)
+            mask_buf[i] = mask[order[i]];
+        memcpy(mask, mask_buf, num*sizeof(bool));
+        delete[] mask_buf;
+    }
+
+    return order;
+}
+
+
 #define PAT_GVPOINT_DENSITY  (1)
 #define PAT_INSERT_EXPAND_RATIO (0.01)
 #define PAT_DUP_USER_INPUT (true)
@@ -140,12 +270,14 @@ void Patcc::grid_preprocessing(int grid_id)
 {
     double min_lon, max_lon, min_lat, max_lat;
     double **user_coord_values;
+    double **user_xyz_values;
     double *coord_values[2];
     int num_points;
     bool is_cyclic;
 
     grid_info_mgr->get_grid_boundry(grid_id, &min_lon, &max_lon, &min_lat, &max_lat);
     user_coord_values = grid_info_mgr->get_grid_coord_values(grid_id);
+    user_xyz_values = grid_info_mgr->get_grid_xyz_values(grid_id);
     num_points = grid_info_mgr->get_grid_num_points(grid_id);
     is_cyclic = grid_info_mgr->is_grid_cyclic(grid_id);
 
@@ -153,6 +285,12 @@ void Patcc::grid_preprocessing(int grid_id)
     log(LOG_DEBUG, "Input grid info: boundary (%lf, %lf, %lf, %lf)\n", min_lon, max_lon, min_lat, max_lat);
     log(LOG_DEBUG, "Input grid info: cyclic %d\n", is_cyclic);
 
+#ifdef PDLN_BINARY_OUTPUT
+    grid_info.fingerprint = calculate_grid_fingerprint(user_coord_values[PDLN_LON], user_coord_values[PDLN_LAT], num_points);
+#else
+    grid_info.fingerprint = 0;
+#endif
+
     if (PAT_DUP_USER_INPUT) {
         coord_values[0] = new double[num_points];
         memcpy(coord_values[0], user_coord_values[0], sizeof(double)*num_points);
@@ -165,6 +303,11 @@ void Patcc::grid_preprocessing(int grid_id)
 
     int total_threads = omp_get_max_threads();
 
+    double* xyz_values[3];
+    xyz_values[0] = new double[num_points];
+    xyz_values[1] = new double[num_points];
+    xyz_values[2] = new double[num_points];
+
     DISABLING_POINTS_METHOD mask_method;
     int num;
     void* data;
@@ -187,6 +330,15 @@ void Patcc::grid_preprocessing(int grid_id)
     bool do_npole_processing = float_eq(max_lat,  90.0);
     bool do_disabled_point_making = mask_method == DISABLE_POINTS_BY_RANGE;
 
+    double* disabled_circles_xyz = NULL;
+    Circle_index* disabled_circles = NULL;
+    if (do_disabled_point_making) {
+        disabled_circles_xyz = new double[num*4];
+        for (int j = 0; j < num; j++)
+            calculate_circle_xyz(&((double*) data)[j*3], &disabled_circles_xyz[j*4]);
+        disabled_circles = new Circle_index(disabled_circles_xyz, num);
+    }
+
     double split_line = (min_lon + max_lon) * 0.5;
 
     double min_lat_except_pole_public = 1e10;
@@ -212,6 +364,10 @@ void Patcc::grid_preprocessing(int grid_id)
         all_maxY[i] = -1e10;
     }
 
+    /* pole indexes found by each thread, concatenated in thread order afterwards */
+    std::vector<int>* thread_spoles_index = new std::vector<int>[total_threads];
+    std::vector<int>* thread_npoles_index = new std::vector<int>[total_threads];
+
     #pragma omp parallel for
     for (int k = 0; k < total_threads; k++) {
         int local_start = k * (num_points / total_threads);
@@ -233,33 +389,33 @@ void Patcc::grid_preprocessing(int grid_id)
             if (do_monotone) {
                 if(coord_values[PDLN_LON][i] > split_line) coord_values[PDLN_LON][i] -= 360;
             }
+        }
 
+        /* shifting longitudes by 360 leaves the unit vectors as they were given */
+        if (user_xyz_values)
+            for (int j = 0; j < 3; j++)
+                memcpy(&xyz_values[j][local_start], &user_xyz_values[j][local_start], local_num*sizeof(double));
+        else
+            lonlat2xyz_batch(&coord_values[PDLN_LON][local_start], &coord_values[PDLN_LAT][local_start], local_num,
+                             &xyz_values[0][local_start], &xyz_values[1][local_start], &xyz_values[2][local_start]);
+
+        for(int i = local_start; i < local_start+local_num; i++) {
             if (do_spole_processing) {
-                if(float_eq(coord_values[PDLN_LAT][i], -90.0)) {
-                    #pragma omp critical
-                    shifted_spoles_index.push_back(i);
-                } else if(min_lat_except_pole > coord_values[PDLN_LAT][i])
+                if(float_eq(coord_values[PDLN_LAT][i], -90.0))
+                    thread_spoles_index[k].push_back(i);
+                else if(min_lat_except_pole > coord_values[PDLN_LAT][i])
                     min_lat_except_pole = coord_values[PDLN_LAT][i];
             }
 
             if (do_npole_processing) {
-                if(float_eq(coord_values[PDLN_LAT][i], 90.0)) {
-                    #pragma omp critical
-                    shifted_npoles_index.push_back(i);
-                } else if(max_lat_except_pole < coord_values[PDLN_LAT][i])
+                if(float_eq(coord_values[PDLN_LAT][i], 90.0))
+                    thread_npoles_index[k].push_back(i);
+                else if(max_lat_except_pole < coord_values[PDLN_LAT][i])
                     max_lat_except_pole = coord_values[PDLN_LAT][i];
             }
 
-            if (do_disabled_point_making) {
-                mask[i] = true;
-                for (int j = 0; j < num; j++) {
-                    double *disabled_circle = (double*) data;
-                    if (point_in_circle(coord_values[0][i], coord_values[1][i], &disabled_circle[j*3])) {
-                        mask[i] = false;
-                        break;
-                    }
-                }
-            }
+            if (do_disabled_point_making)
+                mask[i] = !disabled_circles->covers(xyz_values[0][i], xyz_values[1][i], xyz_values[2][i]);
 
             if (coord_values[PDLN_LON][i] < minX) minX = coord_values[PDLN_LON][i];
             if (coord_values[PDLN_LON][i] > maxX) maxX = coord_values[PDLN_LON][i];
@@ -282,6 +438,8 @@ void Patcc::grid_preprocessing(int grid_id)
         if (maxX_public < all_maxX[i]) maxX_public = all_maxX[i];
         if (minY_public > all_minY[i]) minY_public = all_minY[i];
         if (maxY_public < all_maxY[i]) maxY_public = all_maxY[i];
+        shifted_spoles_index.insert(shifted_spoles_index.end(), thread_spoles_index[i].begin(), thread_spoles_index[i].end());
+        shifted_npoles_index.insert(shifted_npoles_index.end(), thread_npoles_index[i].begin(), thread_npoles_index[i].end());
     }
     maxX_public += PDLN_HIGH_BOUNDRY_SHIFTING;
     maxY_public += PDLN_HIGH_BOUNDRY_SHIFTING;
@@ -292,6 +450,10 @@ void Patcc::grid_preprocessing(int grid_id)
     delete[] all_maxX;
     delete[] all_minY;
     delete[] all_maxY;
+    delete[] thread_spoles_index;
+    delete[] thread_npoles_index;
+    delete disabled_circles;
+    delete[] disabled_circles_xyz;
 
     if(is_cyclic) {
         min_lon = 0;
@@ -306,15 +468,21 @@ void Patcc::grid_preprocessing(int grid_id)
     if(do_spole_processing && shifted_spoles_index.size() != 1) {
         double shifting_lat = (-90.0 + min_lat_except_pole_public) * 0.5;
 
-        for(unsigned i = 0; i < shifted_spoles_index.size(); i++)
-            coord_values[PDLN_LAT][shifted_spoles_index[i]] = shifting_lat;
+        for(unsigned i = 0; i < shifted_spoles_index.size(); i++) {
+            int idx = shifted_spoles_index[i];
+            coord_values[PDLN_LAT][idx] = shifting_lat;
+            lonlat2xyz(coord_values[PDLN_LON][idx], shifting_lat, &xyz_values[0][idx], &xyz_values[1][idx], &xyz_values[2][idx]);
+        }
     }
 
     if(do_npole_processing && shifted_npoles_index.size() != 1) {
         double shifting_lat = (90.0 + max_lat_except_pole_public) * 0.5;
 
-        for(unsigned i = 0; i < shifted_npoles_index.size(); i++)
-            coord_values[PDLN_LAT][shifted_npoles_index[i]] = shifting_lat;
+        for(unsigned i = 0; i < shifted_npoles_index.size(); i++) {
+            int idx = shifted_npoles_index[i];
+            coord_values[PDLN_LAT][idx] = shifting_lat;
+            lonlat2xyz(coord_values[PDLN_LON][idx], shifting_lat, &xyz_values[0][idx], &xyz_values[1][idx], &xyz_values[2][idx]);
+        }
     }
 
     /* fence points inserting */
@@ -323,12 +491,16 @@ void Patcc::grid_preprocessing(int grid_id)
                                      (do_npole_processing && shifted_npoles_index.size() != 1);
 
     double* extended_coord[2];
+    double* extended_xyz[3];
     bool*   extended_mask = NULL;
 
     int num_vpoles, num_current;
     if (!do_fence_point_inserting && !do_virtual_pole_inserting) {
         extended_coord[0] = coord_values[0];
         extended_coord[1] = coord_values[1];
+        extended_xyz[0] = xyz_values[0];
+        extended_xyz[1] = xyz_values[1];
+        extended_xyz[2] = xyz_values[2];
         extended_mask = mask;
         num_vpoles = 0;
         num_current = num_points;
@@ -361,42 +533,42 @@ void Patcc::grid_preprocessing(int grid_id)
 
         Bucket* x_buckets = NULL;
         Bucket* y_buckets = NULL;
-        if (do_n_inserting || do_s_inserting) {
+        Bucket* thread_x_buckets = NULL;
+        Bucket* thread_y_buckets = NULL;
+        if (do_ns_inserting) {
             x_buckets = new Bucket[num_x];
-            for (int i = 0; i < num_x; i++) {
-                x_buckets[i].min = 1e10;
-                x_buckets[i].max = -1e10;
-                x_buckets[i].num = 0;
-            }
+            init_buckets(x_buckets, num_x);
+            thread_x_buckets = new Bucket[total_threads*num_x];
         }
 
         if (do_we_inserting) {
             y_buckets = new Bucket[num_y];
-            for (int i = 0; i < num_y; i++) {
-                y_buckets[i].min = 1e10;
-                y_buckets[i].max = -1e10;
-                y_buckets[i].num = 0;
-            }
+            init_buckets(y_buckets, num_y);
+            thread_y_buckets = new Bucket[total_threads*num_y];
         }
 
-        /* scan all points and update buckets' info */
+        /* scan all points into buckets private to each thread, then merge them */
         #pragma omp parallel for
         for (int k = 0; k < total_threads; k++) {
             int local_start = k * (num_points / total_threads);
             int local_num   = k==total_threads-1 ? num_points/total_threads+num_points%total_threads : num_points / total_threads;
 
+            Bucket* local_x_buckets = do_ns_inserting ? &thread_x_buckets[k*num_x] : NULL;
+            Bucket* local_y_buckets = do_we_inserting ? &thread_y_buckets[k*num_y] : NULL;
+            if (do_ns_inserting)
+                init_buckets(local_x_buckets, num_x);
+            if (do_we_inserting)
+                init_buckets(local_y_buckets, num_y);
+
             for(int i = local_start; i < local_start+local_num; i++) {
                 if (do_ns_inserting) {
                     int idx = get_bucket_index(coord_values[PDLN_LON][i], minX_public, widthX / num_x);
 
                     PDASSERT(idx >= 0 && idx < num_x);
 
-                    #pragma omp critical
-                    {
-                        if (x_buckets[idx].min > coord_values[PDLN_LAT][i]) x_buckets[idx].min = coord_values[PDLN_LAT][i];
-                        if (x_buckets[idx].max < coord_values[PDLN_LAT][i]) x_buckets[idx].max = coord_values[PDLN_LAT][i];
-                        x_buckets[idx].num++;
-                    }
+                    if (local_x_buckets[idx].min > coord_values[PDLN_LAT][i]) local_x_buckets[idx].min = coord_values[PDLN_LAT][i];
+                    if (local_x_buckets[idx].max < coord_values[PDLN_LAT][i]) local_x_buckets[idx].max = coord_values[PDLN_LAT][i];
+                    local_x_buckets[idx].num++;
                 }
 
                 if (do_we_inserting) {
@@ -404,16 +576,20 @@ void Patcc::grid_preprocessing(int grid_id)
 
                     PDASSERT(idx >= 0 && idx < num_y);
 
-                    #pragma omp critical
-                    {
-                        if (y_buckets[idx].min > coord_values[PDLN_LON][i]) y_buckets[idx].min = coord_values[PDLN_LON][i];
-                        if (y_buckets[idx].max < coord_values[PDLN_LON][i]) y_buckets[idx].max = coord_values[PDLN_LON][i];
-                        y_buckets[idx].num++;
-                    }
+                    if (local_y_buckets[idx].min > coord_values[PDLN_LON][i]) local_y_buckets[idx].min = coord_values[PDLN_LON][i];
+                    if (local_y_buckets[idx].max < coord_values[PDLN_LON][i]) local_y_buckets[idx].max = coord_values[PDLN_LON][i];
+                    local_y_buckets[idx].num++;
                 }
             }
         }
 
+        if (do_ns_inserting)
+            merge_thread_buckets(x_buckets, thread_x_buckets, num_x, total_threads);
+        if (do_we_inserting)
+            merge_thread_buckets(y_buckets, thread_y_buckets, num_y, total_threads);
+        delete[] thread_x_buckets;
+        delete[] thread_y_buckets;
+
         /* counting number of new points */
         unsigned num_new_points = 0;
         if (!float_eq(min_lat, -90))
@@ -427,12 +603,18 @@ void Patcc::grid_preprocessing(int grid_id)
 
         extended_coord[0] = new double[num_points + num_new_points];
         extended_coord[1] = new double[num_points + num_new_points];
+        for (int i = 0; i < 3; i++)
+            extended_xyz[i] = new double[num_points + num_new_points];
         if (mask)
             extended_mask = new bool[num_points + num_new_points];
 
         /* Firstly, store all original points */
         memcpy(extended_coord[PDLN_LON], coord_values[PDLN_LON], num_points*sizeof(double));
         memcpy(extended_coord[PDLN_LAT], coord_values[PDLN_LAT], num_points*sizeof(double));
+        for (int i = 0; i < 3; i++) {
+            memcpy(extended_xyz[i], xyz_values[i], num_points*sizeof(double));
+            delete[] xyz_values[i];
+        }
         if (mask)
             memcpy(extended_mask, mask, num_points*sizeof(bool));
 
@@ -555,14 +737,35 @@ void Patcc::grid_preprocessing(int grid_id)
         if (mask)
             memset(&extended_mask[num_points], 1, num_current - num_points);
 
+        calculate_xyz_in_parallel(extended_coord, extended_xyz, num_points, num_current);
+
         PDASSERT(num_current - num_points <= num_new_points && num_current - num_points >= num_new_points - 2);
     }
 
-    if (delete_redundent_points(extended_coord[PDLN_LON], extended_coord[PDLN_LAT], num_current))
+    int *kept_index = new int[num_current];
+    if (delete_redundent_points(extended_coord[PDLN_LON], extended_coord[PDLN_LAT], num_current, kept_index)) {
         log(LOG_WARNING, "redundent points found, deleting...\n");
+        /* compact unit vectors and mask as the coordinates, kept_index never exceeds i */
+        for (int i = 0; i < num_current; i++) {
+            for (int k = 0; k < 3; k++)
+                extended_xyz[k][i] = extended_xyz[k][kept_index[i]];
+            if (extended_mask)
+                extended_mask[i] = extended_mask[kept_index[i]];
+        }
+    }
+    delete[] kept_index;
+
+    int* global_index = NULL;
+    if (PDLN_HILBERT_INPUT_ORDER) {
+        log(LOG_DEBUG, "Sorting points along the Hilbert curve\n");
+        global_index = reorder_points_by_hilbert_curve(extended_coord, extended_xyz, extended_mask, num_current);
+    }
 
     grid_info.coord_values[PDLN_LON] = extended_coord[PDLN_LON];
     grid_info.coord_values[PDLN_LAT] = extended_coord[PDLN_LAT];
+    grid_info.xyz_values[0] = extended_xyz[0];
+    grid_info.xyz_values[1] = extended_xyz[1];
+    grid_info.xyz_values[2] = extended_xyz[2];
     grid_info.mask = extended_mask;
     grid_info.num_total_points = num_current;
     grid_info.num_vitual_poles = num_vpoles;
@@ -572,14 +775,17 @@ void Patcc::grid_preprocessing(int grid_id)
     grid_info.boundary.min_lat = min_lat;
     grid_info.boundary.max_lat = max_lat;
     grid_info.is_cyclic = is_cyclic;
+    grid_info.global_index = global_index;
+    grid_info.chart_face = -1;
 }
 
 
 Patcc::~Patcc()
 {
-    delete proc_resource;
+    /* grids release their buffers through proc_resource */
     for(unsigned i = 0; i < grids.size(); i ++)
         delete grids[i];
+    delete proc_resource;
 }
 
 
@@ -646,3 +852,19 @@ int Patcc::generate_delaunay_trianglulation(int grid_id, bool sort)
 #endif
     return 0;
 }
+
+
+/*
+ * Triangles owned by this process plus num_ghost_layers layers of ghost
+ * triangles with their owners, once generate_delaunay_trianglulation has
+ * triangulated the grid. Collective over the processes of the grid.
+ */
+int Patcc::get_local_mesh(int grid_id, int num_ghost_layers, Local_mesh *mesh)
+{
+    Grid *operating_grid = search_grid_by_id(grid_id);
+    if (operating_grid == NULL || !operating_grid->have_delaunay_trianglulation() || num_ghost_layers < 0)
+        return -1;
+
+    operating_grid->get_local_mesh(num_ghost_layers, mesh);
+    return 0;
+}
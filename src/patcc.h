@@ -13,18 +13,22 @@
 #include "processing_unit_mgt.h"
 #include "grid_decomposition.h"
 
+class Cubed_sphere_decomposition;
+
 class Grid
 {
 private:
     int grid_id;
     Delaunay_grid_decomposition *delaunay_triangulation;
+    Cubed_sphere_decomposition  *cubed_sphere;
 public:
-    Grid(int id):grid_id(id){ delaunay_triangulation = NULL; };
+    Grid(int id):grid_id(id){ delaunay_triangulation = NULL; cubed_sphere = NULL; };
     ~Grid();
     int get_grid_id(){ return grid_id; };
     int generate_delaunay_trianglulation(Processing_resource*, Grid_info);
-    bool have_delaunay_trianglulation(){return delaunay_triangulation != NULL; };
+    bool have_delaunay_trianglulation(){return delaunay_triangulation != NULL || cubed_sphere != NULL; };
     void merge_all_triangles(bool);
+    void get_local_mesh(int, Local_mesh*);
 #ifdef OPENCV
     void plot_triangles_into_file();
 #endif
@@ -38,6 +42,7 @@ public:
     ~Patcc();
     void register_grid(Grid* grid){this->grids.push_back(grid); };
     int generate_delaunay_trianglulation(int, bool=false);
+    int get_local_mesh(int, int, Local_mesh*);
 
 private:
     Grid* search_grid_by_id(int);
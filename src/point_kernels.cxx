@@ -0,0 +1,207 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "point_kernels.h"
+
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER) && (defined(__x86_64__) || defined(__i386__))
+#define PDLN_X86_DISPATCH
+#endif
+
+#ifdef __GNUC__
+#define PDLN_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define PDLN_ALWAYS_INLINE inline
+#endif
+
+
+/*
+ * Vector bodies. Comparisons are combined with & and |, and codes are picked
+ * by selects, so the loops have no branch and the compiler vectorizes them
+ * for whatever ISA the including function is compiled for.
+ */
+static PDLN_ALWAYS_INLINE void classify_halo_points_body(const double *x, const double *y, int num, const Halo_bounds *b,
+                                                         unsigned char *codes)
+{
+    #pragma omp simd
+    for (int i = 0; i < num; i++) {
+        double xi = x[i], yi = y[i];
+        int code = PDLN_NO_HALO;
+        /* the first matching halo wins, so go backwards */
+        for (int k = 2; k >= 0; k--) {
+            const double *in  = b->inner[k];
+            const double *out = b->outer[k];
+            int in_inner = (xi >= in[0]) & (xi < in[1]) & (yi >= in[2]) & (yi < in[3]);
+            int in_outer = (xi >= out[0]) & (xi < out[1]) & (yi >= out[2]) & (yi < out[3]);
+            code = in_outer & !in_inner ? k : code;
+        }
+        codes[i] = code;
+    }
+}
+
+
+static PDLN_ALWAYS_INLINE void classify_quantized_halo_points_body(const unsigned *qx, const unsigned *qy, int num, const Halo_bounds *b,
+                                                                   unsigned char *uncertain)
+{
+    #pragma omp simd
+    for (int i = 0; i < num; i++) {
+        double x = qx[i], y = qy[i];
+        int surely_out = 1;
+        for (int k = 0; k < 3; k++) {
+            const double *in  = b->inner[k];
+            const double *out = b->outer[k];
+            /* a point of cell c is surely < v if c + 2 <= v, and surely >= v if c >= v + 1 */
+            int out_of_outer = (x + 2 <= out[0]) | (x >= out[1] + 1) | (y + 2 <= out[2]) | (y >= out[3] + 1);
+            int in_inner     = (x >= in[0] + 1) & (x + 2 <= in[1]) & (y >= in[2] + 1) & (y + 2 <= in[3]);
+            surely_out &= out_of_outer | in_inner;
+        }
+        uncertain[i] = !surely_out;
+    }
+}
+
+
+static PDLN_ALWAYS_INLINE void classify_region_points_body(const double *x, const double *y, int num, const double *region,
+                                                           unsigned char *flags)
+{
+    double min_lon = region[0], max_lon = region[1], min_lat = region[2], max_lat = region[3];
+
+    #pragma omp simd
+    for (int i = 0; i < num; i++)
+        flags[i] = (x[i] >= min_lon) & (x[i] < max_lon) & (y[i] >= min_lat) & (y[i] < max_lat);
+}
+
+
+#define PDLN_DEFINE_POINT_KERNELS(isa, attribute)                                                                                   \
+    static attribute void classify_halo_points_##isa(const double *x, const double *y, int num, const Halo_bounds *b,               \
+                                                     unsigned char *codes)                                                          \
+    {                                                                                                                               \
+        classify_halo_points_body(x, y, num, b, codes);                                                                             \
+    }                                                                                                                               \
+    static attribute void classify_quantized_halo_points_##isa(const unsigned *qx, const unsigned *qy, int num,                     \
+                                                               const Halo_bounds *b, unsigned char *uncertain)                      \
+    {                                                                                                                               \
+        classify_quantized_halo_points_body(qx, qy, num, b, uncertain);                                                             \
+    }                                                                                                                               \
+    static attribute void classify_region_points_##isa(const double *x, const double *y, int num, const double *region,             \
+                                                       unsigned char *flags)                                                        \
+    {                                                                                                                               \
+        classify_region_points_body(x, y, num, region, flags);                                                                      \
+    }
+
+PDLN_DEFINE_POINT_KERNELS(generic, )
+#ifdef PDLN_X86_DISPATCH
+PDLN_DEFINE_POINT_KERNELS(avx2, __attribute__((target("avx2"))))
+PDLN_DEFINE_POINT_KERNELS(avx512, __attribute__((target("avx512f"))))
+#endif
+
+
+/* generic, then each ISA the CPU supports, from the narrowest vectors */
+static Point_kernels supported_point_kernels[3];
+static int           num_supported_point_kernels = 0;
+
+
+static Point_kernels select_point_kernels()
+{
+    Point_kernels generic = {"generic", classify_halo_points_generic, classify_quantized_halo_points_generic,
+                             classify_region_points_generic};
+    supported_point_kernels[num_supported_point_kernels++] = generic;
+#ifdef PDLN_X86_DISPATCH
+    /* may run before main, when the CPU model is not initialized yet */
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        Point_kernels avx2 = {"avx2", classify_halo_points_avx2, classify_quantized_halo_points_avx2,
+                              classify_region_points_avx2};
+        supported_point_kernels[num_supported_point_kernels++] = avx2;
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        Point_kernels avx512 = {"avx512f", classify_halo_points_avx512, classify_quantized_halo_points_avx512,
+                                classify_region_points_avx512};
+        supported_point_kernels[num_supported_point_kernels++] = avx512;
+    }
+#endif
+    return supported_point_kernels[num_supported_point_kernels-1];
+}
+
+
+static const Point_kernels point_kernels = select_point_kernels();
+
+
+void classify_halo_points(const double *x, const double *y, int num, const Halo_bounds *b, unsigned char *codes)
+{
+    point_kernels.classify_halo_points(x, y, num, b, codes);
+}
+
+
+void classify_quantized_halo_points(const unsigned *qx, const unsigned *qy, int num, const Halo_bounds *b, unsigned char *uncertain)
+{
+    point_kernels.classify_quantized_halo_points(qx, qy, num, b, uncertain);
+}
+
+
+void classify_region_points(const double *x, const double *y, int num, const double *region, unsigned char *flags)
+{
+    point_kernels.classify_region_points(x, y, num, region, flags);
+}
+
+
+const char* get_point_kernels_isa()
+{
+    return point_kernels.isa;
+}
+
+
+int get_point_kernels_variants(const Point_kernels **variants)
+{
+    *variants = supported_point_kernels;
+    return num_supported_point_kernels;
+}
+
+
+static inline bool is_in_rectangle(double x, double y, const double *r)
+{
+    return x >= r[0] && x < r[1] && y >= r[2] && y < r[3];
+}
+
+
+void classify_halo_points_scalar(const double *x, const double *y, int num, const Halo_bounds *b, unsigned char *codes)
+{
+    for (int i = 0; i < num; i++) {
+        codes[i] = PDLN_NO_HALO;
+        for (int k = 0; k < 3; k++)
+            if (is_in_rectangle(x[i], y[i], b->outer[k]) && !is_in_rectangle(x[i], y[i], b->inner[k])) {
+                codes[i] = k;
+                break;
+            }
+    }
+}
+
+
+void classify_quantized_halo_points_scalar(const unsigned *qx, const unsigned *qy, int num, const Halo_bounds *b, unsigned char *uncertain)
+{
+    for (int i = 0; i < num; i++) {
+        double x = qx[i], y = qy[i];
+        uncertain[i] = 0;
+        for (int k = 0; k < 3; k++) {
+            const double *in  = b->inner[k];
+            const double *out = b->outer[k];
+            bool out_of_outer = x + 2 <= out[0] || x >= out[1] + 1 || y + 2 <= out[2] || y >= out[3] + 1;
+            bool in_inner     = x >= in[0] + 1 && x + 2 <= in[1] && y >= in[2] + 1 && y + 2 <= in[3];
+            if (!out_of_outer && !in_inner) {
+                uncertain[i] = 1;
+                break;
+            }
+        }
+    }
+}
+
+
+void classify_region_points_scalar(const double *x, const double *y, int num, const double *region, unsigned char *flags)
+{
+    for (int i = 0; i < num; i++)
+        flags[i] = is_in_rectangle(x[i], y[i], region);
+}
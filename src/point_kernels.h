@@ -0,0 +1,65 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#ifndef PDLN_POINT_KERNELS_H
+#define PDLN_POINT_KERNELS_H
+
+/*
+ * Branch-free kernels classifying points against rectangles, which the halo
+ * search and the partition of halo points run over every candidate point.
+ * Each writes one flag or code per point, so that callers can compact the
+ * points afterwards. The vector versions are compiled for several ISAs and
+ * the best one for the CPU is chosen at startup; the *_scalar versions are
+ * the reference they agree with.
+ */
+
+/* points in none of the shifted halos */
+#define PDLN_NO_HALO (3)
+
+/*
+ * A halo and its copies shifted by -360 and 360 degrees in longitude. Each
+ * rectangle is {min_lon, max_lon, min_lat, max_lat}, a point being in it if
+ * min <= x < max for both coordinates.
+ */
+struct Halo_bounds {
+    double inner[3][4];
+    double outer[3][4];
+};
+
+/* codes[i]: the first k with point i in outer[k] but not in inner[k], PDLN_NO_HALO if none */
+void classify_halo_points(const double*, const double*, int, const Halo_bounds*, unsigned char*);
+void classify_halo_points_scalar(const double*, const double*, int, const Halo_bounds*, unsigned char*);
+
+/*
+ * uncertain[i]: 0 if point i, given by cells of quantized coordinates and with
+ * bounds in the same cells, is surely out of all outer[k] or within inner[k]
+ * with a margin of one cell, 1 otherwise
+ */
+void classify_quantized_halo_points(const unsigned*, const unsigned*, int, const Halo_bounds*, unsigned char*);
+void classify_quantized_halo_points_scalar(const unsigned*, const unsigned*, int, const Halo_bounds*, unsigned char*);
+
+/* flags[i]: whether point i is in the rectangle {min_lon, max_lon, min_lat, max_lat} */
+void classify_region_points(const double*, const double*, int, const double*, unsigned char*);
+void classify_region_points_scalar(const double*, const double*, int, const double*, unsigned char*);
+
+/* name of the instruction set the vector kernels run with */
+const char* get_point_kernels_isa();
+
+/* the vector kernels compiled for one instruction set */
+struct Point_kernels {
+    const char* isa;
+    void (*classify_halo_points)(const double*, const double*, int, const Halo_bounds*, unsigned char*);
+    void (*classify_quantized_halo_points)(const unsigned*, const unsigned*, int, const Halo_bounds*, unsigned char*);
+    void (*classify_region_points)(const double*, const double*, int, const double*, unsigned char*);
+};
+
+/* all variants the CPU can run, the chosen one last; return their number */
+int get_point_kernels_variants(const Point_kernels**);
+
+#endif
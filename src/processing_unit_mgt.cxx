@@ -41,6 +41,34 @@ unsigned int BKDRHash(char *str, unsigned int n)
 
 
 Processing_resource::Processing_resource() {
+    initialize(process_thread_mgr->get_mpi_rank(), process_thread_mgr->get_mpi_size(), process_thread_mgr->get_mpi_comm());
+
+    timeval start, end;
+    gettimeofday(&start, NULL);
+    set_cpu_affinity();
+    gettimeofday(&end, NULL);
+#ifdef TIME_PERF
+    printf("[ - ] set_cpu_affinity: %ld us\n", (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec));
+#endif
+    time_proc_mgt -= (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+}
+
+
+/*
+ * Processing units of the processes in comm, which is a part of the processes
+ * of an existing resource. Threads are not pinned again, as common ids restart
+ * from 0 and would put threads of different parts onto the same cores.
+ */
+Processing_resource::Processing_resource(MPI_Comm comm) {
+    int rank, size;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    initialize(rank, size, comm);
+}
+
+
+void Processing_resource::initialize(int rank, int size, MPI_Comm comm) {
     char hostname[MAX_HOSTNAME_LEN];
     int *num_threads_per_process;
     unsigned int local_hostname_checksum, *hostname_checksum_per_process;
@@ -53,9 +81,9 @@ Processing_resource::Processing_resource() {
 
     process_thread_mgr->get_hostname(hostname, MAX_HOSTNAME_LEN);
     local_hostname_checksum = BKDRHash(hostname, MAX_HOSTNAME_LEN);
-    local_process_id = process_thread_mgr->get_mpi_rank();
-    num_total_processes = process_thread_mgr->get_mpi_size();
-    mpi_comm = process_thread_mgr->get_mpi_comm();
+    local_process_id = rank;
+    num_total_processes = size;
+    mpi_comm = comm;
     num_local_threads = process_thread_mgr->get_openmp_size();
     
     PDASSERT(num_total_processes > 0);
@@ -88,15 +116,6 @@ Processing_resource::Processing_resource() {
 
     delete[] num_threads_per_process;
     delete[] hostname_checksum_per_process;
-
-    timeval start, end;
-    gettimeofday(&start, NULL);
-    set_cpu_affinity();
-    gettimeofday(&end, NULL);
-#ifdef TIME_PERF
-    printf("[ - ] set_cpu_affinity: %ld us\n", (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec));
-#endif
-    time_proc_mgt -= (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
 }
 
 
@@ -64,11 +64,13 @@ private:
     vector<Thread_comm_packet> send_packets;
     vector<Thread_comm_packet> recv_packets;
     
+    void initialize(int, int, MPI_Comm);
     int identify_processing_units_by_hostname();
     void set_cpu_affinity();
 
 public:
     Processing_resource();
+    Processing_resource(MPI_Comm);
     ~Processing_resource();
     void pick_out_active_processing_units(int, bool*);
     Processing_unit* get_processing_unit(int common_id) { return processing_units[common_id]; };
@@ -10,55 +10,37 @@
 #include "projection.h"
 #include "common_utils.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 
 
+#define PDLN_DEGREE_TO_RADIAN_D          ((double) (PI/180.0))
+#define PDLN_TRIG_CACHE_BITS             (9)
+#define PDLN_TRIG_CACHE_SIZE             (1 << PDLN_TRIG_CACHE_BITS)
+#define PDLN_PROJECTION_CHUNK_SIZE       (256)
+/* 1 + cos(angle to tangent point); points closer than ~0.1 degree to the antipode are rejected */
+#define PDLN_MIN_PROJECTION_DENOMINATOR  ((double) 1e-6)
+
+
 /* reference: https://www.uwgb.edu/dutchs/structge/sphproj.htm */
 /* Original formula:
  *      X = 2 * x / (1 + y)
  *      Z = 2 * z / (1 + y)
  */
-static inline void lonlat2xyz(double lon, double lat, PAT_REAL *x, PAT_REAL *y, PAT_REAL *z)
+void lonlat2xyz(double lon, double lat, double *x, double *y, double *z)
 {
-    *x = cosl(DEGREE_TO_RADIAN((PAT_REAL)lat)) * sinl(DEGREE_TO_RADIAN((PAT_REAL)lon));
-    *y = sinl(DEGREE_TO_RADIAN((PAT_REAL)lat));
-    *z = cosl(DEGREE_TO_RADIAN((PAT_REAL)lat)) * cosl(DEGREE_TO_RADIAN((PAT_REAL)lon));
-}
+    double sin_lat = sin(lat * PDLN_DEGREE_TO_RADIAN_D);
+    double cos_lat = cos(lat * PDLN_DEGREE_TO_RADIAN_D);
 
-
-static inline void stereo_lonlat2xyz(double lon_p, double lat_p, double lon_t, double lat_t, PAT_REAL *x, PAT_REAL *y, PAT_REAL *z)
-{
-    PAT_REAL p_x, p_y, p_z;
-    PAT_REAL t_x, t_y, t_z;
-
-    lonlat2xyz(lon_p, lat_p, &p_x, &p_y, &p_z);
-    lonlat2xyz(lon_t, lat_t, &t_x, &t_y, &t_z);
-
-    PAT_REAL s  = 2.0 / (t_x*(t_x+p_x) + t_y*(t_y+p_y) + t_z*(t_z+p_z));
-
-    *x = s * p_x + (s - 1.0) * t_x;
-    *y = s * p_y + (s - 1.0) * t_y;
-    *z = s * p_z + (s - 1.0) * t_z;
+    *x = cos_lat * sin(lon * PDLN_DEGREE_TO_RADIAN_D);
+    *y = sin_lat;
+    *z = cos_lat * cos(lon * PDLN_DEGREE_TO_RADIAN_D);
 }
 
 
-static inline void fast_stereo_lonlat2xyz(double lon_p, double lat_p, PAT_REAL t_x, PAT_REAL t_y, PAT_REAL t_z, PAT_REAL *x, PAT_REAL *y, PAT_REAL *z)
+static inline void normalize_vector(double *x, double *y, double *z)
 {
-    PAT_REAL p_x, p_y, p_z;
-
-    lonlat2xyz(lon_p, lat_p, &p_x, &p_y, &p_z);
-
-    PAT_REAL s  = 2.0 / (t_x*(t_x+p_x) + t_y*(t_y+p_y) + t_z*(t_z+p_z));
-
-    *x = s * p_x + (s - 1.0) * t_x;
-    *y = s * p_y + (s - 1.0) * t_y;
-    *z = s * p_z + (s - 1.0) * t_z;
-}
-
-
-static inline void normalize_vector(PAT_REAL *x, PAT_REAL *y, PAT_REAL *z)
-{
-    PAT_REAL length = std::sqrt(*x * *x + *y * *y + *z * *z);
+    double length = std::sqrt(*x * *x + *y * *y + *z * *z);
     *x /= length;
     *y /= length;
     *z /= length;
@@ -67,26 +49,28 @@ static inline void normalize_vector(PAT_REAL *x, PAT_REAL *y, PAT_REAL *z)
 
 using std::fabs;
 using std::min;
-static inline void calculate_unit_vectors(double t_lon, double t_lat, 
-                                          PAT_REAL *v1_x, PAT_REAL *v1_y, PAT_REAL *v1_z,
-                                          PAT_REAL *v2_x, PAT_REAL *v2_y, PAT_REAL *v2_z)
+void calculate_unit_vectors(double t_lon, double t_lat, double t[3], double e1[3], double e2[3])
 {
-    PAT_REAL t_x, t_y, t_z;
+    lonlat2xyz(t_lon, t_lat, &t[0], &t[1], &t[2]);
+    calculate_plane_unit_vectors(t, e1, e2);
+}
 
-    lonlat2xyz(t_lon, t_lat, &t_x, &t_y, &t_z);
 
-    PAT_REAL min_dir = min(fabs(t_x),min(fabs(t_y),fabs(t_z)));
-    PAT_REAL axis_x, axis_y, axis_z;
+/* e1 & e2: orthonormal vectors of the plane tangent at unit vector t */
+void calculate_plane_unit_vectors(const double t[3], double e1[3], double e2[3])
+{
+    double min_dir = min(fabs(t[0]),min(fabs(t[1]),fabs(t[2])));
+    double axis_x, axis_y, axis_z;
 
-    if (min_dir == fabs(t_x)) {
+    if (min_dir == fabs(t[0])) {
         axis_x = 1.0;
         axis_y = 0.0;
         axis_z = 0.0;
-    } else if (min_dir == fabs(t_y)) {
+    } else if (min_dir == fabs(t[1])) {
         axis_x = 0.0;
         axis_y = 1.0;
         axis_z = 0.0;
-    } else if (min_dir == fabs(t_z)) {
+    } else if (min_dir == fabs(t[2])) {
         axis_x = 0.0;
         axis_y = 0.0;
         axis_z = 1.0;
@@ -94,53 +78,149 @@ static inline void calculate_unit_vectors(double t_lon, double t_lat,
         assert(false);
     }
 
-    *v1_x = t_y * axis_z - t_z * axis_y;
-    *v1_y = t_z * axis_x - t_x * axis_z;
-    *v1_z = t_x * axis_y - t_y * axis_x;
+    e1[0] = t[1] * axis_z - t[2] * axis_y;
+    e1[1] = t[2] * axis_x - t[0] * axis_z;
+    e1[2] = t[0] * axis_y - t[1] * axis_x;
 
-    normalize_vector(v1_x, v1_y, v1_z);
+    normalize_vector(&e1[0], &e1[1], &e1[2]);
 
-    *v2_x = t_y * *v1_z - t_z * *v1_y;
-    *v2_y = t_z * *v1_x - t_x * *v1_z;
-    *v2_z = t_x * *v1_y - t_y * *v1_x;
+    e2[0] = t[1] * e1[2] - t[2] * e1[1];
+    e2[1] = t[2] * e1[0] - t[0] * e1[2];
+    e2[2] = t[0] * e1[1] - t[1] * e1[0];
 
-    normalize_vector(v2_x, v2_y, v2_z);
+    normalize_vector(&e2[0], &e2[1], &e2[2]);
+}
+
+
+const double multip_ratio = 100;
+/*
+ * p: point on the unit sphere need to be projected
+ * t: tangent point
+ * e1 & e2: unit vector on the projection plane
+ * X & Y: coordinate values of point p on the projection plane
+ * return the denominator 1 + <p, t>, which vanishes at the antipode of t
+ */
+static inline double project_xyz(double p_x, double p_y, double p_z, const double *t,
+                                 const double *e1, const double *e2, double &X, double &Y)
+{
+    double d   = t[0]*(t[0]+p_x) + t[1]*(t[1]+p_y) + t[2]*(t[2]+p_z);
+    double s   = 2.0 / d;
+    double q_x = s * p_x + (s - 1.0) * t[0];
+    double q_y = s * p_y + (s - 1.0) * t[1];
+    double q_z = s * p_z + (s - 1.0) * t[2];
+
+    X = (q_x * e1[0] + q_y * e1[1] + q_z * e1[2]) * multip_ratio;
+    Y = (q_x * e2[0] + q_y * e2[1] + q_z * e2[2]) * multip_ratio;
+    return d;
 }
 
 
-const PAT_REAL multip_ratio = 100;
 void calculate_stereographic_projection(double p_lon, double p_lat, double t_lon, double t_lat, double &X, double &Y)
 {
-    PAT_REAL q_x, q_y, q_z;
-    PAT_REAL e1_x, e1_y, e1_z;
-    PAT_REAL e2_x, e2_y, e2_z;
+    double p[3], t[3], e1[3], e2[3];
 
-    stereo_lonlat2xyz(p_lon, p_lat, t_lon, t_lat, &q_x, &q_y, &q_z);
-    calculate_unit_vectors(t_lon, t_lat, &e1_x, &e1_y, &e1_z, &e2_x, &e2_y, &e2_z);
+    lonlat2xyz(p_lon, p_lat, &p[0], &p[1], &p[2]);
+    calculate_unit_vectors(t_lon, t_lat, t, e1, e2);
+    project_xyz(p[0], p[1], p[2], t, e1, e2, X, Y);
+}
 
-    X = (q_x * e1_x + q_y * e1_y + q_z * e1_z) * multip_ratio;
-    Y = (q_x * e2_x + q_y * e2_y + q_z * e2_z) * multip_ratio;
+
+/* Direct-mapped memo of sin/cos. Coordinates of tensor-product grids share a
+ * few hundred distinct longitudes and latitudes, so most lookups hit. */
+class Trig_cache
+{
+    public:
+        Trig_cache() {
+            for (int i = 0; i < PDLN_TRIG_CACHE_SIZE; i++)
+                key[i] = NAN;
+        }
+
+        inline void get(double deg, double *sin_v, double *cos_v) {
+            unsigned long long bits;
+            memcpy(&bits, &deg, sizeof(bits));
+            int h = ((bits ^ (bits >> 29)) * 0x9E3779B97F4A7C15ULL) >> (64 - PDLN_TRIG_CACHE_BITS);
+            if (key[h] != deg) {
+                key[h] = deg;
+                sin_tab[h] = sin(deg * PDLN_DEGREE_TO_RADIAN_D);
+                cos_tab[h] = cos(deg * PDLN_DEGREE_TO_RADIAN_D);
+            }
+            *sin_v = sin_tab[h];
+            *cos_v = cos_tab[h];
+        }
+
+    private:
+        double key[PDLN_TRIG_CACHE_SIZE];
+        double sin_tab[PDLN_TRIG_CACHE_SIZE];
+        double cos_tab[PDLN_TRIG_CACHE_SIZE];
+};
+
+
+/*
+ * Convert num points given in degrees into unit vectors.
+ * sin/cos of repeated longitudes and latitudes are looked up in the caches.
+ */
+void lonlat2xyz_batch(const double *lon, const double *lat, int num, double *x, double *y, double *z)
+{
+    Trig_cache lon_cache, lat_cache;
+
+    for (int i = 0; i < num; i++) {
+        double sin_lon, cos_lon, sin_lat, cos_lat;
+
+        lon_cache.get(lon[i], &sin_lon, &cos_lon);
+        lat_cache.get(lat[i], &sin_lat, &cos_lat);
+        x[i] = cos_lat * sin_lon;
+        y[i] = sin_lat;
+        z[i] = cos_lat * cos_lon;
+    }
 }
 
 
-/* 
- * p: point need to be projected
- * t: tangent point
- * e1 & e2: unit vector on the projection plane
- * X & Y: coordinate values of point p on the projection plane
+/*
+ * Project num points, whose unit vectors are xyz[][index[i]], onto the plane
+ * tangent at t. Coordinates are gathered per chunk first, then the projection
+ * itself runs as a branch-free loop the compiler can vectorize.
+ * return the number of points that can not be projected (non-finite input
+ * or too close to the antipode of t); their X & Y are not meaningful.
  */
-void fast_stereographic_projection(double p_lon, double p_lat,
-                                   PAT_REAL t_x, PAT_REAL t_y, PAT_REAL t_z,
-                                   PAT_REAL e1_x, PAT_REAL e1_y, PAT_REAL e1_z,
-                                   PAT_REAL e2_x, PAT_REAL e2_y, PAT_REAL e2_z,
-                                   double &X, double &Y)
+int stereographic_projection_batch(double **xyz, const int *index, int num,
+                                   const double t[3], const double e1[3], const double e2[3],
+                                   double *X, double *Y)
 {
-    PAT_REAL q_x, q_y, q_z;
+    double p_x[PDLN_PROJECTION_CHUNK_SIZE], p_y[PDLN_PROJECTION_CHUNK_SIZE], p_z[PDLN_PROJECTION_CHUNK_SIZE];
+    int num_failed = 0;
+
+    for (int start = 0; start < num; start += PDLN_PROJECTION_CHUNK_SIZE) {
+        int len = std::min(PDLN_PROJECTION_CHUNK_SIZE, num - start);
+
+        for (int i = 0; i < len; i++) {
+            p_x[i] = xyz[0][index[start+i]];
+            p_y[i] = xyz[1][index[start+i]];
+            p_z[i] = xyz[2][index[start+i]];
+        }
+
+        #pragma omp simd reduction(+:num_failed)
+        for (int i = 0; i < len; i++) {
+            double d = project_xyz(p_x[i], p_y[i], p_z[i], t, e1, e2, X[start+i], Y[start+i]);
+            num_failed += !(d >= PDLN_MIN_PROJECTION_DENOMINATOR && fabs(X[start+i]) < HUGE_VAL && fabs(Y[start+i]) < HUGE_VAL);
+        }
+    }
+
+    return num_failed;
+}
 
-    fast_stereo_lonlat2xyz(p_lon, p_lat, t_x, t_y, t_z, &q_x, &q_y, &q_z);
 
-    X = (q_x * e1_x + q_y * e1_y + q_z * e1_z) * multip_ratio;
-    Y = (q_x * e2_x + q_y * e2_y + q_z * e2_z) * multip_ratio;
+/* circle_data: (lon, lat, radius) in degrees
+ * circle_xyz:  unit vector of the center and cosine of the radius */
+void calculate_circle_xyz(const double circle_data[3], double circle_xyz[4])
+{
+    lonlat2xyz(circle_data[0], circle_data[1], &circle_xyz[0], &circle_xyz[1], &circle_xyz[2]);
+    circle_xyz[3] = cos(circle_data[2] * PDLN_DEGREE_TO_RADIAN_D);
+}
+
+
+bool point_in_circle_xyz(double x, double y, double z, const double circle_xyz[4])
+{
+    return x * circle_xyz[0] + y * circle_xyz[1] + z * circle_xyz[2] >= circle_xyz[3];
 }
 
 
@@ -152,3 +232,65 @@ bool point_in_circle(double lon_deg, double lat_deg, double circle_data[3])
     double lat2 = DEGREE_TO_RADIAN(circle_data[1]);
     return acos(sin(lat1) * sin(lat2) + cos(lat1) * cos(lat2) * cos(lon1 - lon2)) <= DEGREE_TO_RADIAN(circle_data[2]);
 }
+
+
+/*
+ * Frames of the six cubed-sphere faces: the face normal, then the two axes of
+ * its gnomonic plane. Faces 0-3 surround the equator at longitude 0, 90, 180
+ * and 270, face 4 is centered at the north pole and face 5 at the south pole.
+ */
+static const double cube_face_frames[6][3][3] = {
+    {{ 0,  0,  1}, { 1,  0,  0}, { 0,  1,  0}},
+    {{ 1,  0,  0}, { 0,  0, -1}, { 0,  1,  0}},
+    {{ 0,  0, -1}, {-1,  0,  0}, { 0,  1,  0}},
+    {{-1,  0,  0}, { 0,  0,  1}, { 0,  1,  0}},
+    {{ 0,  1,  0}, { 1,  0,  0}, { 0,  0, -1}},
+    {{ 0, -1,  0}, { 1,  0,  0}, { 0,  0,  1}},
+};
+
+
+void get_cube_face_frame(int face, double frame[3][3])
+{
+    memcpy(frame, cube_face_frames[face], sizeof(cube_face_frames[face]));
+}
+
+
+/* the face whose normal is closest to the point; ties go to the polar faces, then to z */
+int get_cube_face_of_xyz(double x, double y, double z)
+{
+    double ax = fabs(x), ay = fabs(y), az = fabs(z);
+
+    if (ay >= ax && ay >= az)
+        return y >= 0 ? 4 : 5;
+    if (az >= ax)
+        return z >= 0 ? 0 : 2;
+    return x >= 0 ? 1 : 3;
+}
+
+
+/*
+ * Gnomonic projection onto the plane of a face, scaled so that the face
+ * itself spans [-PDLN_CUBE_CHART_SCALE, PDLN_CUBE_CHART_SCALE] on both axes.
+ * return false if the point is not on the hemisphere of the face.
+ */
+bool xyz_to_cube_chart(const double frame[3][3], double x, double y, double z, double *u, double *v)
+{
+    double d = frame[0][0]*x + frame[0][1]*y + frame[0][2]*z;
+
+    if (d <= 0)
+        return false;
+
+    *u = (frame[1][0]*x + frame[1][1]*y + frame[1][2]*z) / d * PDLN_CUBE_CHART_SCALE;
+    *v = (frame[2][0]*x + frame[2][1]*y + frame[2][2]*z) / d * PDLN_CUBE_CHART_SCALE;
+    return true;
+}
+
+
+void cube_chart_to_xyz(const double frame[3][3], double u, double v, double xyz[3])
+{
+    u /= PDLN_CUBE_CHART_SCALE;
+    v /= PDLN_CUBE_CHART_SCALE;
+    for (int i = 0; i < 3; i++)
+        xyz[i] = frame[0][i] + u * frame[1][i] + v * frame[2][i];
+    normalize_vector(&xyz[0], &xyz[1], &xyz[2]);
+}
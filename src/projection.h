@@ -16,8 +16,22 @@
 #define DEGREE_TO_RADIAN(data)    (data*PI/180.0)
 #define RADIAN_TO_DEGREE(data)    (data*180.0/PI)
 
+/* half width of the gnomonic chart of a cubed-sphere face, in degree-like units */
+#define PDLN_CUBE_CHART_SCALE     (45.0)
+#define PDLN_NUM_CUBE_FACES       (6)
+
+extern void lonlat2xyz(double, double, double*, double*, double*);
+extern void calculate_unit_vectors(double, double, double*, double*, double*);
+extern void calculate_plane_unit_vectors(const double*, double*, double*);
 extern void calculate_stereographic_projection(double, double, double, double, double&, double&);
-extern void fast_stereographic_projection(double, double, PAT_REAL, PAT_REAL, PAT_REAL, PAT_REAL, PAT_REAL, PAT_REAL, PAT_REAL, PAT_REAL, PAT_REAL, double&, double&);
+extern void lonlat2xyz_batch(const double*, const double*, int, double*, double*, double*);
+extern int stereographic_projection_batch(double**, const int*, int, const double*, const double*, const double*, double*, double*);
 extern bool point_in_circle(double, double, double*);
+extern void calculate_circle_xyz(const double*, double*);
+extern bool point_in_circle_xyz(double, double, double, const double*);
+extern void get_cube_face_frame(int, double[3][3]);
+extern int get_cube_face_of_xyz(double, double, double);
+extern bool xyz_to_cube_chart(const double[3][3], double, double, double, double*, double*);
+extern void cube_chart_to_xyz(const double[3][3], double, double, double*);
 
 #endif
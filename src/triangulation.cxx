@@ -17,13 +17,19 @@
 #include <cstdio>
 #include <cstring>
 #include <sys/time.h>
-#include <tr1/unordered_map>
-#include <list>
+#include <omp.h>
+#include <algorithm>
 #include <utility>
 
 #define PAT_NUM_LOCAL_VPOINTS (4)
 #define PAT_CYCLIC_EDGE_THRESHOLD (180)
 
+#define PDLN_RADIX_BITS               (11)
+#define PDLN_RADIX_SIZE               (1 << PDLN_RADIX_BITS)
+#define PDLN_RADIX_MASK               (PDLN_RADIX_SIZE - 1)
+#define PDLN_MIN_PARALLEL_SORT_SIZE   (1 << 14)
+#define PDLN_HILBERT_BITS             (21)
+
 /*
  *           o Center
  *           ^
@@ -58,45 +64,144 @@ static inline void swap(Point *p1, Point *p2)
 }
 
 
-static int compare_v2(const void* a, const void* b)
+inline void sort_points_in_triangle(Triangle_inline& triangle)
 {
-    Triangle_inline t1 = *(const Triangle_inline*)a;
-    Triangle_inline t2 = *(const Triangle_inline*)b;
-
-    if(t1.v[2].id < t2.v[2].id) return -1;
-    if(t1.v[2].id > t2.v[2].id) return  1;
-    return 0;
+    if(triangle.v[0].id > triangle.v[1].id) std::swap(triangle.v[0], triangle.v[1]);
+    if(triangle.v[1].id > triangle.v[2].id) std::swap(triangle.v[1], triangle.v[2]);
+    if(triangle.v[0].id > triangle.v[1].id) std::swap(triangle.v[0], triangle.v[1]);
 }
 
 
-static int compare_v1(const void* a, const void* b)
-{
-    Triangle_inline t1 = *(const Triangle_inline*)a;
-    Triangle_inline t2 = *(const Triangle_inline*)b;
+/* canonical key of a triangle: its vertex ids in ascending order, and where it comes from */
+struct Triangle_key {
+    unsigned v[3];
+    int      index;
+};
 
-    if(t1.v[1].id < t2.v[1].id) return -1;
-    if(t1.v[1].id > t2.v[1].id) return  1;
-    return 0;
+
+/* position of a point or a triangle on the Hilbert curve, v[0] is the high word */
+struct Curve_key {
+    unsigned v[2];
+    int      index;
+};
+
+
+/*
+ * One stable counting pass over the digit of v[word] at shift, from src into dst.
+ * Each thread counts and scatters a contiguous chunk, so the pass is stable.
+ * return false if all keys share the digit, dst is then left untouched.
+ */
+template <typename Key>
+static bool radix_sort_pass(const Key *src, Key *dst, int num, int word, int shift, int *counts, int num_threads)
+{
+    bool skip = false;
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int nt    = omp_get_num_threads();
+        int t     = omp_get_thread_num();
+        int start = (long)num * t / nt;
+        int end   = (long)num * (t+1) / nt;
+        int *cnt  = counts + t * PDLN_RADIX_SIZE;
+
+        memset(cnt, 0, sizeof(int) * PDLN_RADIX_SIZE);
+        for (int i = start; i < end; i++)
+            cnt[(src[i].v[word] >> shift) & PDLN_RADIX_MASK]++;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            int offset = 0;
+            for (int d = 0; d < PDLN_RADIX_SIZE; d++)
+                for (int k = 0; k < nt; k++) {
+                    int c = counts[k * PDLN_RADIX_SIZE + d];
+                    skip = skip || c == num;
+                    counts[k * PDLN_RADIX_SIZE + d] = offset;
+                    offset += c;
+                }
+        }
+
+        if (!skip)
+            for (int i = start; i < end; i++)
+                dst[cnt[(src[i].v[word] >> shift) & PDLN_RADIX_MASK]++] = src[i];
+    }
+
+    return !skip;
 }
 
 
-static int compare_v0(const void* a, const void* b)
-{
-    Triangle_inline t1 = *(const Triangle_inline*)a;
-    Triangle_inline t2 = *(const Triangle_inline*)b;
+/*
+ * Sort canonical keys with an LSD radix sort, visiting only the digits the
+ * largest id needs, then drop duplicated keys.
+ * keys is replaced by the distinct keys in order, return their number.
+ */
+static int sort_triangle_keys(Triangle_key **keys, int num, int num_threads)
+{
+    unsigned max_id = 0;
+    Triangle_key *src = *keys;
+
+    #pragma omp parallel for num_threads(num_threads) reduction(max:max_id)
+    for (int i = 0; i < num; i++)
+        max_id = std::max(max_id, src[i].v[2]);
+
+    int id_bits = 0;
+    while (id_bits < 32 && (max_id >> id_bits) > 0)
+        id_bits++;
+
+    Triangle_key *buf = new Triangle_key[num];
+    int *counts = new int[num_threads * PDLN_RADIX_SIZE];
+    for (int word = 2; word >= 0; word--)
+        for (int shift = 0; shift < id_bits; shift += PDLN_RADIX_BITS)
+            if (radix_sort_pass(src, buf, num, word, shift, counts, num_threads))
+                std::swap(src, buf);
+
+    /* counts[t]: distinct keys of the chunk of thread t, then where they go */
+    int num_unique = 0;
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int nt    = omp_get_num_threads();
+        int t     = omp_get_thread_num();
+        int start = (long)num * t / nt;
+        int end   = (long)num * (t+1) / nt;
+        int count = 0;
+
+        for (int i = start; i < end; i++)
+            count += i == 0 || memcmp(src[i].v, src[i-1].v, sizeof(src[i].v)) != 0;
+        counts[t] = count;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int k = 0; k < nt; k++) {
+                int c = counts[k];
+                counts[k] = num_unique;
+                num_unique += c;
+            }
+        }
 
-    if(t1.v[0].id < t2.v[0].id) return -1;
-    if(t1.v[0].id > t2.v[0].id) return  1;
-    return 0;
+        int j = counts[t];
+        for (int i = start; i < end; i++)
+            if (i == 0 || memcmp(src[i].v, src[i-1].v, sizeof(src[i].v)) != 0)
+                buf[j++] = src[i];
+    }
+
+    delete[] src;
+    delete[] counts;
+    *keys = buf;
+    return num_unique;
 }
 
 
-static inline void radix_sort(Triangle_inline *triangles, int num_triangles)
+static inline void set_triangle_key(Triangle_key *key, unsigned a, unsigned b, unsigned c, int index)
 {
-    PDASSERT(sizeof(Triangle_inline) > sizeof(void *)/2);
-    merge_sort(triangles, num_triangles, sizeof(Triangle_inline), compare_v2);
-    merge_sort(triangles, num_triangles, sizeof(Triangle_inline), compare_v1);
-    merge_sort(triangles, num_triangles, sizeof(Triangle_inline), compare_v0);
+    if (a > b) std::swap(a, b);
+    if (b > c) std::swap(b, c);
+    if (a > b) std::swap(a, b);
+    key->v[0]  = a;
+    key->v[1]  = b;
+    key->v[2]  = c;
+    key->index = index;
 }
 
 
@@ -110,20 +215,189 @@ void sort_points_in_triangle(Triangle_inline *triangles, int num_triangles)
 }
 
 
-inline void sort_points_in_triangle(Triangle_inline& triangle)
+/* sort triangles by vertex ids, which are made ascending in each triangle, and remove duplicates
+ * return the number of remaining triangles */
+int sort_triangles(Triangle_inline *triangles, int num_triangles)
 {
-    if(triangle.v[0].id > triangle.v[1].id) std::swap(triangle.v[0], triangle.v[1]);
-    if(triangle.v[1].id > triangle.v[2].id) std::swap(triangle.v[1], triangle.v[2]);
-    if(triangle.v[0].id > triangle.v[1].id) std::swap(triangle.v[0], triangle.v[1]);
+    if (num_triangles < 1)
+        return num_triangles;
+
+    int num_threads = num_triangles >= PDLN_MIN_PARALLEL_SORT_SIZE ? omp_get_max_threads() : 1;
+    Triangle_key *keys = new Triangle_key[num_triangles];
+
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num_triangles; i++)
+        set_triangle_key(&keys[i], triangles[i].v[0].id, triangles[i].v[1].id, triangles[i].v[2].id, i);
+
+    int num_unique = sort_triangle_keys(&keys, num_triangles, num_threads);
+
+    Triangle_inline *sorted = new Triangle_inline[num_unique];
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num_unique; i++) {
+        sorted[i] = triangles[keys[i].index];
+        sort_points_in_triangle(sorted[i]);
+    }
+    std::copy(sorted, sorted + num_unique, triangles);
+
+    delete[] sorted;
+    delete[] keys;
+    return num_unique;
+}
+
+
+/* the same as sort_triangles, for triangles given as vertex-id triplets */
+int sort_triangle_ids(int *ids, int num_triangles)
+{
+    if (num_triangles < 1)
+        return num_triangles;
+
+    int num_threads = num_triangles >= PDLN_MIN_PARALLEL_SORT_SIZE ? omp_get_max_threads() : 1;
+    Triangle_key *keys = new Triangle_key[num_triangles];
+
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num_triangles; i++)
+        set_triangle_key(&keys[i], ids[i*3], ids[i*3+1], ids[i*3+2], i);
+
+    int num_unique = sort_triangle_keys(&keys, num_triangles, num_threads);
+
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num_unique; i++)
+        for (int k = 0; k < 3; k++)
+            ids[i*3+k] = keys[i].v[k];
+
+    delete[] keys;
+    return num_unique;
+}
+
+
+/*
+ * Index of the cell containing (x, y, z) of [-1, 1]^3 along a 3D Hilbert curve
+ * of 2^PDLN_HILBERT_BITS cells per axis, following J. Skilling, "Programming
+ * the Hilbert curve", AIP Conf. Proc. 707, 2004.
+ */
+static unsigned long long calculate_hilbert_key(double x, double y, double z)
+{
+    const unsigned max_coord = (1u << PDLN_HILBERT_BITS) - 1;
+    double coord[3] = {x, y, z};
+    unsigned X[3];
+
+    for (int i = 0; i < 3; i++) {
+        double c = (coord[i] + 1.0) * 0.5 * max_coord;
+        X[i] = c <= 0 ? 0 : c >= max_coord ? max_coord : (unsigned)c;
+    }
+
+    /* inverse undo */
+    for (unsigned Q = 1u << (PDLN_HILBERT_BITS - 1); Q > 1; Q >>= 1) {
+        unsigned P = Q - 1;
+        for (int i = 0; i < 3; i++)
+            if (X[i] & Q)
+                X[0] ^= P;
+            else {
+                unsigned t = (X[0] ^ X[i]) & P;
+                X[0] ^= t;
+                X[i] ^= t;
+            }
+    }
+
+    /* gray encode */
+    X[1] ^= X[0];
+    X[2] ^= X[1];
+    unsigned t = 0;
+    for (unsigned Q = 1u << (PDLN_HILBERT_BITS - 1); Q > 1; Q >>= 1)
+        if (X[2] & Q)
+            t ^= Q - 1;
+    for (int i = 0; i < 3; i++)
+        X[i] ^= t;
+
+    unsigned long long key = 0;
+    for (int b = PDLN_HILBERT_BITS - 1; b >= 0; b--)
+        for (int i = 0; i < 3; i++)
+            key = (key << 1) | ((X[i] >> b) & 1);
+    return key;
 }
 
 
-void sort_triangles(Triangle_inline *triangles, int num_triangles)
+static inline void set_curve_key(Curve_key *key, double x, double y, double z, int index)
 {
-    radix_sort(triangles, num_triangles);
+    unsigned long long k = calculate_hilbert_key(x, y, z);
+    key->v[0]  = k >> 32;
+    key->v[1]  = k & 0xFFFFFFFFULL;
+    key->index = index;
 }
 
 
+/* stable LSD radix sort of curve keys, keys is replaced by the sorted keys */
+static void sort_curve_keys(Curve_key **keys, int num, int num_threads)
+{
+    Curve_key *src = *keys;
+    Curve_key *buf = new Curve_key[num];
+    int *counts = new int[num_threads * PDLN_RADIX_SIZE];
+
+    for (int word = 1; word >= 0; word--)
+        for (int shift = 0; shift < 32; shift += PDLN_RADIX_BITS)
+            if (radix_sort_pass(src, buf, num, word, shift, counts, num_threads))
+                std::swap(src, buf);
+
+    delete[] buf;
+    delete[] counts;
+    *keys = src;
+}
+
+
+/*
+ * Reorder triangles, given as vertex-id triplets, along the Hilbert curve of
+ * their centroids, xyz being the unit vectors of the grid points. Triangles
+ * of the same cell keep their order, so sorted inputs give reproducible outputs.
+ */
+void order_triangle_ids_by_hilbert_curve(int *ids, int num_triangles, double **xyz)
+{
+    if (num_triangles < 2)
+        return;
+
+    int num_threads = num_triangles >= PDLN_MIN_PARALLEL_SORT_SIZE ? omp_get_max_threads() : 1;
+    Curve_key *keys = new Curve_key[num_triangles];
+
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num_triangles; i++) {
+        int *v = ids + i*3;
+        set_curve_key(&keys[i], (xyz[0][v[0]] + xyz[0][v[1]] + xyz[0][v[2]]) / 3,
+                                (xyz[1][v[0]] + xyz[1][v[1]] + xyz[1][v[2]]) / 3,
+                                (xyz[2][v[0]] + xyz[2][v[1]] + xyz[2][v[2]]) / 3, i);
+    }
+
+    sort_curve_keys(&keys, num_triangles, num_threads);
+
+    int *sorted = new int[num_triangles * 3];
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num_triangles; i++)
+        memcpy(sorted + i*3, ids + keys[i].index*3, sizeof(int) * 3);
+    memcpy(ids, sorted, sizeof(int) * 3 * num_triangles);
+
+    delete[] sorted;
+    delete[] keys;
+}
+
+
+/* order[i]: the point at position i along the Hilbert curve of the unit vectors xyz */
+void order_points_by_hilbert_curve(double **xyz, int num_points, int *order)
+{
+    int num_threads = num_points >= PDLN_MIN_PARALLEL_SORT_SIZE ? omp_get_max_threads() : 1;
+    Curve_key *keys = new Curve_key[num_points];
+
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num_points; i++)
+        set_curve_key(&keys[i], xyz[0][i], xyz[1][i], xyz[2][i], i);
+
+    if (num_points > 1)
+        sort_curve_keys(&keys, num_points, num_threads);
+
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num_points; i++)
+        order[i] = keys[i].index;
+
+    delete[] keys;
+}
+
 Point::Point()
 {
 }
@@ -345,6 +619,14 @@ int Delaunay_Voronoi::get_lowest_point_of_four(const Edge* shared_edge)
     points[2] = &all_points[shared_edge->tail];
     points[3] = &all_points[shared_edge->twin_edge->prev_edge_in_triangle->head];
 
+    if (tie_break_by_index) {
+        int lowest = 0;
+        for (int i = 1; i < 4; i++)
+            if (global_index[points[i]->id] < global_index[points[lowest]->id])
+                lowest = i;
+        return get_index_in_array(points[lowest]);
+    }
+
     double x_fixed[4], y_fixed[4];
 
     for (int i = 0; i < 4; i++) {
@@ -1319,6 +1601,7 @@ Delaunay_Voronoi::Delaunay_Voronoi()
     , is_regional(false)
     , polar_mode(false)
     , fast_mode(false)
+    , tie_break_by_index(false)
     , tolerance(1e-9)
     , num_points(0)
     , vpolar_local_index(-1)
@@ -1954,125 +2237,145 @@ void Delaunay_Voronoi::set_checksum_bound(double min_x, double max_x, double min
 }
 
 
-static inline unsigned long long hash_two_double(double a, double b)
+/* coordinate bits of a point, v[0] is the high word, so that identical points sort together */
+struct Point_key {
+    unsigned v[4];
+    int      index;
+};
+
+
+static inline void set_point_key(Point_key *key, double x, double y, int index)
 {
-    unsigned long long *aa = reinterpret_cast<unsigned long long*>(&a);
-    unsigned long long *bb = reinterpret_cast<unsigned long long*>(&b);
-    return (*aa > 1) ^ *bb;
+    unsigned long long bits[2];
+
+    /* -0.0 equals 0.0 */
+    x = x == 0 ? 0 : x;
+    y = y == 0 ? 0 : y;
+    memcpy(&bits[0], &x, sizeof(double));
+    memcpy(&bits[1], &y, sizeof(double));
+    key->v[0]  = bits[0] >> 32;
+    key->v[1]  = bits[0];
+    key->v[2]  = bits[1] >> 32;
+    key->v[3]  = bits[1];
+    key->index = index;
+}
+
+
+/*
+ * Find points with the same coordinates by radix sorting their bit patterns
+ * and scanning adjacent keys. first[i] is set to the smallest index of the
+ * points identical to point i, i itself if there is none.
+ * return the number of points that repeat an earlier one.
+ */
+static int find_redundent_points(const double *x, const double *y, int num, int *first)
+{
+    int num_threads = num >= PDLN_MIN_PARALLEL_SORT_SIZE ? omp_get_max_threads() : 1;
+    Point_key *src = new Point_key[num];
+    Point_key *buf = new Point_key[num];
+    int *counts = new int[num_threads * PDLN_RADIX_SIZE];
+
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num; i++)
+        set_point_key(&src[i], x[i], y[i], i);
+
+    for (int word = 3; word >= 0; word--)
+        for (int shift = 0; shift < 32; shift += PDLN_RADIX_BITS)
+            if (radix_sort_pass(src, buf, num, word, shift, counts, num_threads))
+                std::swap(src, buf);
+
+    /* the sort is stable, so the first key of a run has the smallest index;
+     * coordinates are compared again as NaN equals nothing. Heads of runs are
+     * flagged, then carried forward to the rest of their runs */
+    int *head = new int[num];
+    #pragma omp parallel for num_threads(num_threads)
+    for (int i = 0; i < num; i++)
+        head[i] = i > 0 && x[src[i-1].index] == x[src[i].index] && y[src[i-1].index] == y[src[i].index] ? -1 : i;
+    for (int i = 1; i < num; i++)
+        if (head[i] < 0)
+            head[i] = head[i-1];
+
+    int num_redundent = 0;
+    #pragma omp parallel for num_threads(num_threads) reduction(+:num_redundent)
+    for (int i = 0; i < num; i++) {
+        first[src[i].index] = src[head[i]].index;
+        num_redundent += head[i] != i;
+    }
+
+    delete[] src;
+    delete[] buf;
+    delete[] counts;
+    delete[] head;
+    return num_redundent;
 }
 
 
 bool have_redundent_points(const double *x, const double *y, int num)
 {
-    std::tr1::unordered_map<unsigned long long, std::list<int> > hash_table;
-    std::tr1::unordered_map<unsigned long long, std::list<int> >::iterator it_hash;
-
     if(num == 0)
         return false;
 
-    bool have_redundent = false;
-    for(int i = 0; i < num; i++) {
-        it_hash = hash_table.find(hash_two_double(x[i], y[i]));
-        if(it_hash != hash_table.end()) {
-            bool same = false;
-            for(std::list<int>::iterator it_list = it_hash->second.begin(); it_list != it_hash->second.end(); it_list ++)
-                if(x[*it_list] == x[i] && y[*it_list] == y[i]) {
-                    same = true;
-                    break;
-                }
-            if(same){
-                printf("redundent_point: %.20lf, %.20lf\n", x[i], y[i]);
-                have_redundent = true;
-            }
-            else {
-                it_hash->second.push_back(i);
-            }
-        }
-        else {
-            hash_table[hash_two_double(x[i], y[i])].push_back(i);
-        }
-    }
+    int *first = new int[num];
+    bool have_redundent = find_redundent_points(x, y, num, first) > 0;
 
-    if(have_redundent)
-        return true;
+    if (have_redundent)
+        for (int i = 0; i < num; i++)
+            if (first[i] != i)
+                printf("redundent_point: %.20lf, %.20lf\n", x[i], y[i]);
 
-    return false;
+    delete[] first;
+    return have_redundent;
 }
 
 
 void report_redundent_points(const double *x, const double *y, const int *index, int num)
 {
-    std::tr1::unordered_map<unsigned long long, std::list<int> > hash_table;
-    std::tr1::unordered_map<unsigned long long, std::list<int> >::iterator it_hash;
-
     if (num == 0)
         return;
 
-    bool have_redundent = false;
-    for (int i = 0; i < num; i++) {
-        it_hash = hash_table.find(hash_two_double(x[i], y[i]));
-        if (it_hash != hash_table.end()) {
-            bool same = false;
-            for (std::list<int>::iterator it_list = it_hash->second.begin(); it_list != it_hash->second.end(); it_list ++)
-                if (x[*it_list] == x[i] && y[*it_list] == y[i]) {
-                    same = true;
-                    have_redundent = true;
-                    printf("Point %d same as point %d: %.20lf, %.20lf\n", index[*it_list], index[i], x[i], y[i]);
-                    break;
-                }
-            if (!same)
-                it_hash->second.push_back(i);
-        } else {
-            hash_table[hash_two_double(x[i], y[i])].push_back(i);
-        }
-    }
+    int *first = new int[num];
+    if (find_redundent_points(x, y, num, first) > 0)
+        for (int i = 0; i < num; i++)
+            if (first[i] != i)
+                printf("Point %d same as point %d: %.20lf, %.20lf\n", index[first[i]], index[i], x[i], y[i]);
+
+    delete[] first;
 }
 
 
-int delete_redundent_points(double *&x, double *&y, int &num)
+/*
+ * keep the first one of identical points, x & y are reallocated if any point is deleted.
+ * kept, if given, receives the former indexes of the num points left.
+ */
+int delete_redundent_points(double *&x, double *&y, int &num, int *kept)
 {
-    std::tr1::unordered_map<double, std::list<int> > hash_table;
-    std::tr1::unordered_map<double, std::list<int> >::iterator it_hash;
-
-    double *tmp_x, *tmp_y;
-    int count = 0;
-    int old_num = num;
-
     if(num == 0)
         return 0;
 
-    tmp_x = new double[num];
-    tmp_y = new double[num];
+    int *first = new int[num];
+    if (find_redundent_points(x, y, num, first) == 0) {
+        delete[] first;
+        return 0;
+    }
 
-    for(int i = 0; i < num; i++) {
-        it_hash = hash_table.find(x[i] * 1000.0 + y[i]);
-        if(it_hash != hash_table.end()) {
-            bool same = false;
-            for(std::list<int>::iterator it_list = it_hash->second.begin(); it_list != it_hash->second.end(); it_list ++)
-                if(x[*it_list] == x[i] && y[*it_list] == y[i]) {
-                    same = true;
-                    break;
-                }
-            if(same)
-                continue;
-            else {
-                it_hash->second.push_back(i);
-                tmp_x[count] = x[i];
-                tmp_y[count++] = y[i];
-            }
-        }
-        else {
-            hash_table[x[i] * 1000.0 + y[i]].push_back(i);
+    double *tmp_x = new double[num];
+    double *tmp_y = new double[num];
+    int count = 0;
+
+    for(int i = 0; i < num; i++)
+        if (first[i] == i) {
+            if (kept)
+                kept[count] = i;
             tmp_x[count] = x[i];
             tmp_y[count++] = y[i];
         }
-    }
 
-    delete x;
-    delete y;
+    delete[] first;
+    delete[] x;
+    delete[] y;
     x = tmp_x;
     y = tmp_y;
 
+    int old_num = num;
     num = count;
 
     return old_num - num;
@@ -2422,6 +2725,42 @@ void Delaunay_Voronoi::get_triangles_in_region(double min_x, double max_x, doubl
 }
 
 
+/*
+ * Triangles whose vertex of the lowest global index is one of the first num_owned
+ * points, i.e. the kernel points of the leaf. As kernels never overlap, every
+ * triangle is got from exactly one leaf, and copies of kernel points shifted
+ * across the cyclic boundary do not make duplicates.
+ */
+void Delaunay_Voronoi::get_owned_triangles(int num_owned, Triangle_inline *output_triangles, int *output_num_triangles, int buf_len)
+{
+    int current = 0;
+
+    for(unsigned i = 0; i < all_leaf_triangles.size(); i++) {
+        if(!all_leaf_triangles[i]->is_leaf || all_leaf_triangles[i]->is_virtual)
+            continue;
+
+        int* v_idx = all_leaf_triangles[i]->v;
+        int  lowest = 0;
+        for(int j = 1; j < 3; j++)
+            if(global_index[all_points[v_idx[j]].id] < global_index[all_points[v_idx[lowest]].id])
+                lowest = j;
+
+        if(all_points[v_idx[lowest]].id >= num_owned)
+            continue;
+
+        PDASSERT(current < buf_len);
+        Point v[3];
+        for(int j = 0; j < 3; j++) {
+            int id = all_points[v_idx[j]].id;
+            v[j] = x_ref ? Point(x_ref[id], y_ref[id], global_index[id]) : Point(all_points[v_idx[j]].x, all_points[v_idx[j]].y, global_index[id]);
+        }
+        output_triangles[current++] = Triangle_inline(v[0], v[1], v[2]);
+    }
+
+    *output_num_triangles = current;
+}
+
+
 void Delaunay_Voronoi::set_polar_mode(bool mode)
 {
     polar_mode = mode;
@@ -2434,6 +2773,13 @@ void Delaunay_Voronoi::set_regional(bool mode)
 }
 
 
+/* pick the diagonal of cocircular quadrilaterals by global indexes instead of reference coordinates */
+void Delaunay_Voronoi::set_tie_break_by_index(bool mode)
+{
+    tie_break_by_index = mode;
+}
+
+
 void Delaunay_Voronoi::make_bounding_triangle_pack()
 {
     bound_triangles[PDLN_DOWN].clear();
@@ -36,11 +36,14 @@ using std::vector;
 using std::pair;
 
 void sort_points_in_triangle(Triangle_inline*, int);
-void sort_triangles(Triangle_inline*, int);
+int  sort_triangles(Triangle_inline*, int);
+int  sort_triangle_ids(int*, int);
+void order_triangle_ids_by_hilbert_curve(int*, int, double**);
+void order_points_by_hilbert_curve(double**, int, int*);
 
 bool have_redundent_points(const double*, const double*, int);
 void report_redundent_points(const double *, const double *, const int *, int);
-int  delete_redundent_points(double *&x, double *&y, int &num);
+int  delete_redundent_points(double *&x, double *&y, int &num, int *kept = NULL);
 
 struct Bound;
 
@@ -59,11 +62,13 @@ class Delaunay_Voronoi
         void set_checksum_bound(double, double, double, double, double);
         void set_polar_mode(bool);
         void set_regional(bool);
+        void set_tie_break_by_index(bool);
         void set_tolerance(double t) {tolerance = t; };
         void set_original_center_lon(double);
 
         bool is_all_leaf_triangle_legal();
         void get_triangles_in_region(double, double, double, double, Triangle_inline *, int *, int);
+        void get_owned_triangles(int, Triangle_inline *, int *, int);
         void update_all_points_coord(double *, double *, int);
         void remove_triangles_on_or_out_of_boundary(double, double, double, double);
 
@@ -179,6 +184,7 @@ class Delaunay_Voronoi
         bool   is_regional;
         bool   polar_mode;
         bool   fast_mode;
+        bool   tie_break_by_index;
         double tolerance;
 
         /* Grid info */
@@ -0,0 +1,39 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+/*
+ * Convert a grid file of the text format into the binary grid format of
+ * src/grid_file.h, which patcc maps into memory instead of parsing.
+ *
+ * usage: grid2binary textGridFile binaryGridFile
+ */
+#include "grid_file.h"
+#include <cstdio>
+
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s textGridFile binaryGridFile\n", argv[0]);
+        return 1;
+    }
+
+    Grid_input grid;
+    if (read_grid_text(argv[1], &grid) != 0) {
+        fprintf(stderr, "%s is not a valid grid file\n", argv[1]);
+        return 1;
+    }
+
+    int ret = write_grid_binary(argv[2], &grid);
+    if (ret != 0)
+        fprintf(stderr, "can not write %s\n", argv[2]);
+
+    free_grid_input(&grid);
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+/*
+ * Convert log/global_triangles_<n>.bin, written by PAT_BINARY_OUTPUT builds,
+ * into the text format of log/global_triangles_<n>: "id0, id1, id2" per line.
+ * With -s, ids of each triangle and the triangles are sorted as the text output
+ * of sorted merging, so both can be compared directly.
+ *
+ * usage: triangles2text [-s] binaryFile [textFile]
+ */
+#include "mesh_file.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+
+struct Id_triplet {
+    long long v[3];
+};
+
+
+static bool triplet_less(const Id_triplet &a, const Id_triplet &b)
+{
+    if (a.v[0] != b.v[0])
+        return a.v[0] < b.v[0];
+    if (a.v[1] != b.v[1])
+        return a.v[1] < b.v[1];
+    return a.v[2] < b.v[2];
+}
+
+
+static void sort_triplet(Id_triplet &t)
+{
+    if (t.v[0] > t.v[1]) std::swap(t.v[0], t.v[1]);
+    if (t.v[1] > t.v[2]) std::swap(t.v[1], t.v[2]);
+    if (t.v[0] > t.v[1]) std::swap(t.v[0], t.v[1]);
+}
+
+
+template <typename T>
+static void convert(const Mesh_span<T> &ids, bool sort, bool sorted, FILE *out)
+{
+    size_t num = ids.size / 3;
+
+    if (!sort || sorted) {
+        for (size_t i = 0; i < num; i++)
+            fprintf(out, "%lld, %lld, %lld\n", (long long)ids[i*3], (long long)ids[i*3+1], (long long)ids[i*3+2]);
+        return;
+    }
+
+    std::vector<Id_triplet> all(num);
+    for (size_t i = 0; i < num; i++) {
+        for (int k = 0; k < 3; k++)
+            all[i].v[k] = ids[i*3+k];
+        sort_triplet(all[i]);
+    }
+    std::sort(all.begin(), all.end(), triplet_less);
+    for (size_t i = 0; i < num; i++)
+        fprintf(out, "%lld, %lld, %lld\n", all[i].v[0], all[i].v[1], all[i].v[2]);
+}
+
+
+int main(int argc, char **argv)
+{
+    bool sort = argc > 1 && strcmp(argv[1], "-s") == 0;
+    int  arg  = sort ? 2 : 1;
+
+    if (argc - arg < 1 || argc - arg > 2) {
+        fprintf(stderr, "usage: %s [-s] binaryFile [textFile]\n", argv[0]);
+        return 1;
+    }
+
+    Mesh_file_reader reader;
+    if (reader.open(argv[arg]) != 0) {
+        fprintf(stderr, "%s is not a valid mesh file\n", argv[arg]);
+        return 1;
+    }
+
+    FILE *out = argc - arg == 2 ? fopen(argv[arg+1], "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "can not open %s\n", argv[arg+1]);
+        return 1;
+    }
+
+    bool sorted = reader.get_header()->ordering == PDLN_MESH_ORDER_IDS;
+    if (reader.get_header()->index_width == sizeof(int))
+        convert(reader.get_triangles<int>(), sort, sorted, out);
+    else
+        convert(reader.get_triangles<long long>(), sort, sorted, out);
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,575 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+/*
+ * Check a finished triangulation against its grid in parallel:
+ *   coverage       every grid point is a vertex; meshes of global grids have no
+ *                  boundary and their triangles add up to the area of the sphere
+ *   manifoldness   no degenerated triangle, no edge shared by more than two triangles
+ *   euler          V - E + F = 2 - number of boundary loops
+ *   delaunay       no vertex strictly inside the circumcircle of the triangle
+ *                  on the other side of each edge, on the sphere, or in the
+ *                  lon/lat plane with -l (for regional grids triangulated there)
+ *
+ * Triangles are read from log/global_triangles_<n> or log/global_triangles_<n>.bin,
+ * each process taking a part of the file. Edges are hashed to processes, so
+ * that both triangles of an edge meet on one process. Points added by PatCC,
+ * such as virtual poles, are not in the grid file: quadrilaterals with such
+ * points are only checked for their topology. Grid points at the same place
+ * on the sphere, such as the pole rows of lat-lon grids, make triangles of no
+ * area: these triangles and the quadrilaterals with such points are counted
+ * apart instead of being checked for delaunay.
+ *
+ * usage: mpiexec -n np ./verify_triangulation [-l] [-t tolerance] gridFile triangleFile
+ * return 0 if all checks pass.
+ */
+#include "mpi.h"
+#include "mesh_file.h"
+#include "mesh_adjacency.h"
+#include "grid_file.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PDLN_DEFAULT_VERIFY_TOLERANCE   (1e-6)
+#define PDLN_AREA_TOLERANCE             (1e-6)
+#define PDLN_COINCIDENT_TOLERANCE       (1e-12)
+#define PDLN_DEGREE_TO_RADIAN           (M_PI/180.0)
+
+
+/* an edge v[0] < v[1] of a triangle, whose third vertex is opposite */
+struct Edge_check {
+    int v[2];
+    int opposite;
+};
+
+
+static inline bool operator < (const Edge_check &e1, const Edge_check &e2)
+{
+    if (e1.v[0] != e2.v[0])
+        return e1.v[0] < e2.v[0];
+    if (e1.v[1] != e2.v[1])
+        return e1.v[1] < e2.v[1];
+    return e1.opposite < e2.opposite;
+}
+
+
+static inline int edge_owner(int v0, int v1, int num_procs)
+{
+    unsigned long long key = ((unsigned long long)(unsigned)v0 << 32) | (unsigned)v1;
+    return (int)(((key * 0x9E3779B97F4A7C15ULL) >> 32) % num_procs);
+}
+
+
+struct Grid_points {
+    int                 num;
+    bool                is_global;          /* the boundary of the grid file covers the sphere */
+    std::vector<double> lon, lat;
+    std::vector<double> xyz[3];
+    std::vector<int>    same_as;            /* the smallest id of the points at the place of each point */
+    int                 num_coincident;     /* points at the place of a point with a smaller id */
+};
+
+
+struct Point_key {
+    long long k[3];
+    int       id;
+};
+
+
+static inline bool operator < (const Point_key &p1, const Point_key &p2)
+{
+    for (int k = 0; k < 3; k++)
+        if (p1.k[k] != p2.k[k])
+            return p1.k[k] < p2.k[k];
+    return p1.id < p2.id;
+}
+
+
+/*
+ * Points whose unit vectors round to the same multiples of
+ * PDLN_COINCIDENT_TOLERANCE are at the same place, such as the points of a
+ * pole row, which only differ in longitude.
+ */
+static void find_coincident_points(Grid_points *grid)
+{
+    std::vector<Point_key> keys(grid->num);
+    #pragma omp parallel for
+    for (int i = 0; i < grid->num; i++) {
+        for (int k = 0; k < 3; k++)
+            keys[i].k[k] = llround(grid->xyz[k][i] / PDLN_COINCIDENT_TOLERANCE);
+        keys[i].id = i;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    grid->same_as.resize(grid->num);
+    grid->num_coincident = 0;
+    for (int i = 0; i < grid->num; i++) {
+        bool same = i > 0 && std::equal(keys[i].k, keys[i].k + 3, keys[i-1].k);
+        grid->same_as[keys[i].id] = same ? grid->same_as[keys[i-1].id] : keys[i].id;
+        grid->num_coincident += same;
+    }
+}
+
+
+/* whether two of the n points are at the same place, points out of the grid file are at their own */
+static bool have_coincident_points(const Grid_points &grid, const int *v, int n)
+{
+    int p[4];
+    for (int i = 0; i < n; i++)
+        p[i] = v[i] < grid.num ? grid.same_as[v[i]] : v[i];
+    for (int i = 0; i < n; i++)
+        for (int j = i + 1; j < n; j++)
+            if (p[i] == p[j])
+                return true;
+    return false;
+}
+
+
+/* the points of a grid file of patcc in either format, read by process 0 and broadcast; return 0 on success */
+static int read_grid(MPI_Comm comm, const char *filename, Grid_points *grid)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    grid->num       = -1;
+    grid->is_global = false;
+    if (rank == 0) {
+        Grid_input input;
+        if (read_grid_file(filename, &input) == 0) {
+            const double *bound = input.boundary;
+            grid->num       = input.num_points;
+            grid->is_global = fabs(bound[1] - bound[0] - 360) < 1e-6 && bound[2] <= -90 && bound[3] >= 90;
+            grid->lon.assign(input.lon, input.lon + input.num_points);
+            grid->lat.assign(input.lat, input.lat + input.num_points);
+            free_grid_input(&input);
+        }
+    }
+
+    MPI_Bcast(&grid->num, 1, MPI_INT, 0, comm);
+    if (grid->num < 0)
+        return -1;
+    int is_global = grid->is_global;
+    MPI_Bcast(&is_global, 1, MPI_INT, 0, comm);
+    grid->is_global = is_global;
+
+    grid->lon.resize(grid->num);
+    grid->lat.resize(grid->num);
+    MPI_Bcast(&grid->lon[0], grid->num, MPI_DOUBLE, 0, comm);
+    MPI_Bcast(&grid->lat[0], grid->num, MPI_DOUBLE, 0, comm);
+
+    for (int k = 0; k < 3; k++)
+        grid->xyz[k].resize(grid->num);
+    #pragma omp parallel for
+    for (int i = 0; i < grid->num; i++) {
+        double lon = grid->lon[i] * PDLN_DEGREE_TO_RADIAN;
+        double lat = grid->lat[i] * PDLN_DEGREE_TO_RADIAN;
+        grid->xyz[0][i] = cos(lat) * sin(lon);
+        grid->xyz[1][i] = sin(lat);
+        grid->xyz[2][i] = cos(lat) * cos(lon);
+    }
+    find_coincident_points(grid);
+    return 0;
+}
+
+
+/* parse the next integer of the line at *p, skipping separators; return false at the end of the line */
+static bool parse_int(const char **p, const char *end, int *value)
+{
+    const char *c = *p;
+    while (c < end && (*c == ' ' || *c == ',' || *c == '\t'))
+        c++;
+
+    bool negative = c < end && *c == '-';
+    if (negative)
+        c++;
+    if (c >= end || *c < '0' || *c > '9') {
+        *p = c;
+        return false;
+    }
+
+    long long v = 0;
+    while (c < end && *c >= '0' && *c <= '9')
+        v = v * 10 + (*c++ - '0');
+    *value = negative ? -v : v;
+    *p = c;
+    return true;
+}
+
+
+/*
+ * The part of the triangles of this process, as vertex-id triplets: a range of
+ * triangles of a mesh file, or a range of lines of a text file.
+ * return 0 on success.
+ */
+static int read_triangles(MPI_Comm comm, const char *filename, std::vector<int> &ids)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    Mesh_file_reader reader;
+    if (reader.open(filename) == 0) {
+        unsigned long long num = reader.get_header()->num_triangles;
+        unsigned long long start = num * rank / num_procs;
+        unsigned long long end   = num * (rank + 1) / num_procs;
+        ids.resize((end - start) * 3);
+        if (reader.get_header()->index_width == sizeof(int)) {
+            Mesh_span<int> all = reader.get_triangles<int>();
+            for (unsigned long long i = start * 3; i < end * 3; i++)
+                ids[i - start * 3] = all[i];
+        } else {
+            Mesh_span<long long> all = reader.get_triangles<long long>();
+            for (unsigned long long i = start * 3; i < end * 3; i++)
+                ids[i - start * 3] = all[i];
+        }
+        return 0;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t length = st.st_size;
+    if (length == 0) {
+        close(fd);
+        return 0;
+    }
+    const char *text = (const char*)mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED)
+        return -1;
+
+    /* lines starting in [start, end) */
+    size_t start = length * rank / num_procs;
+    size_t end   = length * (rank + 1) / num_procs;
+    if (start > 0)
+        while (start < length && text[start-1] != '\n')
+            start++;
+
+    const char *p = text + start;
+    while (p < text + end) {
+        int v[3], k;
+        for (k = 0; k < 3 && parse_int(&p, text + length, &v[k]); k++);
+        if (k == 3)
+            ids.insert(ids.end(), v, v + 3);
+        while (p < text + length && *p++ != '\n');
+    }
+
+    munmap((void*)text, length);
+    return 0;
+}
+
+
+/*
+ * How deep d lies inside the circumcircle of a, b and c, relative to the size
+ * of the circle, negative if outside.
+ */
+static double sphere_incircle(const Grid_points &grid, int a, int b, int c, int d)
+{
+    double p[4][3];
+    int id[4] = {a, b, c, d};
+    for (int i = 0; i < 4; i++)
+        for (int k = 0; k < 3; k++)
+            p[i][k] = grid.xyz[k][id[i]];
+
+    double u[3], v[3], n[3];
+    for (int k = 0; k < 3; k++) {
+        u[k] = p[1][k] - p[0][k];
+        v[k] = p[2][k] - p[0][k];
+    }
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+    double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    if (len == 0)
+        return 0;
+
+    /* the circle is cut from the sphere by the plane n.x = h, cap height 1 - h */
+    double h = (n[0]*p[0][0] + n[1]*p[0][1] + n[2]*p[0][2]) / len;
+    double s = h < 0 ? -1 : 1;
+    double depth = s * (n[0]*p[3][0] + n[1]*p[3][1] + n[2]*p[3][2]) / len - s * h;
+    return depth / (1 - s * h);
+}
+
+
+static double plane_incircle(const Grid_points &grid, int a, int b, int c, int d)
+{
+    double ax = grid.lon[a], ay = grid.lat[a];
+    double bx = grid.lon[b] - ax, by = grid.lat[b] - ay;
+    double cx = grid.lon[c] - ax, cy = grid.lat[c] - ay;
+    double dx = grid.lon[d] - ax, dy = grid.lat[d] - ay;
+
+    double det = 2 * (bx * cy - by * cx);
+    if (det == 0)
+        return 0;
+    double ox = (cy * (bx*bx + by*by) - by * (cx*cx + cy*cy)) / det;
+    double oy = (bx * (cx*cx + cy*cy) - cx * (bx*bx + by*by)) / det;
+    double r = sqrt(ox*ox + oy*oy);
+    return (r - sqrt((dx-ox)*(dx-ox) + (dy-oy)*(dy-oy))) / r;
+}
+
+
+/* area of a spherical triangle, A. van Oosterom and J. Strackee, 1983 */
+static double spherical_area(const Grid_points &grid, int a, int b, int c)
+{
+    double p[3][3];
+    int id[3] = {a, b, c};
+    for (int i = 0; i < 3; i++)
+        for (int k = 0; k < 3; k++)
+            p[i][k] = grid.xyz[k][id[i]];
+
+    double triple = p[0][0] * (p[1][1]*p[2][2] - p[1][2]*p[2][1]) -
+                    p[0][1] * (p[1][0]*p[2][2] - p[1][2]*p[2][0]) +
+                    p[0][2] * (p[1][0]*p[2][1] - p[1][1]*p[2][0]);
+    double ab = p[0][0]*p[1][0] + p[0][1]*p[1][1] + p[0][2]*p[1][2];
+    double bc = p[1][0]*p[2][0] + p[1][1]*p[2][1] + p[1][2]*p[2][2];
+    double ca = p[2][0]*p[0][0] + p[2][1]*p[0][1] + p[2][2]*p[0][2];
+    return 2 * atan2(fabs(triple), 1 + ab + bc + ca);
+}
+
+
+static int find_root(std::vector<int> &parent, int i)
+{
+    while (parent[i] != i)
+        i = parent[i] = parent[parent[i]];
+    return i;
+}
+
+
+/* number of loops formed by the boundary edges, gathered on process 0 */
+static int count_boundary_loops(MPI_Comm comm, const std::vector<int> &boundary)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    int num = boundary.size();
+    std::vector<int> counts(num_procs), displs(num_procs + 1, 0);
+    MPI_Gather(&num, 1, MPI_INT, &counts[0], 1, MPI_INT, 0, comm);
+    for (int i = 0; i < num_procs; i++)
+        displs[i+1] = displs[i] + counts[i];
+
+    std::vector<int> all(rank == 0 ? displs[num_procs] : 0);
+    MPI_Gatherv(boundary.empty() ? NULL : (void*)&boundary[0], num, MPI_INT, all.empty() ? NULL : &all[0],
+                &counts[0], &displs[0], MPI_INT, 0, comm);
+    if (rank != 0 || all.empty())
+        return 0;
+
+    std::vector<int> vertices(all);
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+    std::vector<int> parent(vertices.size());
+    for (size_t i = 0; i < parent.size(); i++)
+        parent[i] = i;
+    for (size_t i = 0; i < all.size(); i += 2) {
+        int r0 = find_root(parent, std::lower_bound(vertices.begin(), vertices.end(), all[i]) - vertices.begin());
+        int r1 = find_root(parent, std::lower_bound(vertices.begin(), vertices.end(), all[i+1]) - vertices.begin());
+        parent[r0] = r1;
+    }
+
+    int num_loops = 0;
+    for (size_t i = 0; i < parent.size(); i++)
+        num_loops += find_root(parent, i) == (int)i;
+    return num_loops;
+}
+
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    bool lonlat_plane = false;
+    double tolerance = PDLN_DEFAULT_VERIFY_TOLERANCE;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+        if (strcmp(argv[arg], "-l") == 0)
+            lonlat_plane = true;
+        else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc)
+            tolerance = atof(argv[++arg]);
+        else
+            break;
+
+    if (argc - arg != 2) {
+        if (rank == 0)
+            fprintf(stderr, "usage: %s [-l] [-t tolerance] gridFile triangleFile\n", argv[0]);
+        MPI_Finalize();
+        return 2;
+    }
+
+    double time_start = MPI_Wtime();
+
+    Grid_points grid;
+    std::vector<int> ids;
+    int ret = read_grid(comm, argv[arg], &grid) == 0 ? 0 : 1;
+    if (ret == 0 && read_triangles(comm, argv[arg+1], ids) != 0)
+        ret = 1;
+    int all_ret;
+    MPI_Allreduce(&ret, &all_ret, 1, MPI_INT, MPI_MAX, comm);
+    if (all_ret) {
+        if (rank == 0)
+            fprintf(stderr, "failed in reading %s or %s\n", argv[arg], argv[arg+1]);
+        MPI_Finalize();
+        return 2;
+    }
+
+    long long num_triangles = ids.size() / 3;
+    long long num_degenerated = 0;
+    int max_id = -1;
+    double area = 0;
+    long long num_unknown_triangles = 0;
+    long long num_coincident_triangles = 0;
+
+    std::vector<Edge_check> edges;
+    std::vector<int> dest;
+    edges.reserve(ids.size());
+    dest.reserve(ids.size());
+    for (long long i = 0; i < num_triangles; i++) {
+        int *v = &ids[i*3];
+        if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2] || v[0] < 0 || v[1] < 0 || v[2] < 0) {
+            num_degenerated++;
+            continue;
+        }
+        max_id = std::max(max_id, std::max(v[0], std::max(v[1], v[2])));
+        num_coincident_triangles += have_coincident_points(grid, v, 3);
+        if (v[0] < grid.num && v[1] < grid.num && v[2] < grid.num)
+            area += spherical_area(grid, v[0], v[1], v[2]);
+        else
+            num_unknown_triangles++;
+
+        for (int k = 0; k < 3; k++) {
+            Edge_check e;
+            e.v[0]     = std::min(v[(k+1)%3], v[(k+2)%3]);
+            e.v[1]     = std::max(v[(k+1)%3], v[(k+2)%3]);
+            e.opposite = v[k];
+            edges.push_back(e);
+            dest.push_back(edge_owner(e.v[0], e.v[1], num_procs));
+        }
+    }
+
+    std::vector<Edge_check> recv_edges;
+    exchange_records(comm, edges, dest, recv_edges);
+    std::vector<Edge_check>().swap(edges);
+    std::sort(recv_edges.begin(), recv_edges.end());
+
+    long long num_edges = 0, num_nonmanifold = 0, num_violations = 0, num_unchecked = 0, num_coincident_edges = 0;
+    double max_violation = -HUGE_VAL;
+    std::vector<int> boundary;
+    for (size_t i = 0, j; i < recv_edges.size(); i = j) {
+        for (j = i + 1; j < recv_edges.size() && recv_edges[j].v[0] == recv_edges[i].v[0] &&
+                        recv_edges[j].v[1] == recv_edges[i].v[1]; j++);
+        num_edges++;
+
+        if (j - i == 1) {
+            boundary.push_back(recv_edges[i].v[0]);
+            boundary.push_back(recv_edges[i].v[1]);
+        } else if (j - i > 2 || recv_edges[i].opposite == recv_edges[i+1].opposite)
+            num_nonmanifold++;
+        else {
+            int a = recv_edges[i].v[0], b = recv_edges[i].v[1];
+            int c = recv_edges[i].opposite, d = recv_edges[i+1].opposite;
+            if (a >= grid.num || b >= grid.num || c >= grid.num || d >= grid.num) {
+                num_unchecked++;
+                continue;
+            }
+            int quadrilateral[4] = {a, b, c, d};
+            if (have_coincident_points(grid, quadrilateral, 4)) {
+                num_coincident_edges++;
+                continue;
+            }
+            double violation = lonlat_plane ? plane_incircle(grid, a, b, c, d) : sphere_incircle(grid, a, b, c, d);
+            max_violation = std::max(max_violation, violation);
+            num_violations += violation > tolerance;
+        }
+    }
+    std::vector<Edge_check>().swap(recv_edges);
+
+    /* vertices are counted by the processes owning contiguous ranges of ids */
+    int num_ids;
+    MPI_Allreduce(&max_id, &num_ids, 1, MPI_INT, MPI_MAX, comm);
+    num_ids = std::max(num_ids + 1, grid.num);
+    std::vector<long long> id_starts(num_procs + 1);
+    for (int i = 0; i <= num_procs; i++)
+        id_starts[i] = (long long)num_ids * i / num_procs;
+
+    dest.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
+        dest[i] = ids[i] < 0 ? 0 : std::upper_bound(id_starts.begin(), id_starts.end(), (long long)ids[i]) - id_starts.begin() - 1;
+    std::vector<int> recv_ids;
+    exchange_records(comm, ids, dest, recv_ids);
+
+    std::vector<char> is_used(id_starts[rank+1] - id_starts[rank], 0);
+    for (size_t i = 0; i < recv_ids.size(); i++)
+        if (recv_ids[i] >= 0)
+            is_used[recv_ids[i] - id_starts[rank]] = 1;
+    long long num_vertices = 0, num_uncovered = 0;
+    for (long long i = 0; i < (long long)is_used.size(); i++) {
+        num_vertices += is_used[i];
+        num_uncovered += !is_used[i] && id_starts[rank] + i < grid.num;
+    }
+
+    long long local[11] = {num_triangles, num_degenerated, num_edges, num_nonmanifold, num_violations,
+                           num_unchecked, num_vertices, num_uncovered, num_unknown_triangles,
+                           num_coincident_triangles, num_coincident_edges};
+    long long global[11];
+    MPI_Reduce(local, global, 11, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    double all_area, all_max_violation;
+    MPI_Reduce(&area, &all_area, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(&max_violation, &all_max_violation, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    int num_loops = count_boundary_loops(comm, boundary);
+
+    ret = 0;
+    if (rank == 0) {
+        long long euler = global[6] - global[2] + global[0];
+        bool check_area = grid.is_global && global[8] == 0;
+        bool coverage_ok = global[7] == 0 && (!grid.is_global || num_loops == 0);
+        if (check_area && fabs(all_area - 4 * M_PI) > PDLN_AREA_TOLERANCE * 4 * M_PI)
+            coverage_ok = false;
+        bool manifold_ok = global[1] == 0 && global[3] == 0;
+        bool euler_ok = euler == 2 - num_loops;
+        bool delaunay_ok = global[4] == 0;
+
+        printf("triangles %lld, edges %lld, vertices %lld, boundary loops %d\n", global[0], global[2], global[6], num_loops);
+        printf("coverage:     %s, %lld grid points are not vertices", coverage_ok ? "ok" : "FAILED", global[7]);
+        if (grid.is_global)
+            printf(", %d holes in the global grid", num_loops);
+        if (check_area)
+            printf(", area %.12f of %.12f", all_area, 4 * M_PI);
+        printf("\n");
+        printf("manifoldness: %s, %lld degenerated triangles, %lld edges with more than two triangles\n",
+               manifold_ok ? "ok" : "FAILED", global[1], global[3]);
+        printf("euler:        %s, V - E + F = %lld, expecting %d\n", euler_ok ? "ok" : "FAILED", euler, 2 - num_loops);
+        printf("delaunay:     %s, %lld edges beyond tolerance %g, max relative violation %g, %lld edges with points out of the grid file\n",
+               delaunay_ok ? "ok" : "FAILED", global[4], tolerance, all_max_violation, global[5]);
+        printf("coincident:   %d grid points at the place of others, %lld triangles and %lld edges with them not checked for delaunay\n",
+               grid.num_coincident, global[9], global[10]);
+        printf("verified in %.3f seconds by %d processes\n", MPI_Wtime() - time_start, num_procs);
+        ret = coverage_ok && manifold_ok && euler_ok && delaunay_ok ? 0 : 1;
+    }
+
+    MPI_Bcast(&ret, 1, MPI_INT, 0, comm);
+    MPI_Finalize();
+    return ret;
+}
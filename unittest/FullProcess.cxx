@@ -18,6 +18,11 @@
 #include "projection.h"
 
 #include <cmath>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+#include <omp.h>
 #define CHECK_PARALLEL_CONSISTENCY (true)
 
 #define ROUND_VALUE (10000000.0)
@@ -430,6 +435,191 @@ TEST_F(FullProcess, Basic) {
 };
 
 
+typedef std::pair<int, std::pair<int, int> > Triangle_key;
+
+static Triangle_key make_triangle_key(const int *v)
+{
+    int s[3] = {v[0], v[1], v[2]};
+    std::sort(s, s+3);
+    return Triangle_key(s[0], std::pair<int, int>(s[1], s[2]));
+}
+
+
+/*
+ * Check the layers of mesh against the owned triangles of all processes:
+ * layer 0 is the triangles of this process, and all of them together are the
+ * merged triangulation; a ghost of layer k is owned by the process given, is
+ * in no lower layer and shares a vertex with layer k-1, and all triangles
+ * sharing a vertex with layer k-1 are in layers 0 to k.
+ */
+static void check_local_mesh(const Local_mesh &mesh, int num_ghost_layers)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    ASSERT_EQ((size_t)num_ghost_layers + 2, mesh.layer_offsets.size());
+    ASSERT_EQ(0, mesh.layer_offsets[0]);
+    ASSERT_EQ(mesh.owners.size() * 3, mesh.triangles.size());
+    ASSERT_EQ(mesh.owners.size(), (size_t)mesh.layer_offsets.back());
+
+    int num_owned = mesh.layer_offsets[1];
+    for (int i = 0; i < num_owned; i++)
+        EXPECT_EQ(rank, mesh.owners[i]);
+
+    std::vector<int> counts(num_procs), displs(num_procs+1, 0);
+    int num_owned_ids = num_owned * 3;
+    MPI_Allgather(&num_owned_ids, 1, MPI_INT, &counts[0], 1, MPI_INT, comm);
+    for (int i = 0; i < num_procs; i++)
+        displs[i+1] = displs[i] + counts[i];
+    std::vector<int> all_ids(displs[num_procs] + 1);
+    MPI_Allgatherv((void*)&mesh.triangles[0], num_owned_ids, MPI_INT, &all_ids[0], &counts[0], &displs[0], MPI_INT, comm);
+
+    std::map<Triangle_key, int> owner_of;
+    std::map<int, std::vector<Triangle_key> > triangles_of_vertex;
+    for (int p = 0; p < num_procs; p++)
+        for (int i = displs[p]; i < displs[p+1]; i += 3) {
+            Triangle_key key = make_triangle_key(&all_ids[i]);
+            EXPECT_TRUE(owner_of.insert(std::make_pair(key, p)).second) << "triangle owned twice";
+            for (int k = 0; k < 3; k++)
+                triangles_of_vertex[all_ids[i+k]].push_back(key);
+        }
+
+    if (rank == 0) {
+        int num_threads = omp_get_max_threads(), num_units;
+        MPI_Reduce(&num_threads, &num_units, 1, MPI_INT, MPI_SUM, 0, comm);
+
+        char filename[64];
+        snprintf(filename, 64, "log/global_triangles_%d", num_units);
+        FILE *fp = fopen(filename, "r");
+        ASSERT_TRUE(fp != NULL);
+        int v[3];
+        size_t num_merged = 0;
+        while (fscanf(fp, "%d, %d, %d", &v[0], &v[1], &v[2]) == 3) {
+            EXPECT_EQ(1u, owner_of.count(make_triangle_key(v)));
+            num_merged++;
+        }
+        fclose(fp);
+        EXPECT_EQ(num_merged, owner_of.size());
+    } else {
+        int num_threads = omp_get_max_threads();
+        MPI_Reduce(&num_threads, NULL, 1, MPI_INT, MPI_SUM, 0, comm);
+    }
+
+    std::set<Triangle_key> held;
+    std::set<int> prev_vertices;
+    for (int i = 0; i < num_owned; i++) {
+        held.insert(make_triangle_key(&mesh.triangles[i*3]));
+        prev_vertices.insert(&mesh.triangles[i*3], &mesh.triangles[i*3+3]);
+    }
+
+    for (int layer = 1; layer <= num_ghost_layers; layer++) {
+        std::set<int> vertices;
+        for (int i = mesh.layer_offsets[layer]; i < mesh.layer_offsets[layer+1]; i++) {
+            const int *v = &mesh.triangles[i*3];
+            Triangle_key key = make_triangle_key(v);
+            EXPECT_TRUE(held.insert(key).second) << "ghost in a lower layer";
+            ASSERT_EQ(1u, owner_of.count(key));
+            EXPECT_EQ(owner_of[key], mesh.owners[i]);
+            EXPECT_NE(rank, mesh.owners[i]);
+            EXPECT_TRUE(prev_vertices.count(v[0]) || prev_vertices.count(v[1]) || prev_vertices.count(v[2]))
+                << "ghost of layer " << layer << " does not touch layer " << layer-1;
+            vertices.insert(v, v+3);
+        }
+
+        for (std::set<int>::iterator it = prev_vertices.begin(); it != prev_vertices.end(); ++it) {
+            const std::vector<Triangle_key> &incident = triangles_of_vertex[*it];
+            for (size_t i = 0; i < incident.size(); i++)
+                EXPECT_EQ(1u, held.count(incident[i])) << "missing ghost of layer " << layer;
+        }
+        prev_vertices.swap(vertices);
+    }
+}
+
+
+TEST_F(FullProcess, LocalMesh) {
+    comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+
+    prepare_grid();
+
+    Patcc* comp;
+    comp = new Patcc(0);
+    comp->register_grid(new Grid(1));
+    ASSERT_EQ(0, comp->generate_delaunay_trianglulation(1, true));
+
+    Local_mesh mesh;
+    EXPECT_EQ(-1, comp->get_local_mesh(2, 2, &mesh));
+    EXPECT_EQ(-1, comp->get_local_mesh(1, -1, &mesh));
+    ASSERT_EQ(0, comp->get_local_mesh(1, 3, &mesh));
+    check_local_mesh(mesh, 3);
+
+    delete comp;
+};
+
+
+/* the lonlat_grid_small of gen_grid.py, whose first and last rows are at the poles */
+static void prepare_latlon_grid_with_poles()
+{
+    int lon_points = 180, lat_points = 60;
+    num_points = lon_points * lat_points;
+    delete coord_values[0];
+    delete coord_values[1];
+
+    coord_values[0] = new double[num_points]();
+    coord_values[1] = new double[num_points]();
+
+    int count = 0;
+    for (int i = 0; i < lon_points; i++)
+        for (int j = 0; j < lat_points; j++) {
+            coord_values[PDLN_LON][count] = 360.0 * i / lon_points;
+            coord_values[PDLN_LAT][count++] = -90.0 + 180.0 * j / (lat_points-1);
+        }
+
+    min_lon =   0.0;
+    max_lon = 360.0;
+    min_lat = -90.0;
+    max_lat =  90.0;
+
+    is_cyclic = true;
+}
+
+
+TEST_F(FullProcess, VerifyLatLonWithPoles) {
+    comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+
+    prepare_latlon_grid_with_poles();
+
+    Patcc* comp;
+    comp = new Patcc(0);
+    comp->register_grid(new Grid(1));
+    ASSERT_EQ(0, comp->generate_delaunay_trianglulation(1, true));
+    delete comp;
+
+    int num_threads = omp_get_max_threads(), num_units;
+    MPI_Reduce(&num_threads, &num_units, 1, MPI_INT, MPI_SUM, 0, comm);
+
+    if (mpi_rank == 0) {
+        FILE *fp = fopen("log/lonlat_grid_small.dat", "w");
+        ASSERT_TRUE(fp != NULL);
+        fprintf(fp, "%d\n%lf %lf %lf %lf\n", num_points, min_lon, max_lon, min_lat, max_lat);
+        for (int i = 0; i < num_points; i++)
+            fprintf(fp, "%.10lf %.10lf\n", coord_values[PDLN_LON][i], coord_values[PDLN_LAT][i]);
+        fclose(fp);
+
+        /* a clean environment, so that the verifier is not taken as a process of this MPI job */
+        char cmd[256];
+        snprintf(cmd, 256, "env -i PATH=\"$PATH\" LD_LIBRARY_PATH=\"$LD_LIBRARY_PATH\" HOME=\"$HOME\" "
+                           "./verify_triangulation log/lonlat_grid_small.dat log/global_triangles_%d "
+                           "> log/verify_lonlat_grid_small.txt", num_units);
+        EXPECT_EQ(0, system(cmd)) << "see log/verify_lonlat_grid_small.txt";
+    }
+};
+
+
 #ifdef NETCDF
 TEST_F(FullProcess, LatLonGrid) {
     comm = MPI_COMM_WORLD;
@@ -0,0 +1,372 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "mpi.h"
+#include "gtest/gtest.h"
+
+#include "grid_file.h"
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+/* each process of the test works on its own file */
+static void get_grid_file_name(char *filename, int len)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    snprintf(filename, len, "log/grid_file_test_%d.bin", rank);
+}
+
+
+static bool same_double(double a, double b)
+{
+    return (std::isnan(a) && std::isnan(b)) || memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+
+/* what parse_double must give for token: strtod over the whole token, or a failure */
+static bool strtod_whole(const std::string &token, double *value)
+{
+    if (token.empty() || token.size() >= 64)
+        return false;
+    char *end;
+    *value = strtod(token.c_str(), &end);
+    return end == token.c_str() + token.size();
+}
+
+
+/* token followed by more digits, which must not be read */
+static void expect_same_as_strtod(const std::string &token)
+{
+    std::string buf = token + "987";
+    double expected = 0, value = 0;
+    bool expected_ok = strtod_whole(token, &expected);
+
+    ASSERT_EQ(expected_ok, parse_double(buf.c_str(), buf.c_str() + token.size(), &value)) << "token \"" << token << "\"";
+    if (expected_ok)
+        EXPECT_TRUE(same_double(expected, value)) << "token \"" << token << "\": " << value << " instead of " << expected;
+}
+
+
+TEST(GridFileTest, ParseDoubleEdgeTokens) {
+    const char *tokens[] = {
+        "0", "-0", "+0", "0.0", "-0.0", "1", "-1", "+1.5", ".5", "5.", "-.25",
+        "0.1", "0.3", "123.456", "-179.99999999", "359.9999999999999",
+        "1e22", "1e23", "1e-22", "1e-23", "1E5", "2.5e+3", "2.5e-3", "-7e0",
+        /* mantissas around 2^53 and the 19-digit cutoff */
+        "9007199254740992", "9007199254740993", "9007199254740994",
+        "123456789012345678", "1234567890123456789", "12345678901234567890",
+        "0.1234567890123456789", "0.12345678901234567890", "1.000000000000000000001",
+        "0000000000000000000000001.5", "0.0000000000000000000000001", "100000000000000000000000",
+        /* exponents out of the exact range */
+        "1.7976931348623157e308", "1.8e308", "4.9e-324", "2e-400", "1e99999999",
+        /* left to strtod */
+        "inf", "-inf", "INF", "nan", "-nan", "infinity", "0x1p-3", "-0x1.8p1", "0x10",
+        /* malformed */
+        "", "-", "+", ".", "-.", "e5", "1e", "1e+", "1e-", "1.2.3", "1..2", "1e5.0", "--1", "1-", "abc", "1x",
+        "12345678901234567890123456789012345678901234567890123456789012345678",
+    };
+
+    for (size_t i = 0; i < sizeof(tokens) / sizeof(tokens[0]); i++)
+        expect_same_as_strtod(tokens[i]);
+}
+
+
+TEST(GridFileTest, ParseDoubleRandomDecimals) {
+    srand(2);
+    for (int round = 0; round < 100000; round++) {
+        char token[64];
+        int  num_digits = 1 + rand() % 20;
+        int  point = rand() % (num_digits + 1);
+        int  len = 0;
+
+        if (rand() % 2)
+            token[len++] = '-';
+        for (int i = 0; i < num_digits; i++) {
+            if (i == point)
+                token[len++] = '.';
+            token[len++] = '0' + rand() % 10;
+        }
+        if (rand() % 3 == 0)
+            len += snprintf(token + len, 64 - len, "e%d", rand() % 61 - 30);
+        token[len] = '\0';
+
+        expect_same_as_strtod(token);
+    }
+}
+
+
+/* values of the lattice point list, "lon lat" per line */
+static std::string make_point_list(int num_points, std::vector<double> &lon, std::vector<double> &lat)
+{
+    std::string text;
+    char line[128];
+    for (int i = 0; i < num_points; i++) {
+        lon.push_back(i * 0.7 - 3);
+        lat.push_back(-90 + i * 1e-3);
+        snprintf(line, 128, i % 5 == 0 ? "  %.17g\t%.17g \r\n" : "%.17g %.17g\n", lon[i], lat[i]);
+        text += line;
+    }
+    return text;
+}
+
+
+TEST(GridFileTest, ParsePointsInChunks) {
+    const int num_points = 37;
+    std::vector<double> lon, lat;
+    std::string points = make_point_list(num_points, lon, lat);
+
+    /* chunks more than lines leave empty ones; the tail can be in any chunk */
+    const char *tails[] = {"", "\n", "DISABLE_POINTS_NONE\n", "\nDISABLE_POINTS_BY_INDEX 1\n3\n"};
+    for (size_t k = 0; k < sizeof(tails) / sizeof(tails[0]); k++)
+        for (int max_threads = 1; max_threads <= 64; max_threads = max_threads < 8 ? max_threads + 1 : max_threads * 2) {
+            std::string text = "\n" + points + tails[k];
+            const char *begin = text.c_str(), *end = begin + text.size();
+            std::vector<double> x(num_points, NAN), y(num_points, NAN);
+            double *values[2] = {&x[0], &y[0]};
+            const char *tail = NULL;
+
+            ASSERT_TRUE(parse_points(begin, end, num_points, 2, values, &tail, max_threads)) << max_threads << " threads";
+            for (int i = 0; i < num_points; i++) {
+                EXPECT_EQ(lon[i], x[i]);
+                EXPECT_EQ(lat[i], y[i]);
+            }
+            const char *tail_token = strstr(begin + 1 + points.size(), "DISABLE");
+            EXPECT_EQ(tail_token ? tail_token : end, tail) << max_threads << " threads, tail " << k;
+        }
+
+    /* all values on one line, so that no chunk but the first has a start */
+    std::string text = "1 2 3 4 5 6 tail";
+    double x[3], y[3];
+    double *values[2] = {x, y};
+    const char *tail = NULL;
+    ASSERT_TRUE(parse_points(text.c_str(), text.c_str() + text.size(), 3, 2, values, &tail, 4));
+    EXPECT_EQ(5, x[2]);
+    EXPECT_EQ(6, y[2]);
+    EXPECT_STREQ("tail", tail);
+
+    /* three components */
+    double xyz[3][2];
+    double *xyz_values[3] = {xyz[0], xyz[1], xyz[2]};
+    ASSERT_TRUE(parse_points(text.c_str(), text.c_str() + text.size(), 2, 3, xyz_values, &tail, 3));
+    EXPECT_EQ(4, xyz[0][1]);
+    EXPECT_EQ(6, xyz[2][1]);
+}
+
+
+TEST(GridFileTest, ParsePointsErrors) {
+    const int num_points = 20;
+    std::vector<double> lon, lat;
+    std::string points = make_point_list(num_points, lon, lat);
+    std::vector<double> x(num_points), y(num_points);
+    double *values[2] = {&x[0], &y[0]};
+    const char *tail;
+
+    for (int max_threads = 1; max_threads <= 8; max_threads++) {
+        /* one value short */
+        std::string text = points.substr(0, points.rfind(' '));
+        EXPECT_FALSE(parse_points(text.c_str(), text.c_str() + text.size(), num_points, 2, values, &tail, max_threads));
+
+        /* a bad value in the middle, and one at the end */
+        text = points;
+        text.replace(text.find('\n', text.size() / 2) + 1, 1, "x");
+        EXPECT_FALSE(parse_points(text.c_str(), text.c_str() + text.size(), num_points, 2, values, &tail, max_threads));
+        text = points.substr(0, points.size() - 2) + "?\n";
+        EXPECT_FALSE(parse_points(text.c_str(), text.c_str() + text.size(), num_points, 2, values, &tail, max_threads));
+
+        /* a bad token after the points is the tail, not an error */
+        text = points + "x\n";
+        EXPECT_TRUE(parse_points(text.c_str(), text.c_str() + text.size(), num_points, 2, values, &tail, max_threads));
+        EXPECT_EQ('x', *tail);
+    }
+}
+
+
+/* a grid of num_points points with a mask and disabled points written into filename */
+static void write_test_grid(const char *filename, int disabling_method)
+{
+    Grid_input grid;
+    init_grid_input(&grid);
+    grid.num_points = 10;
+    grid.boundary[1] = 360;
+    grid.boundary[2] = -90;
+    grid.boundary[3] = 90;
+    grid.lon  = new double[10];
+    grid.lat  = new double[10];
+    grid.mask = new bool[10];
+    for (int i = 0; i < 10; i++) {
+        grid.lon[i]  = i * 36;
+        grid.lat[i]  = i * 18 - 81;
+        grid.mask[i] = i != 4;
+    }
+    grid.disabling_method = disabling_method;
+    if (disabling_method == PDLN_GRID_DISABLE_BY_INDEX) {
+        grid.disabling_num  = 3;
+        grid.disabling_data = new int[3];
+        ((int*)grid.disabling_data)[0] = 1;
+        ((int*)grid.disabling_data)[1] = 2;
+        ((int*)grid.disabling_data)[2] = 9;
+    }
+    ASSERT_EQ(0, write_grid_binary(filename, &grid));
+    free_grid_input(&grid);
+}
+
+
+static std::vector<char> read_image(const char *filename)
+{
+    std::vector<char> image;
+    FILE *fp = fopen(filename, "rb");
+    char buf[4096];
+    for (size_t len; (len = fread(buf, 1, sizeof(buf), fp)) > 0; )
+        image.insert(image.end(), buf, buf + len);
+    fclose(fp);
+    return image;
+}
+
+
+/* open the image with its header replaced */
+static int open_with_header(const std::vector<char> &image, const Grid_file_header &header)
+{
+    char filename[64];
+    get_grid_file_name(filename, 64);
+
+    std::vector<char> corrupt = image;
+    memcpy(&corrupt[0], &header, sizeof(Grid_file_header));
+    FILE *fp = fopen(filename, "wb");
+    fwrite(&corrupt[0], 1, corrupt.size(), fp);
+    fclose(fp);
+
+    Grid_file_reader reader;
+    return reader.open(filename);
+}
+
+
+TEST(GridFileTest, BinaryRoundTrip) {
+    char filename[64];
+    get_grid_file_name(filename, 64);
+    write_test_grid(filename, PDLN_GRID_DISABLE_BY_INDEX);
+
+    Grid_input grid;
+    ASSERT_EQ(0, read_grid_file(filename, &grid));
+    EXPECT_EQ(10, grid.num_points);
+    EXPECT_EQ(360, grid.boundary[1]);
+    EXPECT_EQ(36 * 9, grid.lon[9]);
+    EXPECT_EQ(-81, grid.lat[0]);
+    ASSERT_TRUE(grid.mask != NULL);
+    EXPECT_FALSE(grid.mask[4]);
+    ASSERT_EQ(PDLN_GRID_DISABLE_BY_INDEX, grid.disabling_method);
+    ASSERT_EQ(3, grid.disabling_num);
+    EXPECT_EQ(9, ((int*)grid.disabling_data)[2]);
+    free_grid_input(&grid);
+
+    /* without disabled points, the mask disables them */
+    write_test_grid(filename, PDLN_GRID_DISABLE_NONE);
+    ASSERT_EQ(0, read_grid_file(filename, &grid));
+    ASSERT_EQ(PDLN_GRID_DISABLE_BY_INDEX, grid.disabling_method);
+    ASSERT_EQ(1, grid.disabling_num);
+    EXPECT_EQ(4, ((int*)grid.disabling_data)[0]);
+    free_grid_input(&grid);
+}
+
+
+TEST(GridFileTest, RejectsCorruptBinaryHeaders) {
+    char filename[64];
+    get_grid_file_name(filename, 64);
+    write_test_grid(filename, PDLN_GRID_DISABLE_BY_INDEX);
+
+    std::vector<char> image = read_image(filename);
+    Grid_file_header header;
+    memcpy(&header, &image[0], sizeof(header));
+    ASSERT_EQ(0, open_with_header(image, header));
+
+    Grid_file_reader reader;
+    EXPECT_EQ(-1, reader.open("log/no_such_grid_file.bin"));
+
+    /* truncated files */
+    FILE *fp = fopen(filename, "wb");
+    fwrite(&image[0], 1, image.size() - 1, fp);
+    fclose(fp);
+    EXPECT_EQ(-1, reader.open(filename));
+    fp = fopen(filename, "wb");
+    fwrite(&image[0], 1, PDLN_GRID_HEADER_SIZE - 1, fp);
+    fclose(fp);
+    EXPECT_EQ(-1, reader.open(filename));
+
+    Grid_file_header h = header;
+    h.magic[7] = 'X';
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.version = PDLN_GRID_FILE_VERSION + 1;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.byte_order = 0x04030201;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.disabling_method = PDLN_GRID_DISABLE_BY_RANGE + 1;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.num_points = 0;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.num_points = (unsigned long long)INT_MAX + 1;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.num_points = 11;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.num_disabling = 1000;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    /* sections overlapping the header, misaligned or out of the file */
+    h = header;
+    h.lon_offset = 64;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.lat_offset += 4;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.disabling_offset += 4;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.mask_offset = image.size() - 9;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.flags |= PDLN_GRID_HAS_XYZ;
+    h.xyz_offset = PDLN_GRID_HEADER_SIZE;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    /* offsets whose sums with the section lengths wrap around */
+    h = header;
+    h.lon_offset = ~0ULL - 7;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.disabling_offset = ~0ULL - 7;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.mask_offset = ~0ULL - 3;
+    EXPECT_EQ(-1, open_with_header(image, h));
+}
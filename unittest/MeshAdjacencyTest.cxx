@@ -0,0 +1,174 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "mpi.h"
+#include "gtest/gtest.h"
+
+#include "mesh_adjacency.h"
+#include <algorithm>
+#include <vector>
+
+
+/*
+ *  0 ─── 1 ─── 4
+ *  │ ╲ 0 │ 2 ╱
+ *  │ 1 ╲ │ ╱
+ *  3 ─── 2
+ */
+static const int small_triangles[3][3] = {{0, 1, 2}, {0, 2, 3}, {1, 2, 4}};
+static const long long small_neighbors[3][3] = {{2, 1, -1}, {-1, -1, 0}, {-1, -1, 0}};
+static const long long small_vertex_offsets[6] = {0, 3, 6, 10, 12, 14};
+static const int small_vertex_neighbors[14] = {1, 2, 3,  0, 2, 4,  0, 1, 3, 4,  0, 2,  1, 2};
+
+
+/* triangles [first, first+num) of a contiguous split of num_all triangles over the processes of comm */
+static void split_triangles(MPI_Comm comm, int num_all, int *first, int *num)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+    *first = num_all * rank / num_procs;
+    *num   = num_all * (rank+1) / num_procs - *first;
+}
+
+
+/*
+ * nx*ny vertices on a lattice, two triangles per cell, with the diagonal of
+ * the cells alternating so that vertices have different degrees.
+ */
+static std::vector<int> make_lattice_mesh(int nx, int ny)
+{
+    std::vector<int> ids;
+    for (int j = 0; j < ny-1; j++)
+        for (int i = 0; i < nx-1; i++) {
+            int v00 = j*nx+i, v10 = v00+1, v01 = v00+nx, v11 = v01+1;
+            int t[6];
+            if ((i + j) % 2 == 0) {
+                int d[6] = {v00, v10, v11, v00, v11, v01};
+                std::copy(d, d+6, t);
+            } else {
+                int d[6] = {v00, v10, v01, v10, v11, v01};
+                std::copy(d, d+6, t);
+            }
+            ids.insert(ids.end(), t, t+6);
+        }
+    return ids;
+}
+
+
+/* neighbors across the edge opposite to each vertex, by comparing all pairs of triangles */
+static std::vector<long long> brute_force_neighbors(const std::vector<int> &ids)
+{
+    int num = ids.size() / 3;
+    std::vector<long long> neighbors(ids.size(), -1);
+    for (int t = 0; t < num; t++)
+        for (int k = 0; k < 3; k++) {
+            int v0 = ids[t*3+(k+1)%3], v1 = ids[t*3+(k+2)%3];
+            for (int s = 0; s < num; s++) {
+                if (s == t)
+                    continue;
+                const int *w = &ids[s*3];
+                bool has_v0 = w[0] == v0 || w[1] == v0 || w[2] == v0;
+                bool has_v1 = w[0] == v1 || w[1] == v1 || w[2] == v1;
+                if (has_v0 && has_v1)
+                    neighbors[t*3+k] = s;
+            }
+        }
+    return neighbors;
+}
+
+
+/* sorted neighbors of each vertex as CSR rows, offsets and neighbors are appended */
+static void brute_force_vertex_graph(const std::vector<int> &ids, int num_points,
+                                     std::vector<long long> &offsets, std::vector<int> &neighbors)
+{
+    std::vector<std::vector<int> > rows(num_points);
+    for (size_t t = 0; t < ids.size() / 3; t++)
+        for (int k = 0; k < 3; k++) {
+            rows[ids[t*3+k]].push_back(ids[t*3+(k+1)%3]);
+            rows[ids[t*3+(k+1)%3]].push_back(ids[t*3+k]);
+        }
+
+    offsets.assign(1, 0);
+    for (int i = 0; i < num_points; i++) {
+        std::sort(rows[i].begin(), rows[i].end());
+        rows[i].erase(std::unique(rows[i].begin(), rows[i].end()), rows[i].end());
+        neighbors.insert(neighbors.end(), rows[i].begin(), rows[i].end());
+        offsets.push_back(neighbors.size());
+    }
+}
+
+
+/* check the part of adjacency kept by this process against the whole expected mesh */
+static void check_adjacency(const Mesh_adjacency &adjacency, int first, int num,
+                            const long long *neighbors, const long long *vertex_offsets,
+                            const int *vertex_neighbors, int num_points)
+{
+    ASSERT_EQ((size_t)num*3, adjacency.triangle_neighbors.size());
+    for (int i = 0; i < num*3; i++)
+        EXPECT_EQ(neighbors[first*3+i], adjacency.triangle_neighbors[i]) << "triangle " << first+i/3 << " slot " << i%3;
+
+    int num_procs, rank;
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    EXPECT_EQ((long long)num_points * rank / num_procs, adjacency.first_vertex);
+    EXPECT_EQ((long long)num_points * (rank+1) / num_procs - adjacency.first_vertex, adjacency.num_vertices);
+    EXPECT_EQ(vertex_offsets[num_points], adjacency.num_all_vertex_neighbors);
+
+    ASSERT_EQ((size_t)adjacency.num_vertices + 1, adjacency.vertex_offsets.size());
+    for (int i = 0; i <= adjacency.num_vertices; i++)
+        EXPECT_EQ(vertex_offsets[adjacency.first_vertex + i], adjacency.vertex_offsets[i]) << "vertex " << adjacency.first_vertex + i;
+
+    long long base = adjacency.vertex_offsets[0];
+    ASSERT_EQ((size_t)(adjacency.vertex_offsets[adjacency.num_vertices] - base), adjacency.vertex_neighbors.size());
+    for (size_t i = 0; i < adjacency.vertex_neighbors.size(); i++)
+        EXPECT_EQ(vertex_neighbors[base + i], adjacency.vertex_neighbors[i]);
+}
+
+
+TEST(MeshAdjacencyTest, SmallMesh) {
+    int first, num;
+    split_triangles(MPI_COMM_WORLD, 3, &first, &num);
+
+    Mesh_adjacency adjacency;
+    ASSERT_EQ(0, build_mesh_adjacency(MPI_COMM_WORLD, &small_triangles[0][0] + first*3, num, first, 5, &adjacency));
+    check_adjacency(adjacency, first, num, &small_neighbors[0][0], small_vertex_offsets, small_vertex_neighbors, 5);
+}
+
+
+TEST(MeshAdjacencyTest, LatticeMatchesBruteForce) {
+    const int nx = 7, ny = 5;
+    std::vector<int> ids = make_lattice_mesh(nx, ny);
+    std::vector<long long> neighbors = brute_force_neighbors(ids);
+    std::vector<long long> vertex_offsets;
+    std::vector<int> vertex_neighbors;
+    brute_force_vertex_graph(ids, nx*ny, vertex_offsets, vertex_neighbors);
+
+    int first, num;
+    split_triangles(MPI_COMM_WORLD, ids.size() / 3, &first, &num);
+
+    Mesh_adjacency adjacency;
+    ASSERT_EQ(0, build_mesh_adjacency(MPI_COMM_WORLD, &ids[0] + first*3, num, first, nx*ny, &adjacency));
+    check_adjacency(adjacency, first, num, &neighbors[0], &vertex_offsets[0], &vertex_neighbors[0], nx*ny);
+}
+
+
+TEST(MeshAdjacencyTest, NonManifoldEdge) {
+    /* a third triangle on the edge 1-2 of the small mesh */
+    const int ids[4][3] = {{0, 1, 2}, {0, 2, 3}, {1, 2, 4}, {2, 1, 5}};
+    int first, num;
+    split_triangles(MPI_COMM_WORLD, 4, &first, &num);
+
+    Mesh_adjacency adjacency;
+    EXPECT_EQ(-1, build_mesh_adjacency(MPI_COMM_WORLD, &ids[0][0] + first*3, num, first, 6, &adjacency));
+    if (first == 0 && num > 0) {
+        EXPECT_EQ(-1, adjacency.triangle_neighbors[0]);
+        EXPECT_EQ(1, adjacency.triangle_neighbors[1]);
+    }
+}
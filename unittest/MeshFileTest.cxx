@@ -0,0 +1,261 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "mpi.h"
+#include "gtest/gtest.h"
+
+#include "mesh_file.h"
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+/* each process of the test works on its own file */
+static void get_mesh_file_name(char *filename, int len)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    snprintf(filename, len, "log/mesh_file_test_%d.bin", rank);
+}
+
+
+static void write_file(const char *filename, const std::vector<char>& image, size_t len)
+{
+    FILE *fp = fopen(filename, "wb");
+    ASSERT_TRUE(fp != NULL);
+    ASSERT_EQ(len, fwrite(&image[0], 1, len, fp));
+    fclose(fp);
+}
+
+
+/*
+ *  0 ─── 1 ─── 4
+ *  │ ╲ 0 │ 2 ╱
+ *  │ 1 ╲ │ ╱
+ *  3 ─── 2
+ */
+static const int mesh_triangles[3][3]  = {{0, 1, 2}, {0, 2, 3}, {1, 2, 4}};
+static const int mesh_adjacency[3][3]  = {{2, 1, -1}, {-1, -1, 0}, {-1, -1, 0}};
+static const unsigned long long mesh_vertex_offsets[6] = {0, 3, 6, 10, 12, 14};
+static const int mesh_vertex_neighbors[14] = {1, 2, 3,  0, 2, 4,  0, 1, 3, 4,  0, 2,  1, 2};
+
+
+/* the mesh above with adjacency and vertex graph, its triangles in two blocks */
+static std::vector<char> make_mesh_image(Mesh_file_header *header)
+{
+    init_mesh_file_header(header, 0x1234, 5, 3, 2, PDLN_MESH_ORDER_IDS_IN_BLOCK, true, true, 14);
+
+    Mesh_block_entry blocks[2] = {{0, 2, 0, 3}, {2, 1, 1, 4}};
+    std::vector<char> image(header->block_index_offset + sizeof(blocks), 0);
+    memcpy(&image[0], header, sizeof(Mesh_file_header));
+    memcpy(&image[header->triangles_offset], mesh_triangles, sizeof(mesh_triangles));
+    memcpy(&image[header->adjacency_offset], mesh_adjacency, sizeof(mesh_adjacency));
+    memcpy(&image[header->vertex_offsets_offset], mesh_vertex_offsets, sizeof(mesh_vertex_offsets));
+    memcpy(&image[header->vertex_neighbors_offset], mesh_vertex_neighbors, sizeof(mesh_vertex_neighbors));
+    memcpy(&image[header->block_index_offset], blocks, sizeof(blocks));
+    return image;
+}
+
+
+/* open the image with its header replaced */
+static int open_with_header(const std::vector<char>& image, const Mesh_file_header& header)
+{
+    char filename[64];
+    get_mesh_file_name(filename, 64);
+
+    std::vector<char> corrupt = image;
+    memcpy(&corrupt[0], &header, sizeof(Mesh_file_header));
+    write_file(filename, corrupt, corrupt.size());
+
+    Mesh_file_reader reader;
+    return reader.open(filename);
+}
+
+
+TEST(MeshFileTest, HeaderLayout) {
+    Mesh_file_header header;
+    init_mesh_file_header(&header, 0x1234, 5, 3, 2, PDLN_MESH_ORDER_IDS, true, true, 14);
+
+    EXPECT_EQ(0, memcmp(header.magic, PDLN_MESH_FILE_MAGIC, 8));
+    EXPECT_EQ(PDLN_MESH_FILE_VERSION, header.version);
+    EXPECT_EQ(4u, header.index_width);
+    EXPECT_EQ((unsigned)(PDLN_MESH_HAS_ADJACENCY | PDLN_MESH_HAS_VERTEX_GRAPH), header.flags);
+    EXPECT_EQ(PDLN_MESH_HEADER_SIZE, header.triangles_offset);
+    EXPECT_EQ(header.triangles_offset + 3*3*4, header.adjacency_offset);
+    EXPECT_EQ(0u, header.vertex_offsets_offset % 8);
+    EXPECT_LE(header.adjacency_offset + 3*3*4, header.vertex_offsets_offset);
+    EXPECT_EQ(header.vertex_offsets_offset + 6*8, header.vertex_neighbors_offset);
+    EXPECT_EQ(0u, header.block_index_offset % 8);
+    EXPECT_LE(header.vertex_neighbors_offset + 14*4, header.block_index_offset);
+
+    init_mesh_file_header(&header, 0, 5, 3, 1, PDLN_MESH_ORDER_NONE, false);
+    EXPECT_EQ(0u, header.flags);
+    EXPECT_EQ(0u, header.adjacency_offset);
+    EXPECT_EQ(0u, header.vertex_offsets_offset);
+    /* the block index is 8-byte aligned */
+    EXPECT_EQ(header.triangles_offset + 3*3*4 + 4, header.block_index_offset);
+}
+
+
+TEST(MeshFileTest, RoundTrip) {
+    char filename[64];
+    get_mesh_file_name(filename, 64);
+
+    Mesh_file_header header;
+    std::vector<char> image = make_mesh_image(&header);
+    write_file(filename, image, image.size());
+
+    Mesh_file_reader reader;
+    ASSERT_EQ(0, reader.open(filename));
+    ASSERT_TRUE(reader.get_header() != NULL);
+    EXPECT_EQ(0x1234u, reader.get_header()->grid_fingerprint);
+    EXPECT_EQ(5u, reader.get_header()->num_points);
+    EXPECT_EQ(3u, reader.get_header()->num_triangles);
+    EXPECT_EQ((unsigned)PDLN_MESH_ORDER_IDS_IN_BLOCK, reader.get_header()->ordering);
+
+    Mesh_span<int> triangles = reader.get_triangles<int>();
+    ASSERT_EQ(9u, triangles.size);
+    for (int i = 0; i < 9; i++)
+        EXPECT_EQ(mesh_triangles[i/3][i%3], triangles[i]);
+
+    /* spans of the wrong width are empty */
+    EXPECT_TRUE(reader.get_triangles<long long>().empty());
+    EXPECT_TRUE(reader.get_adjacency<long long>().empty());
+
+    Mesh_span<int> adjacency = reader.get_adjacency<int>();
+    ASSERT_EQ(9u, adjacency.size);
+    for (int i = 0; i < 9; i++)
+        EXPECT_EQ(mesh_adjacency[i/3][i%3], adjacency[i]);
+
+    Mesh_span<unsigned long long> offsets = reader.get_vertex_offsets();
+    Mesh_span<int> neighbors = reader.get_vertex_neighbors<int>();
+    ASSERT_EQ(6u, offsets.size);
+    ASSERT_EQ(14u, neighbors.size);
+    for (int i = 0; i < 6; i++)
+        EXPECT_EQ(mesh_vertex_offsets[i], offsets[i]);
+    for (int i = 0; i < 14; i++)
+        EXPECT_EQ(mesh_vertex_neighbors[i], neighbors[i]);
+
+    Mesh_span<Mesh_block_entry> blocks = reader.get_blocks();
+    ASSERT_EQ(2u, blocks.size);
+    EXPECT_EQ(2u, blocks[0].num_triangles);
+    EXPECT_EQ(4u, blocks[1].max_vertex);
+    Mesh_span<int> block = reader.get_block_triangles<int>(1);
+    ASSERT_EQ(3u, block.size);
+    EXPECT_EQ(1, block[0]);
+    EXPECT_EQ(4, block[2]);
+    EXPECT_TRUE(reader.get_block_triangles<int>(2).empty());
+
+    reader.close();
+    EXPECT_TRUE(reader.get_header() == NULL);
+    EXPECT_TRUE(reader.get_triangles<int>().empty());
+}
+
+
+TEST(MeshFileTest, EightByteIndexes) {
+    char filename[64];
+    get_mesh_file_name(filename, 64);
+
+    /* more points than int ids can hold switch all ids and indexes to 8 bytes */
+    Mesh_file_header header;
+    unsigned long long num_points = (unsigned long long)INT_MAX + 1;
+    init_mesh_file_header(&header, 0, num_points, 2, 1, PDLN_MESH_ORDER_NONE, true);
+    ASSERT_EQ(8u, header.index_width);
+    EXPECT_EQ(header.triangles_offset + 2*3*8, header.adjacency_offset);
+
+    long long triangles[2][3] = {{0, 1, (long long)num_points - 1}, {1, 2, 3}};
+    long long adjacency[2][3] = {{-1, -1, -1}, {-1, -1, -1}};
+    Mesh_block_entry block = {0, 2, 0, num_points - 1};
+
+    std::vector<char> image(header.block_index_offset + sizeof(block), 0);
+    memcpy(&image[0], &header, sizeof(header));
+    memcpy(&image[header.triangles_offset], triangles, sizeof(triangles));
+    memcpy(&image[header.adjacency_offset], adjacency, sizeof(adjacency));
+    memcpy(&image[header.block_index_offset], &block, sizeof(block));
+    write_file(filename, image, image.size());
+
+    Mesh_file_reader reader;
+    ASSERT_EQ(0, reader.open(filename));
+    EXPECT_TRUE(reader.get_triangles<int>().empty());
+    Mesh_span<long long> ids = reader.get_triangles<long long>();
+    ASSERT_EQ(6u, ids.size);
+    EXPECT_EQ((long long)num_points - 1, ids[2]);
+    EXPECT_EQ(-1, reader.get_adjacency<long long>()[5]);
+    EXPECT_TRUE(reader.get_vertex_offsets().empty());
+}
+
+
+TEST(MeshFileTest, RejectsCorruptFiles) {
+    char filename[64];
+    get_mesh_file_name(filename, 64);
+
+    Mesh_file_header header;
+    std::vector<char> image = make_mesh_image(&header);
+    Mesh_file_reader reader;
+
+    ASSERT_EQ(0, open_with_header(image, header));
+
+    /* truncated files */
+    write_file(filename, image, image.size() - 1);
+    EXPECT_EQ(-1, reader.open(filename));
+    write_file(filename, image, PDLN_MESH_HEADER_SIZE - 1);
+    EXPECT_EQ(-1, reader.open(filename));
+    EXPECT_EQ(-1, reader.open("log/no_such_mesh_file.bin"));
+
+    Mesh_file_header h = header;
+    h.magic[0] = 'X';
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.version = PDLN_MESH_FILE_VERSION + 1;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.index_width = 5;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    /* sections overlapping the header, misaligned or out of the file */
+    h = header;
+    h.triangles_offset = 64;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.block_index_offset += 4;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.adjacency_offset = image.size();
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.num_vertex_neighbors = 1000;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    /* num_triangles * 12 wraps around to 8, which a summed bound would accept */
+    h = header;
+    h.num_triangles = 0x5555555555555556ULL;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.vertex_offsets_offset = ~0ULL - 7;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    h = header;
+    h.num_points = ~0ULL;
+    EXPECT_EQ(-1, open_with_header(image, h));
+
+    /* blocks out of the triangles, also through wrapping sums */
+    std::vector<char> bad_blocks = image;
+    Mesh_block_entry *blocks = (Mesh_block_entry*)&bad_blocks[header.block_index_offset];
+    blocks[1].num_triangles = 2;
+    EXPECT_EQ(-1, open_with_header(bad_blocks, header));
+    blocks[1].first_triangle = ~0ULL;
+    EXPECT_EQ(-1, open_with_header(bad_blocks, header));
+}
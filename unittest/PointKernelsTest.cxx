@@ -0,0 +1,119 @@
+/***************************************************************
+  *  Copyright (c) 2019, Tsinghua University.
+  *  This is a source file of PatCC.
+  *  This file was initially finished by Dr. Li Liu and
+  *  Haoyu Yang. If you have any problem,
+  *  please contact Dr. Li Liu via liuli-cess@tsinghua.edu.cn
+  ***************************************************************/
+
+
+#include "gtest/gtest.h"
+
+#include "point_kernels.h"
+#include <cstdlib>
+
+
+/* values on a coarse lattice, so that many points lie exactly on the bounds */
+static double lattice_rand(double min, double max)
+{
+    return min + (max - min) * (rand() % 65) / 64.0;
+}
+
+
+static void set_random_halo(Halo_bounds *b)
+{
+    double in[4], out[4];
+    in[0]  = lattice_rand(0, 180);
+    in[1]  = in[0] + lattice_rand(0, 90);
+    in[2]  = lattice_rand(-60, 0);
+    in[3]  = in[2] + lattice_rand(0, 60);
+    out[0] = in[0] - lattice_rand(0, 90);
+    out[1] = in[1] + lattice_rand(0, 90);
+    out[2] = in[2] - lattice_rand(0, 30);
+    out[3] = in[3] + lattice_rand(0, 30);
+
+    const double shifts[3] = {0, -360, 360};
+    for (int k = 0; k < 3; k++)
+        for (int i = 0; i < 4; i++) {
+            b->inner[k][i] = in[i] + (i < 2 ? shifts[k] : 0);
+            b->outer[k][i] = out[i] + (i < 2 ? shifts[k] : 0);
+        }
+}
+
+
+/* the dispatched kernels are the last variant, which every other test compares to the scalar ones */
+TEST(PointKernelsTest, DispatchesToLastVariant) {
+    const Point_kernels *variants;
+    int num_variants = get_point_kernels_variants(&variants);
+    ASSERT_GE(num_variants, 1);
+    EXPECT_STREQ("generic", variants[0].isa);
+    EXPECT_STREQ(get_point_kernels_isa(), variants[num_variants-1].isa);
+}
+
+
+TEST(PointKernelsTest, HaloAndRegionMatchScalar) {
+    const Point_kernels *variants;
+    int num_variants = get_point_kernels_variants(&variants);
+    const int num = 1003;
+    double lon[num], lat[num];
+    unsigned char codes[num], codes_ref[num];
+
+    srand(1);
+    for (int round = 0; round < 200; round++) {
+        Halo_bounds b;
+        set_random_halo(&b);
+        for (int i = 0; i < num; i++) {
+            lon[i] = lattice_rand(-180, 540);
+            lat[i] = lattice_rand(-90, 90);
+        }
+
+        /* odd lengths leave vector remainders */
+        int n = num - round % 7;
+        classify_halo_points_scalar(lon, lat, n, &b, codes_ref);
+        for (int v = 0; v < num_variants; v++) {
+            variants[v].classify_halo_points(lon, lat, n, &b, codes);
+            for (int i = 0; i < n; i++)
+                ASSERT_EQ(codes_ref[i], codes[i]) << "halo, point " << i << " with " << variants[v].isa;
+        }
+
+        classify_region_points_scalar(lon, lat, n, b.outer[round%3], codes_ref);
+        for (int v = 0; v < num_variants; v++) {
+            variants[v].classify_region_points(lon, lat, n, b.outer[round%3], codes);
+            for (int i = 0; i < n; i++)
+                ASSERT_EQ(codes_ref[i], codes[i]) << "region, point " << i << " with " << variants[v].isa;
+        }
+    }
+}
+
+
+TEST(PointKernelsTest, QuantizedHaloMatchesScalar) {
+    const Point_kernels *variants;
+    int num_variants = get_point_kernels_variants(&variants);
+    const int num = 1003;
+    unsigned qx[num], qy[num];
+    unsigned char flags[num], flags_ref[num];
+
+    srand(2);
+    for (int round = 0; round < 200; round++) {
+        Halo_bounds b;
+        set_random_halo(&b);
+        /* cells of 1/16 degree from -180 and -90 */
+        for (int k = 0; k < 3; k++)
+            for (int i = 0; i < 4; i++) {
+                b.inner[k][i] = (b.inner[k][i] + (i < 2 ? 180 : 90)) * 16;
+                b.outer[k][i] = (b.outer[k][i] + (i < 2 ? 180 : 90)) * 16;
+            }
+        for (int i = 0; i < num; i++) {
+            qx[i] = rand() % (720 * 16);
+            qy[i] = rand() % (180 * 16);
+        }
+
+        int n = num - round % 7;
+        classify_quantized_halo_points_scalar(qx, qy, n, &b, flags_ref);
+        for (int v = 0; v < num_variants; v++) {
+            variants[v].classify_quantized_halo_points(qx, qy, n, &b, flags);
+            for (int i = 0; i < n; i++)
+                ASSERT_EQ(flags_ref[i], flags[i]) << "point " << i << " with " << variants[v].isa;
+        }
+    }
+}